@@ -0,0 +1,252 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "CongestionControl.h"
+#include <string.h>
+#include <math.h>
+
+const double CUBIC_C        = 0.4;  // cubic scaling constant
+const double CUBIC_BETA     = 0.7;  // cubic multiplicative decrease
+
+/*==============================================================================
+        Common Window Bookkeeping
+*/
+
+CongestionControl::CongestionControl(int maxWindow)
+        : congestionWindow(1), slowStartThreshold(maxWindow),
+          maxWindow(maxWindow) {
+}
+
+CongestionControl::~CongestionControl() {
+}
+
+void CongestionControl::onDupAck(int dupAcks, long now) {
+}
+
+void CongestionControl::onFastRetransmit(long now) {
+}
+
+void CongestionControl::onPartialAck(int acked, long now) {
+}
+
+void CongestionControl::onTimeout(long now) {
+    slowStartThreshold = congestionWindow / 2;
+    congestionWindow = 1;
+    bound();
+}
+
+int CongestionControl::window() {
+    return (int) congestionWindow;
+}
+
+double CongestionControl::cwnd() {
+    return congestionWindow;
+}
+
+double CongestionControl::ssthresh() {
+    return slowStartThreshold;
+}
+
+void CongestionControl::slowStart(int acked) {
+    congestionWindow += acked;
+    // don't overshoot ssthresh by more than the segments just acked.
+    if(congestionWindow > slowStartThreshold && slowStartThreshold >= 2)
+        congestionWindow = slowStartThreshold
+            + (congestionWindow - slowStartThreshold) / congestionWindow;
+}
+
+void CongestionControl::bound() {
+    if(slowStartThreshold < 2) slowStartThreshold = 2;
+    if(congestionWindow < 1) congestionWindow = 1;
+    if(congestionWindow > maxWindow) congestionWindow = maxWindow;
+}
+
+/*==============================================================================
+        Fixed Window
+*/
+
+FixedWindow::FixedWindow(int windowSize) : CongestionControl(windowSize) {
+    congestionWindow = windowSize;
+    bound();
+}
+
+const char *FixedWindow::name() {
+    return "fixed";
+}
+
+void FixedWindow::onAck(int acked, long now, long srtt) {
+}
+
+void FixedWindow::onFastRetransmit(long now) {
+}
+
+void FixedWindow::onTimeout(long now) {
+}
+
+/*==============================================================================
+        AIMD
+*/
+
+Aimd::Aimd(int maxWindow) : CongestionControl(maxWindow) {
+}
+
+const char *Aimd::name() {
+    return "aimd";
+}
+
+void Aimd::onAck(int acked, long now, long srtt) {
+    if(congestionWindow < slowStartThreshold) {
+        slowStart(acked);
+    } else {
+        // one segment per window worth of acks.
+        congestionWindow += (double) acked / congestionWindow;
+    }
+    bound();
+}
+
+void Aimd::onFastRetransmit(long now) {
+    slowStartThreshold = congestionWindow / 2;
+    bound();
+    congestionWindow = slowStartThreshold;
+}
+
+/*==============================================================================
+        NewReno
+*/
+
+NewReno::NewReno(int maxWindow) : CongestionControl(maxWindow),
+        inRecovery(false) {
+}
+
+const char *NewReno::name() {
+    return "newreno";
+}
+
+void NewReno::onAck(int acked, long now, long srtt) {
+    if(inRecovery) {
+        // new data acked: deflate the window back to ssthresh.
+        congestionWindow = slowStartThreshold;
+        inRecovery = false;
+    } else if(congestionWindow < slowStartThreshold) {
+        slowStart(acked);
+    } else {
+        congestionWindow += (double) acked / congestionWindow;
+    }
+    bound();
+}
+
+void NewReno::onDupAck(int dupAcks, long now) {
+    // every duplicate ack means another segment has left the network.
+    if(inRecovery) congestionWindow += 1;
+    bound();
+}
+
+void NewReno::onFastRetransmit(long now) {
+    slowStartThreshold = congestionWindow / 2;
+    bound();
+    // the duplicate acks so far already left the network.
+    congestionWindow = slowStartThreshold + DUPACK_THRESHOLD;
+    inRecovery = true;
+    bound();
+}
+
+void NewReno::onPartialAck(int acked, long now) {
+    // deflate by what was acked, plus one for the resent segment.
+    congestionWindow -= acked;
+    congestionWindow += 1;
+    bound();
+}
+
+void NewReno::onTimeout(long now) {
+    inRecovery = false;
+    CongestionControl::onTimeout(now);
+}
+
+/*==============================================================================
+        CUBIC
+*/
+
+Cubic::Cubic(int maxWindow) : CongestionControl(maxWindow),
+        lastMaxWindow(0), k(0), epochStart(-1), renoWindow(0) {
+}
+
+const char *Cubic::name() {
+    return "cubic";
+}
+
+void Cubic::onAck(int acked, long now, long srtt) {
+    if(congestionWindow < slowStartThreshold) {
+        slowStart(acked);
+        bound();
+        return;
+    }
+
+    if(epochStart < 0) {
+        // first congestion avoidance ack since a reduction.
+        epochStart = now;
+        if(congestionWindow < lastMaxWindow) {
+            k = cbrt((lastMaxWindow - congestionWindow) / CUBIC_C);
+        } else {
+            k = 0;
+            lastMaxWindow = congestionWindow;
+        }
+        renoWindow = congestionWindow;
+    }
+
+    // aim for where the curve is one rtt from now.
+    double rtt = srtt / 1000000.0;
+    double t = (now - epochStart) / 1000000.0 + rtt;
+    double target = CUBIC_C * (t - k) * (t - k) * (t - k) + lastMaxWindow;
+
+    // reno friendly estimate, 3 * (1 - beta) / (1 + beta) per rtt.
+    renoWindow += 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA)
+        * acked / congestionWindow;
+    if(renoWindow > target) target = renoWindow;
+
+    if(target > congestionWindow) {
+        congestionWindow += (target - congestionWindow) / congestionWindow
+            * acked;
+    } else {
+        // plateau around w_max: creep by at most 1% of a segment per ack.
+        congestionWindow += 0.01 * acked / congestionWindow;
+    }
+    bound();
+}
+
+void Cubic::onFastRetransmit(long now) {
+    reduce();
+}
+
+void Cubic::onTimeout(long now) {
+    reduce();
+    congestionWindow = 1;
+    bound();
+}
+
+void Cubic::reduce() {
+    // fast convergence: give up bandwidth when the last w_max wasn't reached.
+    if(congestionWindow < lastMaxWindow)
+        lastMaxWindow = congestionWindow * (1 + CUBIC_BETA) / 2;
+    else
+        lastMaxWindow = congestionWindow;
+
+    congestionWindow *= CUBIC_BETA;
+    slowStartThreshold = congestionWindow;
+    epochStart = -1;
+    bound();
+}
+
+/*==============================================================================
+        Factory
+*/
+
+CongestionControl *createCongestionControl(const char name[], int maxWindow) {
+    if(strcmp(name, "fixed") == 0) return new FixedWindow(maxWindow);
+    if(strcmp(name, "aimd") == 0) return new Aimd(maxWindow);
+    if(strcmp(name, "newreno") == 0) return new NewReno(maxWindow);
+    if(strcmp(name, "cubic") == 0) return new Cubic(maxWindow);
+    return NULL;
+}
@@ -0,0 +1,96 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _CONGESTIONCONTROL_H_
+#define _CONGESTIONCONTROL_H_
+
+#define DUPACK_THRESHOLD 3 // duplicate acks in a row that signal a loss
+
+// window based congestion controller driven by the sliding window client.
+// windows are in segments and times are in usec. the client calls onAck when
+// the cumulative ack advances, onDupAck for every repeat of the same ack and
+// onTimeout when its retransmission timer expires. with fast retransmit on,
+// onFastRetransmit starts a recovery that ends with the next onAck, and acks
+// that only cover part of the lost window in between come in as onPartialAck.
+class CongestionControl {
+ public:
+    CongestionControl(int maxWindow);
+    virtual ~CongestionControl();
+    virtual const char *name() = 0;                   // for reporting
+    virtual void onAck(int acked, long now, long srtt) = 0;
+    virtual void onDupAck(int dupAcks, long now);     // dupAcks in a row so far
+    virtual void onFastRetransmit(long now);          // loss seen by dup acks
+    virtual void onPartialAck(int acked, long now);   // progress in recovery
+    virtual void onTimeout(long now);                 // back to slow start
+    int window();                                     // usable window, >= 1
+    double cwnd();                                    // congestion window
+    double ssthresh();                                // slow start threshold
+ protected:
+    void slowStart(int acked);                        // cwnd += acked
+    void bound();                                     // keep cwnd in range
+    double congestionWindow;
+    double slowStartThreshold;
+    int maxWindow;                                    // cwnd never grows past
+};
+
+// the original behavior: always windowSize segments, no reaction to loss.
+class FixedWindow : public CongestionControl {
+ public:
+    FixedWindow(int windowSize);
+    const char *name();
+    void onAck(int acked, long now, long srtt);
+    void onFastRetransmit(long now);
+    void onTimeout(long now);
+};
+
+// slow start + additive increase, multiplicative decrease: a fast retransmit
+// halves the window, a timeout restarts slow start from one segment.
+class Aimd : public CongestionControl {
+ public:
+    Aimd(int maxWindow);
+    const char *name();
+    void onAck(int acked, long now, long srtt);
+    void onFastRetransmit(long now);
+};
+
+// reno window halving with newreno fast recovery: the window is inflated by
+// one for each duplicate ack, partial acks deflate it by what they cover and
+// the ack that ends recovery deflates it to ssthresh.
+class NewReno : public CongestionControl {
+ public:
+    NewReno(int maxWindow);
+    const char *name();
+    void onAck(int acked, long now, long srtt);
+    void onDupAck(int dupAcks, long now);
+    void onFastRetransmit(long now);
+    void onPartialAck(int acked, long now);
+    void onTimeout(long now);
+ private:
+    bool inRecovery;
+};
+
+// cubic window growth (RFC 8312) with fast convergence and the tcp friendly
+// region, so it is never slower than reno on short rtts.
+class Cubic : public CongestionControl {
+ public:
+    Cubic(int maxWindow);
+    const char *name();
+    void onAck(int acked, long now, long srtt);
+    void onFastRetransmit(long now);
+    void onTimeout(long now);
+ private:
+    void reduce();              // multiplicative decrease by beta
+    double lastMaxWindow;       // w_max: window before the last reduction
+    double k;                   // seconds until the curve is back at w_max
+    long epochStart;            // start of this growth epoch, -1 if none yet
+    double renoWindow;          // w_est: what reno would have by now
+};
+
+// build the controller called name ("fixed", "aimd", "newreno" or "cubic"),
+// returns NULL if there is no such controller.
+CongestionControl *createCongestionControl(const char name[], int maxWindow);
+
+#endif
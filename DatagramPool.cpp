@@ -0,0 +1,49 @@
+// Project:      CSS432 UDP Socket Class
+// Professor:    Munehiro Fukuda
+// Organization: CSS, University of Washington, Bothell
+// Date:         March 5, 2004
+
+#include "DatagramPool.h"
+
+// Constructor ----------------------------------------------------------------
+DatagramPool::DatagramPool( ) {
+  for ( int c = 0; c < POOLCLASSES; c++ )
+    freeLists[c] = NULL;
+}
+
+// Destructor -----------------------------------------------------------------
+DatagramPool::~DatagramPool( ) {
+  for ( int c = 0; c < POOLCLASSES; c++ )
+    while ( freeLists[c] != NULL ) {
+      char* buffer = freeLists[c];
+      memcpy( &freeLists[c], buffer, sizeof( char* ) );
+      delete[] buffer;
+    }
+}
+
+// The size class of a buffer for length bytes --------------------------------
+int DatagramPool::sizeClass( int length ) {
+  int c = 0;
+  while ( c < POOLCLASSES - 1 && ( POOLMIN << c ) < length )
+    c++;
+  return c;
+}
+
+// Hand out a buffer of at least length bytes ---------------------------------
+char* DatagramPool::take( int length ) {
+  int c = sizeClass( length );
+  if ( freeLists[c] == NULL )
+    return new char[POOLMIN << c];
+
+  // a free buffer's first bytes point at the next free one
+  char* buffer = freeLists[c];
+  memcpy( &freeLists[c], buffer, sizeof( char* ) );
+  return buffer;
+}
+
+// Keep a buffer take( length ) handed out for the next take( ) ---------------
+void DatagramPool::give( char* buffer, int length ) {
+  int c = sizeClass( length );
+  memcpy( buffer, &freeLists[c], sizeof( char* ) );
+  freeLists[c] = buffer;
+}
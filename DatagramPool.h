@@ -0,0 +1,33 @@
+// Project:      CSS432 UDP Socket Class
+// Professor:    Munehiro Fukuda
+// Organization: CSS, University of Washington, Bothell
+// Date:         March 5, 2004
+
+#ifndef _DATAGRAMPOOL_H_
+#define _DATAGRAMPOOL_H_
+
+#include "UdpSocket.h"
+
+#define POOLMIN 2048      // smallest buffer handed out
+#define POOLCLASSES 6     // buffer sizes POOLMIN, 2x that ... 64KB
+
+// Buffers for datagrams held back in memory, in power-of-two sizes up to
+// one that holds MAXMSGSIZE. A buffer given back is kept on a free list of
+// its size and handed out again, so once a queue has been as full as it
+// gets, holding a datagram costs no heap allocation at all, whatever mix
+// of segment sizes goes through. Memory is only freed with the pool.
+class DatagramPool {
+ public:
+  DatagramPool( );
+  ~DatagramPool( );
+  char* take( int );             // a buffer of at least int bytes
+  void give( char*, int );       // put back a buffer take( int ) handed out
+ private:
+  DatagramPool( const DatagramPool& );            // not copyable
+  DatagramPool& operator=( const DatagramPool& );
+  static int sizeClass( int );   // the size a buffer of int bytes comes in
+  char* freeLists[POOLCLASSES];  // free buffers of each size, each one
+                                 // pointing at the next
+};
+
+#endif
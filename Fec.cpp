@@ -0,0 +1,450 @@
+/*
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "Fec.h"
+#include "SeqRing.h"
+#include "Wire.h"
+#include <string.h>
+#include <math.h>
+#include <arpa/inet.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FEC_X86
+#endif
+
+// how many parity segments per expected loss adapt() adds, for headroom
+//     over the average.
+const double FEC_MARGIN = 2.0;
+
+// acked segments the loss counters cover before they are halved, so the
+//     estimate follows the link instead of averaging the whole transfer.
+const double FEC_LOSSWINDOW = 1024;
+
+// marks a parity header, n/k/parity # are in the low three bytes.
+const unsigned int FEC_MAGIC = 0xfe000000u;
+
+/*==============================================================================
+        GF(2^8) arithmetic, polynomial x^8 + x^4 + x^3 + x^2 + 1
+*/
+
+static unsigned char gfExp[512];
+static unsigned char gfLog[256];
+static unsigned char gfMul[256][256];
+// c * x for x < 16, and c * (x << 4): a product is the xor of the two
+//     lookups on its nibbles, which pshufb does 16 or 32 bytes at a time.
+static unsigned char gfLow[256][16];
+static unsigned char gfHigh[256][16];
+// coefficient of data segment i in parity segment j.
+static unsigned char gfCoef[FEC_MAXK][FEC_MAXN];
+
+typedef void (*MulAddKernel)(unsigned char *, const unsigned char *,
+        unsigned char, int);
+static MulAddKernel mulAdd = NULL;
+static const char *kernelName = "scalar";
+
+static unsigned char gfDiv(unsigned char a, unsigned char b) {
+    if(a == 0) return 0;
+    return gfExp[gfLog[a] + 255 - gfLog[b]];
+}
+
+static void mulAddScalar(unsigned char *dst, const unsigned char *src,
+        unsigned char c, int len) {
+    const unsigned char *row = gfMul[c];
+    for(int i = 0; i < len; i++)
+        dst[i] ^= row[src[i]];
+}
+
+#ifdef FEC_X86
+__attribute__((target("ssse3")))
+static void mulAddSsse3(unsigned char *dst, const unsigned char *src,
+        unsigned char c, int len) {
+    __m128i low = _mm_loadu_si128((const __m128i*) gfLow[c]);
+    __m128i high = _mm_loadu_si128((const __m128i*) gfHigh[c]);
+    __m128i nibble = _mm_set1_epi8(0x0f);
+    int i = 0;
+    for(; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i product = _mm_xor_si128(
+                _mm_shuffle_epi8(low, _mm_and_si128(x, nibble)),
+                _mm_shuffle_epi8(high,
+                        _mm_and_si128(_mm_srli_epi64(x, 4), nibble)));
+        __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+        _mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(d, product));
+    }
+    mulAddScalar(dst + i, src + i, c, len - i);
+}
+
+__attribute__((target("avx2")))
+static void mulAddAvx2(unsigned char *dst, const unsigned char *src,
+        unsigned char c, int len) {
+    __m256i low = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*) gfLow[c]));
+    __m256i high = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i*) gfHigh[c]));
+    __m256i nibble = _mm256_set1_epi8(0x0f);
+    int i = 0;
+    for(; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (src + i));
+        __m256i product = _mm256_xor_si256(
+                _mm256_shuffle_epi8(low, _mm256_and_si256(x, nibble)),
+                _mm256_shuffle_epi8(high,
+                        _mm256_and_si256(_mm256_srli_epi64(x, 4), nibble)));
+        __m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+        _mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(d, product));
+    }
+    mulAddScalar(dst + i, src + i, c, len - i);
+}
+#endif
+
+// build the tables and pick the widest kernel this cpu runs, once.
+static void gfInit() {
+    if(mulAdd != NULL) return;
+
+    int x = 1;
+    for(int i = 0; i < 255; i++) {
+        gfExp[i] = gfExp[i + 255] = x;
+        gfLog[x] = i;
+        x <<= 1;
+        if(x & 0x100) x ^= 0x11d;
+    }
+    for(int a = 0; a < 256; a++) {
+        for(int b = 0; b < 256; b++)
+            gfMul[a][b] = (a == 0 || b == 0) ? 0
+                    : gfExp[gfLog[a] + gfLog[b]];
+        for(int n = 0; n < 16; n++) {
+            gfLow[a][n] = gfMul[a][n];
+            gfHigh[a][n] = gfMul[a][n << 4];
+        }
+    }
+
+    // a cauchy matrix 1/(x_j + y_i), x_j = j and y_i = FEC_MAXK + i, has
+    //     every square submatrix invertible, so any k holes can be solved
+    //     for. scaling column i by x_0 + y_i keeps that and makes parity 0
+    //     the plain xor.
+    for(int j = 0; j < FEC_MAXK; j++) {
+        for(int i = 0; i < FEC_MAXN; i++) {
+            unsigned char y = FEC_MAXK + i;
+            gfCoef[j][i] = gfDiv(y, j ^ y);
+        }
+    }
+
+    mulAdd = mulAddScalar;
+    kernelName = "scalar";
+#ifdef FEC_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        mulAdd = mulAddAvx2;
+        kernelName = "avx2";
+    } else if(__builtin_cpu_supports("ssse3")) {
+        mulAdd = mulAddSsse3;
+        kernelName = "ssse3";
+    }
+#endif
+}
+
+void gfMulAdd(char *dst, const char *src, unsigned char c, int len) {
+    gfInit();
+    if(c != 0)
+        mulAdd((unsigned char*) dst, (const unsigned char*) src, c, len);
+}
+
+const char *gfKernel() {
+    gfInit();
+    return kernelName;
+}
+
+// invert the size x size matrix a in place with gauss-jordan elimination.
+//     the cauchy submatrices decoding solves are never singular.
+static void gfInvert(unsigned char a[FEC_MAXK][FEC_MAXK], int size) {
+    unsigned char inv[FEC_MAXK][FEC_MAXK];
+    memset(inv, 0, sizeof(inv));
+    for(int i = 0; i < size; i++) inv[i][i] = 1;
+
+    for(int col = 0; col < size; col++) {
+        int pivot = col;
+        while(a[pivot][col] == 0) pivot++;
+        for(int c = 0; c < size; c++) {
+            unsigned char t = a[col][c]; a[col][c] = a[pivot][c]; a[pivot][c] = t;
+            t = inv[col][c]; inv[col][c] = inv[pivot][c]; inv[pivot][c] = t;
+        }
+        unsigned char scale = gfDiv(1, a[col][col]);
+        for(int c = 0; c < size; c++) {
+            a[col][c] = gfMul[scale][a[col][c]];
+            inv[col][c] = gfMul[scale][inv[col][c]];
+        }
+        for(int r = 0; r < size; r++) {
+            unsigned char f = a[r][col];
+            if(r == col || f == 0) continue;
+            for(int c = 0; c < size; c++) {
+                a[r][c] ^= gfMul[f][a[col][c]];
+                inv[r][c] ^= gfMul[f][inv[col][c]];
+            }
+        }
+    }
+    memcpy(a, inv, sizeof(inv));
+}
+
+bool isParity(const char *datagram, int length, int segSize) {
+    const unsigned int *header = (const unsigned int*) datagram;
+    return length == segSize + FECHDR
+            && (ntohl(header[2]) & 0xff000000u) == FEC_MAGIC;
+}
+
+/*==============================================================================
+        Encoder
+*/
+
+FecEncoder::FecEncoder(int n, int k, int segSize)
+        : n(n < 1 ? 1 : n > FEC_MAXN ? FEC_MAXN : n),
+          k(k < 0 ? 0 : k > FEC_MAXK ? FEC_MAXK : k), segSize(segSize),
+          minK(0), maxK(0), adaptive(false), start(0), connId(0), count(0),
+          sums(new char[FEC_MAXK * segSize]), acked(0), lost(0), made(0) {
+    gfInit();
+}
+
+FecEncoder::~FecEncoder() {
+    delete[] sums;
+}
+
+void FecEncoder::adapt(int minK, int maxK) {
+    this->minK = minK < 0 ? 0 : minK;
+    this->maxK = maxK > FEC_MAXK ? FEC_MAXK : maxK;
+    adaptive = true;
+}
+
+// enough parity for FEC_MARGIN times the losses a group sees on average.
+int FecEncoder::chooseK() {
+    int want = (int) ceil(FEC_MARGIN * loss() * n);
+    if(want < minK) want = minK;
+    if(want > maxK) want = maxK;
+    return want;
+}
+
+int FecEncoder::add(const char *segment, bool last, char *parity[]) {
+    if(count == 0) {
+        start = wireSeq(segment);
+        connId = wireConnId(segment);
+        if(adaptive) k = chooseK();
+        memset(sums, 0, k * segSize);
+    }
+    // parity sums build up as segments go out, so none are kept around.
+    for(int j = 0; j < k; j++)
+        gfMulAdd(sums + j * segSize, segment, gfCoef[j][count], segSize);
+    count++;
+    if(count < n && !last)
+        return 0;
+    return flush(parity);
+}
+
+int FecEncoder::flush(char *parity[]) {
+    if(count == 0)
+        return 0;
+    for(int j = 0; j < k; j++) {
+        unsigned int *header = (unsigned int*) parity[j];
+        header[0] = htonl(start);
+        header[1] = htonl(connId);
+        header[2] = htonl(FEC_MAGIC | (j << 16) | (k << 8) | count);
+        memcpy(parity[j] + FECHDR, sums + j * segSize, segSize);
+    }
+    count = 0;
+    made += k;
+    return k;
+}
+
+void FecEncoder::observe(int acked, int holes) {
+    this->acked += acked;
+    lost += holes;
+    if(this->acked > FEC_LOSSWINDOW) {
+        this->acked /= 2;
+        lost /= 2;
+    }
+}
+
+int FecEncoder::groupSize() {
+    return n;
+}
+
+int FecEncoder::redundancy() {
+    return k;
+}
+
+double FecEncoder::loss() {
+    if(acked <= 0) return 0;
+    return lost < acked ? lost / acked : 1;
+}
+
+long FecEncoder::parities() {
+    return made;
+}
+
+/*==============================================================================
+        Decoder
+*/
+
+FecDecoder::FecDecoder(int windowSize, int segSize)
+        : segSize(segSize), repairs(0) {
+    gfInit();
+    // a group can start up to FEC_MAXN before the oldest hole, and segments
+    //     arrive up to a window past it.
+    int capacity = 1;
+    while(capacity < windowSize + FEC_MAXN) capacity <<= 1;
+    mask = capacity - 1;
+    segments = new char[capacity * segSize];
+    tags = new unsigned int[capacity];
+    held = new bool[capacity];
+    for(int i = 0; i < capacity; i++) held[i] = false;
+
+    parityData = new char[FEC_GROUPS * FEC_MAXK * segSize];
+    for(int g = 0; g < FEC_GROUPS; g++) {
+        groups[g].used = false;
+        groups[g].parity = parityData + g * FEC_MAXK * segSize;
+    }
+    syndromes = new char[FEC_MAXK * segSize];
+    rebuilding = new char[segSize];
+}
+
+FecDecoder::~FecDecoder() {
+    delete[] rebuilding;
+    delete[] syndromes;
+    delete[] parityData;
+    delete[] held;
+    delete[] tags;
+    delete[] segments;
+}
+
+const char *FecDecoder::segment(unsigned int seqNum) {
+    int slot = seqNum & mask;
+    return held[slot] && tags[slot] == seqNum ? segments + slot * segSize
+                                              : NULL;
+}
+
+int FecDecoder::data(unsigned int seqNum, const char *segment,
+        unsigned int expected, unsigned int repaired[]) {
+    // a duplicate, or one before expected, is held already and can't make
+    //     a difference to any group.
+    int slot = seqNum & mask;
+    if(seqLt(seqNum, expected) || (held[slot] && tags[slot] == seqNum))
+        return 0;
+    memcpy(segments + slot * segSize, segment, segSize);
+    tags[slot] = seqNum;
+    held[slot] = true;
+
+    // a resent segment may leave its group few enough holes to repair.
+    for(int g = 0; g < FEC_GROUPS; g++) {
+        Group &group = groups[g];
+        if(group.used && seqGeq(seqNum, group.start)
+                && seqLt(seqNum, group.start + group.n))
+            return repair(group, repaired);
+    }
+    return 0;
+}
+
+int FecDecoder::parity(const char *datagram, unsigned int expected,
+        unsigned int repaired[]) {
+    const unsigned int *header = (const unsigned int*) datagram;
+    unsigned int start = ntohl(header[0]);
+    unsigned int code = ntohl(header[2]);
+    int n = code & 0xff;
+    int k = (code >> 8) & 0xff;
+    int j = (code >> 16) & 0xff;
+    if(n < 1 || n > FEC_MAXN || k > FEC_MAXK || j >= k)
+        return 0;
+    if(seqLeq(start + n, expected))
+        return 0; // the whole group already arrived
+
+    // its group, else a free one, else the oldest gives way.
+    Group *group = NULL;
+    Group *victim = NULL;
+    for(int g = 0; g < FEC_GROUPS; g++) {
+        Group &candidate = groups[g];
+        if(candidate.used && seqLeq(candidate.start + candidate.n, expected))
+            candidate.used = false;
+        if(candidate.used && candidate.start == start) {
+            group = &candidate;
+            break;
+        }
+        if(victim == NULL || (victim->used && (!candidate.used
+                || seqLt(candidate.start, victim->start))))
+            victim = &candidate;
+    }
+    if(group == NULL) {
+        group = victim;
+        group->used = true;
+        group->start = start;
+        group->n = n;
+        group->k = k;
+        group->have = 0;
+    }
+    if(group->have & (1u << j))
+        return 0;
+    memcpy(group->parity + j * segSize, datagram + FECHDR, segSize);
+    group->have |= 1u << j;
+    return repair(*group, repaired);
+}
+
+// solve for the group's holes once it has as many parity segments. each
+//     parity j less the known segments is a sum over the holes only, so the
+//     holes come from inverting the matrix of their coefficients.
+int FecDecoder::repair(Group &group, unsigned int repaired[]) {
+    int holes[FEC_MAXK];
+    int holeCount = 0;
+    for(int i = 0; i < group.n; i++) {
+        if(segment(group.start + i) != NULL) continue;
+        if(holeCount == group.k) return 0; // too many to solve yet
+        holes[holeCount++] = i;
+    }
+    if(holeCount == 0) {
+        group.used = false;
+        return 0;
+    }
+    int rows[FEC_MAXK];
+    int rowCount = 0;
+    for(int j = 0; j < group.k && rowCount < holeCount; j++)
+        if(group.have & (1u << j)) rows[rowCount++] = j;
+    if(rowCount < holeCount)
+        return 0;
+
+    unsigned char a[FEC_MAXK][FEC_MAXK];
+    for(int r = 0; r < holeCount; r++) {
+        char *syndrome = syndromes + r * segSize;
+        memcpy(syndrome, group.parity + rows[r] * segSize, segSize);
+        for(int i = 0, h = 0; i < group.n; i++) {
+            if(h < holeCount && holes[h] == i) {
+                a[r][h++] = gfCoef[rows[r]][i];
+                continue;
+            }
+            gfMulAdd(syndrome, segment(group.start + i),
+                    gfCoef[rows[r]][i], segSize);
+        }
+    }
+    gfInvert(a, holeCount);
+
+    int count = 0;
+    for(int h = 0; h < holeCount; h++) {
+        unsigned int seqNum = group.start + holes[h];
+        int slot = seqNum & mask;
+        memset(rebuilding, 0, segSize);
+        for(int r = 0; r < holeCount; r++)
+            gfMulAdd(rebuilding, syndromes + r * segSize, a[h][r], segSize);
+        // a rebuilt segment carries its own header and checksum, which a
+        //     corrupt parity segment leaves wrong. the slot keeps what it
+        //     held until one checks out.
+        WireHeader header;
+        if(!wireRead(rebuilding, segSize, header) || header.seq != seqNum)
+            continue;
+        memcpy(segments + slot * segSize, rebuilding, segSize);
+        tags[slot] = seqNum;
+        held[slot] = true;
+        repaired[count++] = seqNum;
+    }
+    repairs += count;
+    group.used = false;
+    return count;
+}
+
+long FecDecoder::rebuilt() {
+    return repairs;
+}
@@ -0,0 +1,115 @@
+/*
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _FEC_H_
+#define _FEC_H_
+
+#include "UdpSocket.h"
+
+#define FEC_MAXN 64                // data segments per group at most
+#define FEC_MAXK 8                 // parity segments per group at most
+#define FECHDR 12                  // group start, conn id, n/k/parity #, all
+                                   //     in network order
+#define FECSIZE (MSGSIZE + FECHDR) // a parity datagram of MSGSIZE segments
+#define FEC_MAXSEGSIZE (MAXMSGSIZE - FECHDR) // largest segment whose parity
+                                   //     still fits in a datagram
+#define FEC_GROUPS 32              // groups a decoder holds parity for
+
+// dst ^= c * src over len bytes in GF(2^8), the one kernel coding runs on.
+//     uses AVX2 or SSSE3 table lookups when the cpu has them.
+void gfMulAdd(char *dst, const char *src, unsigned char c, int len);
+const char *gfKernel();            // "avx2", "ssse3" or "scalar"
+
+// is a datagram of length bytes a parity segment of segSize segments
+//     rather than data
+bool isParity(const char *datagram, int length, int segSize);
+
+// sender side of forward error correction. segments are coded in groups of
+// n as they are first sent, and k parity segments follow each group, so the
+// receiver can rebuild any k of the group's n + k that go missing without a
+// retransmission. the code is a systematic Reed-Solomon one over GF(2^8)
+// whose first parity is the plain xor of the group, so k = 1 is xor parity.
+// every segment is segSize bytes, at most FEC_MAXSEGSIZE.
+class FecEncoder {
+ public:
+    FecEncoder(int n, int k, int segSize = MSGSIZE);
+    ~FecEncoder();
+    // pick k per group from the loss rate acks show, between minK and maxK.
+    void adapt(int minK, int maxK);
+    // code segment, segSize bytes sent for the first time. once its group
+    //     is full, or last ends the transfer early, writes the group's
+    //     parity datagrams (segSize + FECHDR bytes each) to parity[] and
+    //     returns how many, else returns 0.
+    int add(const char *segment, bool last, char *parity[]);
+    int flush(char *parity[]);     // end the group early, as add() does
+    void observe(int acked, int holes); // segments acked, holes seen at the
+                                   //     base of the window since last time
+    int groupSize();               // n
+    int redundancy();              // k of the group being coded
+    double loss();                 // estimated segment loss rate
+    long parities();               // parity datagrams made so far
+ private:
+    FecEncoder(const FecEncoder &); // not copyable
+    FecEncoder &operator=(const FecEncoder &);
+    int chooseK();
+    int n;
+    int k;
+    int segSize;
+    int minK, maxK;
+    bool adaptive;
+    unsigned int start;            // first seq # of the group being coded
+    unsigned int connId;
+    int count;                     // segments in it so far
+    char *sums;                    // its k parity sums, segSize each
+    double acked, lost;            // decaying loss counters
+    long made;
+};
+
+// receiver side: keeps every data segment around for about a window, and
+// the parity of the groups in it, and rebuilds lost segments once a group
+// has as many parity segments as holes. segments are segSize bytes, the
+// same as the encoder's.
+class FecDecoder {
+ public:
+    FecDecoder(int windowSize, int segSize = MSGSIZE);
+    ~FecDecoder();
+    // take in data segment seqNum, or a parity datagram. expected is the
+    //     receiver's next in-order seq #, anything before it is done and
+    //     held already, like any segment that arrives twice. both
+    //     return how many segments they rebuilt, whose seq #s are put in
+    //     repaired[], FEC_MAXK of them at most.
+    int data(unsigned int seqNum, const char *segment, unsigned int expected,
+            unsigned int repaired[]);
+    int parity(const char *datagram, unsigned int expected,
+            unsigned int repaired[]);
+    const char *segment(unsigned int seqNum); // held copy, or NULL
+    long rebuilt();                // segments rebuilt so far
+ private:
+    struct Group {
+        bool used;
+        unsigned int start;        // first seq #
+        int n;
+        int k;
+        unsigned int have;         // bit j: parity segment j arrived
+        char *parity;              // k of them, segSize each
+    };
+    FecDecoder(const FecDecoder &); // not copyable
+    FecDecoder &operator=(const FecDecoder &);
+    int repair(Group &group, unsigned int repaired[]);
+    Group groups[FEC_GROUPS];
+    char *parityData;
+    char *segments;                // ring of data segments, segSize each
+    unsigned int *tags;            // seq # held in each slot
+    bool *held;
+    unsigned int mask;             // ring capacity - 1
+    char *syndromes;               // scratch, FEC_MAXK * segSize
+    char *rebuilding;              // scratch, one segment checked before
+                                   //     it goes into the ring
+    int segSize;
+    long repairs;
+};
+
+#endif
@@ -0,0 +1,228 @@
+// Project:      CSS432 UDP Socket Class
+// Professor:    Munehiro Fukuda
+// Organization: CSS, University of Washington, Bothell
+// Date:         March 5, 2004
+
+#include "Impairment.h"
+
+// Constructor ----------------------------------------------------------------
+Impairment::Impairment( unsigned long seed )
+  : seed( seed ), lossGood( 0 ), lossBad( 0 ), toBad( 0 ), toGood( 1 ),
+    delayUsec( 0 ), jitterUsec( 0 ), reorderRate( 0 ), reorderUsec( 0 ),
+    duplicateRate( 0 ), rate( 0 ), queueBytes( 0 ) {
+  heap = new Held[IMPAIRQUEUE];
+  count = 0;
+  reset( );
+}
+
+// Destructor -----------------------------------------------------------------
+Impairment::~Impairment( ) {
+  for ( int i = 0; i < count; i++ )
+    pool.give( heap[i].data, heap[i].length );
+  delete[] heap;
+}
+
+// Lose each datagram on its own with probability loss ------------------------
+void Impairment::bernoulli( double loss ) {
+
+  // a gilbert-elliott channel that never leaves the good state
+  gilbertElliott( 0, 1, loss, loss );
+}
+
+// Lose datagrams in bursts ---------------------------------------------------
+void Impairment::gilbertElliott( double toBad, double toGood,
+				 double lossGood, double lossBad ) {
+
+  // the channel moves between a good and a bad state once per datagram, so
+  // bursts last 1/toGood datagrams on average and come every 1/toBad
+  this->toBad = toBad;
+  this->toGood = toGood;
+  this->lossGood = lossGood;
+  this->lossBad = lossBad;
+}
+
+// Hold each datagram usec, plus up to jitter usec more -----------------------
+void Impairment::delay( long usec, long jitter ) {
+
+  // like netem, a jitter wider than the gap between two datagrams reorders
+  // them too
+  delayUsec = usec;
+  jitterUsec = jitter;
+}
+
+// Hold a share of the datagrams back long enough for later ones to pass ------
+void Impairment::reorder( double share, long usec ) {
+  reorderRate = share;
+  reorderUsec = usec;
+}
+
+// Deliver a share of the datagrams twice -------------------------------------
+void Impairment::duplicate( double share ) {
+  duplicateRate = share;
+}
+
+// Cap the link at bytesPerSec with a queue of queue bytes in front -----------
+void Impairment::bandwidth( long bytesPerSec, int queue ) {
+  rate = bytesPerSec;
+  queueBytes = queue;
+}
+
+// Start over as if just constructed with the same settings -------------------
+void Impairment::reset( ) {
+  state = seed;
+  bad = false;
+  linkFree = 0;
+  for ( int i = 0; i < count; i++ )
+    pool.give( heap[i].data, heap[i].length );
+  count = 0;
+  arrivals = 0;
+  nPassed = nDropped = nDuplicated = nReordered = 0;
+  started = false;
+}
+
+long Impairment::passed( ) {
+  return nPassed;
+}
+
+long Impairment::dropped( ) {
+  return nDropped;
+}
+
+long Impairment::duplicated( ) {
+  return nDuplicated;
+}
+
+long Impairment::reordered( ) {
+  return nReordered;
+}
+
+// Next number from a splitmix64 generator, scaled to [0, 1) ------------------
+double Impairment::uniform( ) {
+  uint64_t z = ( state += 0x9e3779b97f4a7c15ULL );
+  z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+  z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return ( z >> 11 ) * ( 1.0 / 9007199254740992.0 ); // 53 bits
+}
+
+// Step the channel and decide whether it loses this datagram -----------------
+bool Impairment::lose( ) {
+  double change = uniform( );
+  if ( bad ? change < toGood : change < toBad )
+    bad = !bad;
+  return uniform( ) < ( bad ? lossBad : lossGood );
+}
+
+// Take in a datagram the socket received -------------------------------------
+void Impairment::arrive( char msg[], int length, struct sockaddr& addr ) {
+  if ( !started ) {
+    clock.start( );
+    started = true;
+  }
+  long now = clock.lap( );
+  arrivals++;
+  if ( lose( ) ) {
+    nDropped++;
+    return;
+  }
+
+  // the capped link sends one datagram after the other, and drops those
+  // that find its queue full
+  double at = now;
+  if ( rate > 0 ) {
+    double start = ( linkFree > now ) ? linkFree : now;
+    if ( ( start - now ) * rate / 1000000 + length > queueBytes ) {
+      nDropped++;
+      return;
+    }
+    linkFree = start + length * 1000000.0 / rate;
+    at = linkFree;
+  }
+  at += delayUsec;
+  if ( jitterUsec > 0 )
+    at += uniform( ) * jitterUsec;
+  if ( reorderRate > 0 && uniform( ) < reorderRate ) {
+    at += reorderUsec;
+    nReordered++;
+  }
+  hold( msg, length, addr, (long)at );
+  if ( duplicateRate > 0 && uniform( ) < duplicateRate ) {
+    hold( msg, length, addr, (long)at );
+    nDuplicated++;
+  }
+}
+
+// Queue a datagram until release ---------------------------------------------
+void Impairment::hold( char msg[], int length, struct sockaddr& addr,
+		       long release ) {
+  if ( count == IMPAIRQUEUE ) {   // more in flight than the link can hold
+    nDropped++;
+    return;
+  }
+
+  // each gets a pooled buffer of its size, datagrams run up to 64KB
+  Held& held = heap[count];
+  held.release = release;
+  held.order = arrivals;
+  held.length = length;
+  held.addr = addr;
+  held.data = pool.take( length );
+  memcpy( held.data, msg, length );
+
+  // sift it up to its place in the heap
+  for ( int i = count++; i > 0 && before( i, ( i - 1 ) / 2 ); i = ( i - 1 ) / 2 )
+    swap( i, ( i - 1 ) / 2 );
+}
+
+// Has the first datagram's time come -----------------------------------------
+bool Impairment::ready( ) {
+  return count > 0 && heap[0].release <= clock.lap( );
+}
+
+// Usec until the first datagram's time comes ---------------------------------
+long Impairment::nextRelease( ) {
+  if ( count == 0 )
+    return -1;
+  long left = heap[0].release - clock.lap( );
+  return ( left > 0 ) ? left : 0;
+}
+
+// Hand out the first datagram into msg[] of size bytes -----------------------
+int Impairment::take( char msg[], int size, struct sockaddr& addr ) {
+  if ( !ready( ) )
+    return -1;
+  Held held = heap[0];
+  int length = ( held.length < size ) ? held.length : size;
+  memcpy( msg, held.data, length );
+  addr = held.addr;
+  pool.give( held.data, held.length );
+  nPassed++;
+
+  // move the last one to the top and sift it down
+  heap[0] = heap[--count];
+  for ( int i = 0; ; ) {
+    int first = i;
+    int left = 2 * i + 1, right = 2 * i + 2;
+    if ( left < count && before( left, first ) )
+      first = left;
+    if ( right < count && before( right, first ) )
+      first = right;
+    if ( first == i )
+      break;
+    swap( i, first );
+    i = first;
+  }
+  return length;
+}
+
+// Is heap entry a due before heap entry b ------------------------------------
+bool Impairment::before( int a, int b ) {
+  return heap[a].release < heap[b].release
+    || ( heap[a].release == heap[b].release && heap[a].order < heap[b].order );
+}
+
+void Impairment::swap( int a, int b ) {
+  Held t = heap[a];
+  heap[a] = heap[b];
+  heap[b] = t;
+}
@@ -0,0 +1,87 @@
+// Project:      CSS432 UDP Socket Class
+// Professor:    Munehiro Fukuda
+// Organization: CSS, University of Washington, Bothell
+// Date:         March 5, 2004
+
+#ifndef _IMPAIRMENT_H_
+#define _IMPAIRMENT_H_
+
+#include "UdpSocket.h"
+#include "Timer.h"
+#include "DatagramPool.h"
+
+#define IMPAIRQUEUE 4096  // max # datagrams held back at once
+
+// A simulated link in front of a UdpSocket's receive side, what netem does
+// without root or tc. Every datagram the socket receives goes through it:
+// it may be lost (independently or in bursts), queued behind a bandwidth
+// cap, delayed with jitter, held back past later ones or duplicated, and is
+// only handed out once its time comes. Every choice comes from a generator
+// seeded in the constructor, so a seed replays the same impairments. Put
+// one on each end to impair both directions.
+class Impairment {
+ public:
+  Impairment( unsigned long );   // seed
+  ~Impairment( );
+  void bernoulli( double );      // lose each datagram with probability double
+  void gilbertElliott( double, double, double, double ); // burst loss: go
+                                 // bad with probability double, good again
+                                 // with double; lose double when good and
+                                 // double when bad
+  void delay( long, long );      // hold each datagram long usec, plus up to
+                                 // long usec of uniform jitter
+  void reorder( double, long );  // hold double of them long usec more, so
+                                 // later ones overtake them
+  void duplicate( double );      // deliver double of them twice
+  void bandwidth( long, int );   // let long bytes/sec through, queueing up
+                                 // to int bytes and dropping beyond that
+  void reset( );                 // empty the queue, zero the counters and
+                                 // replay the seed from the start
+  long passed( );                // datagrams handed out
+  long dropped( );               // lost, in the loss model or the queue
+  long duplicated( );
+  long reordered( );
+
+  // used by UdpSocket
+  void arrive( char[], int, struct sockaddr& ); // take in a datagram
+  bool ready( );                 // has a datagram's time come
+  long nextRelease( );           // usec until the next one's does, -1: none
+  int take( char[], int, struct sockaddr& ); // hand out the next ready one
+                                 // into char[] of int size; return its size
+ private:
+  struct Held {                  // a datagram waiting for its time
+    long release;                // usec on clock
+    unsigned long order;         // arrival order, breaks ties
+    int length;
+    struct sockaddr addr;
+    char* data;                  // from pool
+  };
+  Impairment( const Impairment& );            // not copyable
+  Impairment& operator=( const Impairment& );
+  double uniform( );             // next random number in [0, 1)
+  bool lose( );                  // the loss model's verdict on one datagram
+  void hold( char[], int, struct sockaddr&, long ); // queue it until long
+  bool before( int, int );       // heap order of two entries
+  void swap( int, int );
+  unsigned long seed;
+  unsigned long state;           // the generator's state
+  double lossGood, lossBad;      // loss rate in each state
+  double toBad, toGood;          // state change probabilities
+  bool bad;                      // in the bad (bursty) state
+  long delayUsec, jitterUsec;
+  double reorderRate;
+  long reorderUsec;
+  double duplicateRate;
+  long rate;                     // bytes/sec, 0: no cap
+  int queueBytes;
+  double linkFree;               // when the capped link is done sending
+  Held* heap;                    // min-heap of held datagrams by release
+  DatagramPool pool;             // what they're held in
+  int count;                     // # held
+  unsigned long arrivals;
+  long nPassed, nDropped, nDuplicated, nReordered;
+  bool started;                  // clock starts at the first arrival, on
+  Timer clock;                   // whichever clock Timer reads by then
+};
+
+#endif
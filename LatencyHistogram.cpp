@@ -0,0 +1,112 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "LatencyHistogram.h"
+#include <string.h>
+
+// a long has 63 value bits: bucket 0 holds the values below 2^HIST_SUBBITS,
+//     and each further bit of magnitude adds one more set of sub-buckets.
+const int HIST_SUBS = 1 << HIST_SUBBITS;
+const int HIST_BUCKETS = (63 - HIST_SUBBITS + 1) * HIST_SUBS;
+
+LatencyHistogram::LatencyHistogram() {
+    counts = new long[HIST_BUCKETS];
+    reset();
+}
+
+LatencyHistogram::~LatencyHistogram() {
+    delete[] counts;
+}
+
+void LatencyHistogram::reset() {
+    memset(counts, 0, HIST_BUCKETS * sizeof(long));
+    total = 0;
+    smallest = largest = 0;
+    sum = 0;
+}
+
+int LatencyHistogram::bucket(long value) {
+    if(value < HIST_SUBS)
+        return value;
+    int msb = 63 - __builtin_clzl(value);
+    int shift = msb - HIST_SUBBITS;
+    return ((shift + 1) << HIST_SUBBITS) + (int) (value >> shift) - HIST_SUBS;
+}
+
+long LatencyHistogram::highest(int index) {
+    if(index < HIST_SUBS)
+        return index;
+    int shift = (index >> HIST_SUBBITS) - 1;
+    long sub = HIST_SUBS + (index & (HIST_SUBS - 1));
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(long value) {
+    if(value < 0)
+        value = 0;
+    counts[bucket(value)]++;
+    if(total == 0 || value < smallest)
+        smallest = value;
+    if(value > largest)
+        largest = value;
+    total++;
+    sum += value;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    if(other.total == 0)
+        return;
+    for(int i = 0; i < HIST_BUCKETS; i++)
+        counts[i] += other.counts[i];
+    if(total == 0 || other.smallest < smallest)
+        smallest = other.smallest;
+    if(other.largest > largest)
+        largest = other.largest;
+    total += other.total;
+    sum += other.sum;
+}
+
+long LatencyHistogram::count() {
+    return total;
+}
+
+long LatencyHistogram::min() {
+    return smallest;
+}
+
+long LatencyHistogram::max() {
+    return largest;
+}
+
+double LatencyHistogram::mean() {
+    return total > 0 ? sum / total : 0;
+}
+
+long LatencyHistogram::percentile(double percent) {
+    if(total == 0)
+        return 0;
+    // the rank-th smallest value, rank counted from 1.
+    long rank = (long) (percent / 100 * total + 0.5);
+    if(rank < 1) rank = 1;
+    if(rank > total) rank = total;
+    long seen = 0;
+    for(int i = 0; i < HIST_BUCKETS; i++) {
+        seen += counts[i];
+        if(seen >= rank)
+            return highest(i) < largest ? highest(i) : largest;
+    }
+    return largest;
+}
+
+void LatencyHistogram::print(std::ostream &out, const char *unit) {
+    out << "count = " << total << " mean = " << (long) mean() << unit
+        << " p50 = " << percentile(50) << unit
+        << " p90 = " << percentile(90) << unit
+        << " p99 = " << percentile(99) << unit
+        << " p99.9 = " << percentile(99.9) << unit
+        << " p99.99 = " << percentile(99.99) << unit
+        << " max = " << largest << unit << std::endl;
+}
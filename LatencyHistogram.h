@@ -0,0 +1,45 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _LATENCYHISTOGRAM_H_
+#define _LATENCYHISTOGRAM_H_
+
+#include <iostream>
+
+#define HIST_SUBBITS 6     // 64 linear buckets per power of two: <1.6% error
+
+// log-linear (hdr style) histogram of non-negative values, usually nsec.
+// values below 2^HIST_SUBBITS get a bucket each; above that, every power of
+// two is split into 2^HIST_SUBBITS equal buckets, so a bucket is never wider
+// than 1/64 of the values in it. recording is a bit scan, a shift and an
+// increment, cheap enough for every segment; memory is fixed at ~30KB.
+class LatencyHistogram {
+ public:
+    LatencyHistogram();
+    ~LatencyHistogram();
+    void record(long value);       // negative values count as 0
+    void merge(const LatencyHistogram &other); // add other's values
+    void reset();
+    long count();
+    long min();                    // 0 when empty
+    long max();
+    double mean();
+    long percentile(double percent); // the value percent of all are at or
+                                   //     below, to within a bucket
+    void print(std::ostream &out, const char *unit); // count, mean and the
+                                   //     p50/p90/p99/p99.9/p99.99/max line
+ private:
+    static int bucket(long value);
+    static long highest(int bucket); // the largest value in bucket
+    long *counts;
+    long total;
+    long smallest, largest;
+    double sum;
+    LatencyHistogram(const LatencyHistogram &);            // not copyable
+    LatencyHistogram &operator=(const LatencyHistogram &);
+};
+
+#endif
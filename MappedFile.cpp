@@ -0,0 +1,97 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "MappedFile.h"
+#include "Wire.h"
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+MappedFile::MappedFile() : fd(-1), bytes(NULL), size(0) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::openRead(const char *path) {
+    close();
+    struct stat st;
+    if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        close();
+        return false;
+    }
+    size = st.st_size;
+    if(!map(PROT_READ)) {
+        perror(path);
+        close();
+        return false;
+    }
+    // segments are read front to back, let the kernel read ahead for them.
+    if(bytes != NULL) madvise(bytes, size, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool MappedFile::create(const char *path, long length) {
+    close();
+    if((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0
+            || ftruncate(fd, length) < 0) {
+        perror(path);
+        close();
+        return false;
+    }
+    // blocks allocated now can't run out halfway, which would be a SIGBUS
+    //     on a store into the mapping. not every file system can.
+    size = length;
+#ifdef __linux__
+    if(length > 0) posix_fallocate(fd, 0, length);
+#endif
+    if(!map(PROT_READ | PROT_WRITE)) {
+        perror(path);
+        close();
+        return false;
+    }
+    // the first store to a page of a file costs a fault and the file
+    //     system's bookkeeping, ~2x the transfer time on ext4: pay it now.
+#ifdef MADV_POPULATE_WRITE
+    if(bytes != NULL) madvise(bytes, size, MADV_POPULATE_WRITE);
+#endif
+    return true;
+}
+
+// an empty file has nothing to map, and needs nothing mapped either.
+bool MappedFile::map(int prot) {
+    if(size == 0) return true;
+    void *mapped = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED) return false;
+    bytes = (char *) mapped;
+    return true;
+}
+
+void MappedFile::close() {
+    if(bytes != NULL) munmap(bytes, size);
+    if(fd >= 0) ::close(fd);
+    fd = -1;
+    bytes = NULL;
+    size = 0;
+}
+
+char *MappedFile::data() {
+    return bytes;
+}
+
+long MappedFile::length() {
+    return size;
+}
+
+int segmentsFor(long length, int segSize) {
+    long payload = segSize - WIRE_HDR;
+    return (int) ((length + payload - 1) / payload);
+}
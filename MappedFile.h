@@ -0,0 +1,38 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _MAPPEDFILE_H_
+#define _MAPPEDFILE_H_
+
+// a file mapped into memory for a transfer: read only to send from, or
+// created at its final length to receive into. segments go out of and come
+// into the mapping itself, so the page cache holds the only copy of the
+// data on either end and there are no read() or write() calls at all.
+class MappedFile {
+ public:
+    MappedFile();
+    ~MappedFile();
+    bool openRead(const char *path); // map the whole file to read from
+    bool create(const char *path, long length); // make path length bytes
+                                   //     long and map it to write into, all
+                                   //     allocated and faulted in up front
+    void close();                  // unmap it, written back by the kernel
+    char *data();                  // NULL if nothing is mapped or it is empty
+    long length();
+ private:
+    MappedFile(const MappedFile &); // not copyable
+    MappedFile &operator=(const MappedFile &);
+    bool map(int prot);
+    int fd;
+    char *bytes;
+    long size;
+};
+
+// # of segments of segSize bytes, a WIRE_HDR header and the rest payload,
+//     that it takes to carry length bytes.
+int segmentsFor(long length, int segSize);
+
+#endif
@@ -0,0 +1,81 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "Pacer.h"
+#include <math.h>
+
+// pace a little faster than cwnd/srtt, so the window and not the pacer
+// stays what limits the sender, as Linux's fq does.
+const double PACE_GAIN = 1.2;
+
+// "no limit" for allowance(), more than any window.
+const int PACE_UNLIMITED = 1 << 30;
+
+Pacer::Pacer(long rateCap, int segSize, int burst)
+        : rateCap(rateCap), segSize(segSize), burst(burst), perUsec(0),
+          tokens(burst), last(-1), heldSince(-1), held(0) {
+}
+
+void Pacer::setRate(int cwnd, long srtt) {
+    double rate = srtt > 0 ? PACE_GAIN * cwnd / srtt : 0;
+    double cap = rateCap > 0 ? rateCap / (double) segSize / 1000000 : 0;
+    if(cap > 0 && (rate == 0 || cap < rate))
+        rate = cap;
+    perUsec = rate;
+}
+
+void Pacer::refill(long now) {
+    if(last >= 0 && perUsec > 0) {
+        tokens += (now - last) * perUsec;
+        if(tokens > burst)
+            tokens = burst;
+    }
+    last = now;
+}
+
+int Pacer::allowance(long now) {
+    if(perUsec <= 0)
+        return PACE_UNLIMITED;
+    refill(now);
+    if(tokens < 1) {
+        // a send wants to go but has to wait: start counting the delay.
+        if(heldSince < 0)
+            heldSince = now;
+        return 0;
+    }
+    return (int) tokens;
+}
+
+void Pacer::sent(int segments, long now) {
+    if(heldSince >= 0) {
+        held += now - heldSince;
+        heldSince = -1;
+    }
+    charge(segments, now);
+}
+
+void Pacer::charge(int segments, long now) {
+    refill(now);
+    if(perUsec > 0)
+        tokens -= segments;
+}
+
+long Pacer::nextRelease(long now) {
+    if(perUsec <= 0)
+        return 0;
+    refill(now);
+    if(tokens >= 1)
+        return 0;
+    return (long) ceil((1 - tokens) / perUsec);
+}
+
+long Pacer::delay() {
+    return held;
+}
+
+long Pacer::rate() {
+    return (long) (perUsec * segSize * 1000000);
+}
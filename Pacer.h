@@ -0,0 +1,38 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _PACER_H_
+#define _PACER_H_
+
+// token bucket that spreads a window's segments over an rtt instead of
+// sending them back to back. tokens are segments and refill at the pacing
+// rate, up to burst of them. all times are in usec on the sender's clock.
+class Pacer {
+ public:
+    // rateCap: bytes/sec to pace at, 0 paces at cwnd/srtt alone.
+    //     segSize: bytes per segment. burst: segments sent back to back.
+    Pacer(long rateCap, int segSize, int burst);
+    void setRate(int cwnd, long srtt); // pace at cwnd/srtt, or the cap if
+                                   //     lower. no srtt and no cap: unpaced
+    int allowance(long now);       // # segments that may be sent now
+    void sent(int segments, long now);   // segments were sent as allowed
+    void charge(int segments, long now); // segments went out unpaced
+    long nextRelease(long now);    // usec until a segment may be sent
+    long delay();                  // total usec sends were held back
+    long rate();                   // current rate in bytes/sec, 0 unpaced
+ private:
+    void refill(long now);
+    long rateCap;
+    int segSize;
+    int burst;
+    double perUsec;                // segments per usec, 0 means unpaced
+    double tokens;                 // below 0 after unpaced sends
+    long last;                     // when tokens were last refilled
+    long heldSince;                // when a send was first held back, or -1
+    long held;                     // total usec sends were held back
+};
+
+#endif
@@ -0,0 +1,70 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "Pmtu.h"
+#include "Timer.h"
+#include "Sack.h"
+
+// the largest datagram of each common link mtu, less the IPv4 and UDP
+//     headers, from the largest down.
+const int PMTU_SIZES[] = { 9000 - 28, 1500 - 28, 1280 - 28 };
+const int PMTU_NSIZES = sizeof(PMTU_SIZES) / sizeof(PMTU_SIZES[0]);
+
+// send a probe of size bytes until the peer replies to it or PMTU_TRIES of
+//     them went unanswered.
+static bool probe(UdpSocket &sock, char *datagram, int size,
+        unsigned int connId) {
+    wireWrite(datagram, size, WireHeader(WIRE_PROBE, size, 0, 0, connId));
+    SackAck reply;   // room for anything else that comes back meanwhile
+    Timer timer;
+    for(int t = 0; t < PMTU_TRIES; t++) {
+        // with DF set, a size past the local link's mtu fails right here.
+        if(sock.sendTo(datagram, size) < 0)
+            return false;
+        timer.start();
+        long left;
+        while((left = PMTU_TIMEOUT - timer.lap()) > 0
+                && sock.waitRecvFrom(left) > 0) {
+            WireHeader header;
+            int length = sock.recvFrom((char*) &reply, sizeof(reply));
+            if(wireRead((char*) &reply, length, header)
+                    && header.flags == (WIRE_ACK | WIRE_PROBE)
+                    && header.ack == (unsigned int) size
+                    && header.connId == connId)
+                return true;
+        }
+    }
+    return false;
+}
+
+int probePathMtu(UdpSocket &sock, unsigned int connId, int minSize,
+        int maxSize) {
+    char *datagram = new char[maxSize];
+    memset(datagram, 0, maxSize);
+    int found = minSize;
+    if(maxSize > minSize && probe(sock, datagram, maxSize, connId)) {
+        found = maxSize;
+    } else {
+        for(int i = 0; i < PMTU_NSIZES; i++) {
+            int size = PMTU_SIZES[i];
+            if(size >= maxSize || size <= minSize) continue;
+            if(probe(sock, datagram, size, connId)) {
+                found = size;
+                break;
+            }
+        }
+    }
+    delete[] datagram;
+    return found;
+}
+
+int answerProbe(const WireHeader &header, char reply[]) {
+    if(header.flags != WIRE_PROBE)
+        return 0;
+    wireWrite(reply, WIRE_HDR,
+            WireHeader(WIRE_ACK | WIRE_PROBE, 0, header.seq, 0, header.connId));
+    return WIRE_HDR;
+}
@@ -0,0 +1,31 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _PMTU_H_
+#define _PMTU_H_
+
+#include "UdpSocket.h"
+#include "Wire.h"
+
+#define PMTU_TRIES 3          // probes of a size lost before it is too big
+#define PMTU_TIMEOUT 200000   // usec to wait for the reply to a probe
+
+// find the largest datagram, between minSize and maxSize bytes, that gets
+// to the peer of sock, the way DPLPMTUD (RFC 8899) does over UDP: send
+// padded probes and only count a size as good once the peer's reply to it
+// comes back. maxSize is tried first, then the common link sizes below it
+// (jumbo ethernet, ethernet, the IPv6 minimum). sock should have probeMtu()
+// on, so nothing is fragmented and sizes past the local link fail at once.
+// the peer answers from its receive loop, before and during a transfer.
+// returns minSize if nothing larger gets through.
+int probePathMtu(UdpSocket &sock, unsigned int connId, int minSize,
+        int maxSize);
+
+// the receiving end: if header is a probe's, write the reply to it into
+// reply, WIRE_HDR bytes, and return its length; else return 0.
+int answerProbe(const WireHeader &header, char reply[]);
+
+#endif
@@ -0,0 +1,79 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "ProtocolStats.h"
+#include <string.h>
+
+volatile sig_atomic_t ProtocolStats::generation = 0;
+
+ProtocolStats::ProtocolStats() : connId(0) {
+    reset();
+}
+
+void ProtocolStats::reset() {
+    segmentsSent = bytesSent = 0;
+    timeoutRetransmits = fastRetransmits = timeouts = 0;
+    acksReceived = dupAcks = 0;
+    windowStalls = windowLimitedUsec = windowProbes = 0;
+    segmentsDelivered = bytesDelivered = 0;
+    segmentsReceived = outOfOrder = spuriousRetransmits = acksSent = 0;
+    windowUpdates = 0;
+    corrupt = 0;
+    seen = generation;
+}
+
+void ProtocolStats::sent(const int lengths[], int count) {
+    for(int i = 0; i < count; i++)
+        bytesSent += lengths[i];
+    segmentsSent += count;
+}
+
+long ProtocolStats::retransmits() {
+    return timeoutRetransmits + fastRetransmits;
+}
+
+std::ostream &ProtocolStats::json(std::ostream &out) {
+    out << "{\"connId\": " << connId
+        << ", \"segmentsSent\": " << segmentsSent
+        << ", \"bytesSent\": " << bytesSent
+        << ", \"retransmits\": " << retransmits()
+        << ", \"timeoutRetransmits\": " << timeoutRetransmits
+        << ", \"fastRetransmits\": " << fastRetransmits
+        << ", \"timeouts\": " << timeouts
+        << ", \"acksReceived\": " << acksReceived
+        << ", \"dupAcks\": " << dupAcks
+        << ", \"windowStalls\": " << windowStalls
+        << ", \"windowLimitedUsec\": " << windowLimitedUsec
+        << ", \"windowProbes\": " << windowProbes
+        << ", \"segmentsDelivered\": " << segmentsDelivered
+        << ", \"bytesDelivered\": " << bytesDelivered
+        << ", \"segmentsReceived\": " << segmentsReceived
+        << ", \"outOfOrder\": " << outOfOrder
+        << ", \"spuriousRetransmits\": " << spuriousRetransmits
+        << ", \"acksSent\": " << acksSent
+        << ", \"windowUpdates\": " << windowUpdates
+        << ", \"corrupt\": " << corrupt << "}";
+    return out;
+}
+
+void ProtocolStats::requested(int signo) {
+    generation++;
+}
+
+void ProtocolStats::dumpOnSignal() {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requested;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+}
+
+bool ProtocolStats::dumpDue() {
+    if(seen == generation)
+        return false;
+    seen = generation;
+    return true;
+}
@@ -0,0 +1,62 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _PROTOCOLSTATS_H_
+#define _PROTOCOLSTATS_H_
+
+#include <iostream>
+#include <signal.h>
+
+// counters of one connection, on either end. they are plain longs bumped on
+// the hot path by the one thread that runs the connection, so they cost an
+// increment each; anything reading them from elsewhere gets a snapshot that
+// may be a segment behind. a sender fills in the sender's fields and a
+// receiver the receiver's, the rest stay 0.
+struct ProtocolStats {
+    ProtocolStats();
+    void reset();
+    void sent(const int lengths[], int count); // count datagrams went out
+    long retransmits();            // timeout + fast
+    std::ostream &json(std::ostream &out); // every field as a json object,
+                                   //     on one line without a newline
+
+    // ask every connection to dump its stats once per SIGUSR1 (kill -USR1).
+    static void dumpOnSignal();
+    bool dumpDue();                // has a signal come since this last asked
+
+    unsigned int connId;
+    // sender
+    long segmentsSent, bytesSent;  // every datagram, parity and resends too
+    long timeoutRetransmits;       // resent after an rto, whole window or
+                                   //     one segment's own timer
+    long fastRetransmits;          // resent on duplicate or partial acks
+    long timeouts;                 // rto events, each one backs off once
+    long acksReceived;
+    long dupAcks;
+    long windowStalls;             // times the window filled with data left
+    long windowLimitedUsec;        // ... and how long it stayed full
+    long windowProbes;             // base sent into a window the receiver
+                                   //     shut, to learn when it opens
+    // both: cumulatively acked at the sender, in order at the receiver
+    long segmentsDelivered, bytesDelivered;
+    // receiver
+    long segmentsReceived;         // data segments taken in, duplicates too
+    long outOfOrder;               // arrived past a hole
+    long spuriousRetransmits;      // arrived again after being received:
+                                   //     a resend that wasn't needed
+    long acksSent;
+    long windowUpdates;            // acks sent only because a reader freed
+                                   //     buffer room
+    // both
+    long corrupt;                  // datagrams dropped for a bad header or
+                                   //     checksum
+ private:
+    static void requested(int signo);
+    static volatile sig_atomic_t generation; // SIGUSR1s so far
+    sig_atomic_t seen;             // generation when last dumped
+};
+
+#endif
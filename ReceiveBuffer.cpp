@@ -0,0 +1,70 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "ReceiveBuffer.h"
+#include <stddef.h>
+
+ReceiveBuffer::ReceiveBuffer(int slots, int slotSize, unsigned int isn)
+    : size(slotSize), mask(slots - 1), readFrom(isn), readOffset(0),
+      readyEnd(isn) {
+    arena = new char[(long) slots * slotSize];
+    lengths = new int[slots];
+}
+
+ReceiveBuffer::~ReceiveBuffer() {
+    delete[] arena;
+    delete[] lengths;
+}
+
+char *ReceiveBuffer::slot(unsigned int seqNum) {
+    return arena + (long) (seqNum & mask) * size;
+}
+
+int ReceiveBuffer::slotSize() {
+    return size;
+}
+
+void ReceiveBuffer::filled(unsigned int seqNum, int length) {
+    lengths[seqNum & mask] = length < size ? length : size;
+}
+
+void ReceiveBuffer::ready(unsigned int end) {
+    readyEnd = end;
+}
+
+const char *ReceiveBuffer::peek(int &length) {
+    // empty payloads have nothing to read, pass over them.
+    while(readFrom != readyEnd && lengths[readFrom & mask] == 0)
+        readFrom++;
+    length = 0;
+    if(readFrom == readyEnd) return NULL;
+
+    // the span runs on through the next slot as long as the one before is
+    //     full and the arena doesn't wrap around in between.
+    unsigned int seq = readFrom;
+    length = lengths[seq & mask] - readOffset;
+    while(lengths[seq & mask] == size && ++seq != readyEnd
+            && (seq & mask) != 0)
+        length += lengths[seq & mask];
+    return slot(readFrom) + readOffset;
+}
+
+void ReceiveBuffer::release(int length) {
+    while(length > 0 && readFrom != readyEnd) {
+        int left = lengths[readFrom & mask] - readOffset;
+        if(length < left) {
+            readOffset += length;
+            return;
+        }
+        length -= left;
+        readFrom++;
+        readOffset = 0;
+    }
+}
+
+unsigned int ReceiveBuffer::readSeq() {
+    return readFrom;
+}
@@ -0,0 +1,47 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _RECEIVEBUFFER_H_
+#define _RECEIVEBUFFER_H_
+
+// the payloads of one transfer between their arrival and the application
+// reading them: an arena of one slot per seq # of a receive window, each
+// slotSize bytes, allocated once, with seq # s in slot s & (slots - 1).
+// payloads are received straight into their slots and read from there, so
+// consecutive full slots read as one span. a slot stays taken from arrival
+// until the reader releases it; a ReceiveWindow bounded by the buffer takes
+// nothing whose slot is still taken, and advertises the free ones as its
+// window, so the arena is all the memory a transfer ever holds.
+class ReceiveBuffer {
+ public:
+    ReceiveBuffer(int slots, int slotSize, unsigned int isn); // slots: a
+                                   //     power of two, the window's capacity()
+    ~ReceiveBuffer();
+    char *slot(unsigned int seqNum); // where seqNum's payload goes
+    int slotSize();
+    void filled(unsigned int seqNum, int length); // seqNum's slot holds a
+                                   //     payload of length bytes
+    void ready(unsigned int end);  // everything before seq # end is in order
+
+    // the application side: the longest run of in-order bytes not read
+    //     yet that is contiguous in memory, NULL if there are none. they
+    //     stay put until released, the next peek() starts past them.
+    const char *peek(int &length);
+    void release(int length);      // done with length bytes from the front
+    unsigned int readSeq();        // the oldest seq # not released yet
+ private:
+    ReceiveBuffer(const ReceiveBuffer &); // not copyable
+    ReceiveBuffer &operator=(const ReceiveBuffer &);
+    char *arena;                   // slots of size bytes each
+    int *lengths;                  // payload bytes in each slot
+    int size;
+    unsigned int mask;             // slots - 1
+    unsigned int readFrom;         // oldest seq # not released
+    int readOffset;                // bytes of it already released
+    unsigned int readyEnd;         // one past the newest in-order seq #
+};
+
+#endif
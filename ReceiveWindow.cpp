@@ -0,0 +1,133 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "ReceiveWindow.h"
+
+ReceiveWindow::ReceiveWindow(int windowSize, unsigned int isn, int max)
+    : packets(windowSize), held(0), expectedSeqNum(isn), end(isn + max),
+      ackEvery(1), ackDelay(0), unacked(0), unackedSince(0), ackCount(0),
+      connId(0), stats(&untracked), buffer(NULL), advertised(isn) {
+    lengths = new int[packets.capacity()];
+    clock.start();
+}
+
+ReceiveWindow::~ReceiveWindow() {
+    delete[] lengths;
+}
+
+void ReceiveWindow::track(ProtocolStats &stats) {
+    this->stats = &stats;
+}
+
+void ReceiveWindow::bufferInto(ReceiveBuffer &buffer) {
+    this->buffer = &buffer;
+}
+
+void ReceiveWindow::setConnId(unsigned int connId) {
+    this->connId = connId;
+}
+
+void ReceiveWindow::delayAcks(int every, long delay) {
+    ackEvery = every;
+    ackDelay = delay;
+}
+
+int ReceiveWindow::receive(unsigned int seqNum, int length, SackAck &ack) {
+    unsigned int before = expectedSeqNum;
+    stats->segmentsReceived++;
+
+    // keep it if it fits in the window past expectedSeqNum; anything
+    //     older is a duplicate, anything newer has no slot yet.
+    if(seqLt(seqNum, expectedSeqNum)
+            || (seqLt(seqNum, limit()) && packets.test(seqNum))) {
+        stats->spuriousRetransmits++;
+    } else if(seqLt(seqNum, limit())) {
+        packets.set(seqNum);
+        lengths[packets.slot(seqNum)] = length;
+        held++;
+        if(seqNum != expectedSeqNum) stats->outOfOrder++;
+    }
+    if(seqNum == expectedSeqNum) {
+        // fast forward expectedSeqNum to be the 
+        //     next unreceived (false) packet, freeing the slots.
+        while(seqLt(expectedSeqNum, end) && packets.test(expectedSeqNum)) {
+            stats->bytesDelivered += lengths[packets.slot(expectedSeqNum)];
+            packets.reset(expectedSeqNum++);
+            held--;
+        }
+        stats->segmentsDelivered += seqDiff(expectedSeqNum, before);
+        if(buffer != NULL) buffer->ready(expectedSeqNum);
+    }
+
+    // the next segment in a row with no holes around: the ack may wait.
+    if(ackEvery > 1 && seqNum == before && expectedSeqNum == before + 1
+            && held == 0 && !done()) {
+        if(unacked++ == 0)
+            unackedSince = clock.lap();
+        if(unacked < ackEvery)
+            return 0;
+    }
+    return ackNow(ack);
+}
+
+bool ReceiveWindow::wants(unsigned int seqNum) {
+    return seqGeq(seqNum, expectedSeqNum) && seqLt(seqNum, end)
+        && seqLt(seqNum, limit()) && !packets.test(seqNum);
+}
+
+int ReceiveWindow::windowUpdate(SackAck &ack) {
+    if(seqDiff(limit(), advertised) < packets.capacity() / 2)
+        return 0;
+    stats->windowUpdates++;
+    return ackNow(ack);
+}
+
+long ReceiveWindow::ackDue() {
+    if(unacked == 0)
+        return -1;
+    long left = unackedSince + ackDelay - clock.lap();
+    return left > 0 ? left : 0;
+}
+
+int ReceiveWindow::dueAck(SackAck &ack) {
+    if(unacked == 0 || ackDue() > 0)
+        return 0;
+    return ackNow(ack);
+}
+
+// ack a valid packet, along with anything received past it, and advertise
+//     how far past expectedSeqNum segments still have a slot.
+int ReceiveWindow::ackNow(SackAck &ack) {
+    unacked = 0;
+    ackCount++;
+    stats->acksSent++;
+    advertised = limit();
+    return buildSackAck(ack, expectedSeqNum, packets, end, connId,
+            seqDiff(advertised, expectedSeqNum));
+}
+
+// slots are taken from a segment's arrival until expectedSeqNum passes it,
+//     or with a buffer until its reader releases it.
+unsigned int ReceiveWindow::limit() {
+    return (buffer != NULL ? buffer->readSeq() : expectedSeqNum)
+        + packets.capacity();
+}
+
+bool ReceiveWindow::done() {
+    return !seqLt(expectedSeqNum, end);
+}
+
+unsigned int ReceiveWindow::expected() {
+    return expectedSeqNum;
+}
+
+long ReceiveWindow::acks() {
+    return ackCount;
+}
+
+int ReceiveWindow::capacity() {
+    return packets.capacity();
+}
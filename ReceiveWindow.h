@@ -0,0 +1,76 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _RECEIVEWINDOW_H_
+#define _RECEIVEWINDOW_H_
+
+#include "SeqRing.h"
+#include "Sack.h"
+#include "Timer.h"
+#include "ProtocolStats.h"
+#include "ReceiveBuffer.h"
+
+// receive side of one transfer of max segments starting at seq # isn: the
+// next in-order seq # and which segments past it already arrived. every
+// segment is acked unless delayAcks() says otherwise.
+class ReceiveWindow {
+ public:
+    ReceiveWindow(int windowSize, unsigned int isn, int max);
+    ~ReceiveWindow();
+    // ack in-order segments only every `every` of them, or delay usec
+    //     after the first one left unacked. anything out of order, filling
+    //     a gap or ending the transfer is still acked at once.
+    void delayAcks(int every, long delay);
+    // count the receiver's side of stats there. untracked, they are
+    //     counted where nobody looks.
+    void track(ProtocolStats &stats);
+    // keep delivered segments' slots taken until buffer's reader releases
+    //     them: take in only what has a free slot there, and advertise the
+    //     free slots as the window. buffer has capacity() slots.
+    void bufferInto(ReceiveBuffer &buffer);
+    // the connection id its acks carry, 0 until set.
+    void setConnId(unsigned int connId);
+    // take in seqNum, a segment of length bytes, and fill in the ack that
+    //     answers it. returns the number of bytes of ack that need to be
+    //     sent, 0 if it is delayed.
+    int receive(unsigned int seqNum, int length, SackAck &ack);
+    // would receive() keep seqNum: it fits in the window and hasn't
+    //     arrived yet.
+    bool wants(unsigned int seqNum);
+    // fill in an ack for the room a reader freed, if it opened the window
+    //     by half its capacity since the last ack. returns its length or 0.
+    int windowUpdate(SackAck &ack);
+    long ackDue();                 // usec until a delayed ack is due, or -1
+    int dueAck(SackAck &ack);      // fill in the delayed ack if it is due,
+                                   //     returns its length or 0
+    bool done();                   // has every segment arrived in order
+    unsigned int expected();       // next in-order seq # wanted
+    long acks();                   // # of acks handed out so far
+    int capacity();                // # of seq #s tracked at once, 2^n
+ private:
+    ReceiveWindow(const ReceiveWindow &); // not copyable
+    ReceiveWindow &operator=(const ReceiveWindow &);
+    int ackNow(SackAck &ack);
+    unsigned int limit();          // one past the last seq # it may take
+    SeqRing packets;               // received past expectedSeqNum
+    int held;                      // # of them
+    unsigned int expectedSeqNum;
+    unsigned int end;              // one past the last sequence #
+    int ackEvery;
+    long ackDelay;
+    int unacked;                   // in-order segments not acked yet
+    long unackedSince;             // when the first of them arrived
+    long ackCount;
+    unsigned int connId;
+    ProtocolStats untracked;
+    ProtocolStats *stats;
+    int *lengths;                  // bytes of each segment held, by slot
+    ReceiveBuffer *buffer;         // holds the payloads, NULL: nothing does
+    unsigned int advertised;       // limit() as of the last ack
+    Timer clock;
+};
+
+#endif
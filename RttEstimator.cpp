@@ -0,0 +1,61 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "RttEstimator.h"
+
+RttEstimator::RttEstimator(long minRto, long maxRto, long initialRto)
+        : minRto(minRto), maxRto(maxRto), scaledSrtt(0), scaledRttvar(0),
+          backoffCount(0) {
+    currentRto = clamp(initialRto);
+}
+
+long RttEstimator::rto() {
+    return currentRto;
+}
+
+long RttEstimator::srtt() {
+    return scaledSrtt >> 3;
+}
+
+long RttEstimator::rttvar() {
+    return scaledRttvar >> 2;
+}
+
+int RttEstimator::backoffs() {
+    return backoffCount;
+}
+
+void RttEstimator::sample(long rtt) {
+    if(rtt < 1) rtt = 1; // below the clock granularity.
+
+    if(scaledSrtt == 0) {
+        // first measurement: srtt = r, rttvar = r / 2.
+        scaledSrtt = rtt << 3;
+        scaledRttvar = rtt << 1;
+    } else {
+        // rttvar = 3/4 rttvar + 1/4 |srtt - r|, srtt = 7/8 srtt + 1/8 r,
+        //     kept scaled so the gains are shifts.
+        long delta = rtt - (scaledSrtt >> 3);
+        scaledSrtt += delta;
+        if(delta < 0) delta = -delta;
+        scaledRttvar += delta - (scaledRttvar >> 2);
+    }
+
+    // rto = srtt + 4 * rttvar, a fresh sample also undoes any backoff.
+    currentRto = clamp((scaledSrtt >> 3) + scaledRttvar);
+    backoffCount = 0;
+}
+
+void RttEstimator::backoff() {
+    currentRto = clamp(currentRto * 2);
+    backoffCount++;
+}
+
+long RttEstimator::clamp(long value) {
+    if(value < minRto) return minRto;
+    if(value > maxRto) return maxRto;
+    return value;
+}
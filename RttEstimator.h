@@ -0,0 +1,32 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _RTTESTIMATOR_H_
+#define _RTTESTIMATOR_H_
+
+// Jacobson/Karels retransmission timeout estimator (RFC 6298). all times are
+// in usec. callers apply Karn's rule themselves: a segment that has been
+// retransmitted must never be fed to sample(), since its ack is ambiguous.
+class RttEstimator {
+ public:
+    RttEstimator(long minRto, long maxRto, long initialRto);
+    long rto();                // current retransmission timeout
+    long srtt();               // smoothed rtt, 0 until the first sample
+    long rttvar();             // rtt variation, 0 until the first sample
+    int backoffs();            // timeouts since the last valid sample
+    void sample(long rtt);     // feed a measured rtt, resets the backoff
+    void backoff();            // double the rto after a timeout
+ private:
+    long clamp(long value);    // bound value to [minRto, maxRto]
+    long minRto;               // lower bound on the rto
+    long maxRto;               // upper bound on the rto
+    long scaledSrtt;           // srtt << 3, 0 means no sample yet
+    long scaledRttvar;         // rttvar << 2
+    long currentRto;           // rto including any backoff
+    int backoffCount;          // number of doublings since the last sample
+};
+
+#endif
@@ -0,0 +1,53 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "Sack.h"
+#include <string.h>
+#include <arpa/inet.h>
+
+int buildSackAck(SackAck &ack, unsigned int ackNum, SeqRing &received,
+        unsigned int end, unsigned int connId, int window) {
+    memset(ack.bitmap, 0, sizeof(ack.bitmap));
+
+    // only send the words up to the last one holding a received segment.
+    // the ring only holds one window past ackNum, so look no further.
+    int words = 0;
+    for(int i = 0; i < SACK_BITS && i + 1 < received.capacity(); i++) {
+        unsigned int seqNum = ackNum + 1 + i;
+        if(seqGeq(seqNum, end)) break;
+        if(received.test(seqNum)) {
+            ack.bitmap[i / 32] |= 1u << (i % 32);
+            words = i / 32 + 1;
+        }
+    }
+    for(int w = 0; w < words; w++)
+        ack.bitmap[w] = htonl(ack.bitmap[w]);
+    int length = WIRE_HDR + words * sizeof(ack.bitmap[0]);
+    wireWrite(ack.header, length, WireHeader(words > 0
+            ? WIRE_ACK | WIRE_SACK : WIRE_ACK, 0, ackNum, window, connId));
+    return length;
+}
+
+int applySackAck(const SackAck &ack, int length, const WireHeader &header,
+        SeqRing &sacked, unsigned int sendMax) {
+    if(!(header.flags & WIRE_SACK))
+        return 0;
+    int words = (length - WIRE_HDR) / (int) sizeof(ack.bitmap[0]);
+    if(words > SACK_WORDS) words = SACK_WORDS;
+
+    int marked = 0;
+    for(int w = 0; w < words; w++) {
+        unsigned int bits = ntohl(ack.bitmap[w]);
+        for(int b = 0; bits != 0; b++, bits >>= 1) {
+            unsigned int seqNum = header.ack + 1 + w * 32 + b;
+            if((bits & 1) && seqLt(seqNum, sendMax) && !sacked.test(seqNum)) {
+                sacked.set(seqNum);
+                marked++;
+            }
+        }
+    }
+    return marked;
+}
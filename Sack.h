@@ -0,0 +1,37 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _SACK_H_
+#define _SACK_H_
+
+#include "SeqRing.h"
+#include "Wire.h"
+
+#define SACK_BITS 256                  // segments covered past the cumulative ack
+#define SACK_WORDS (SACK_BITS / 32)    // 32-bit words in the sack bitmap
+
+// ack message sent by the server, as it goes on the wire. a plain
+// cumulative ack is just the header, whose ack is the next expected (first
+// missing) seq #; the bitmap is only appended when segments past it arrived.
+struct SackAck {
+    char header[WIRE_HDR];
+    unsigned int bitmap[SACK_WORDS];   // network order. bit i set: seq #
+                                       //     ack + 1 + i received
+};
+
+// fill in and seal ack for ackNum from the received flags of a transfer
+// ending before seq # end, for connection connId taking segments up to
+// ackNum + window. returns the number of bytes of ack that need to be sent.
+int buildSackAck(SackAck &ack, unsigned int ackNum, SeqRing &received,
+        unsigned int end, unsigned int connId, int window);
+
+// mark every segment before sendMax that an ack of length bytes, whose
+// header wireRead() gave as header, selectively acks in sacked. returns the
+// number of segments newly marked.
+int applySackAck(const SackAck &ack, int length, const WireHeader &header,
+        SeqRing &sacked, unsigned int sendMax);
+
+#endif
@@ -0,0 +1,62 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "SeqRing.h"
+#include <string.h>
+
+SeqRing::SeqRing(int window) {
+    unsigned int capacity = 32; // at least one word
+    while(capacity < (unsigned int) window) capacity <<= 1;
+    mask = capacity - 1;
+    words = new unsigned int[capacity / 32];
+    memset(words, 0, capacity / 8);
+}
+
+SeqRing::~SeqRing() {
+    delete[] words;
+}
+
+int SeqRing::capacity() {
+    return mask + 1;
+}
+
+int SeqRing::slot(unsigned int seq) {
+    return seq & mask;
+}
+
+bool SeqRing::test(unsigned int seq) {
+    unsigned int i = seq & mask;
+    return (words[i / 32] >> (i % 32)) & 1;
+}
+
+void SeqRing::set(unsigned int seq) {
+    unsigned int i = seq & mask;
+    words[i / 32] |= 1u << (i % 32);
+}
+
+void SeqRing::reset(unsigned int seq) {
+    unsigned int i = seq & mask;
+    words[i / 32] &= ~(1u << (i % 32));
+}
+
+void SeqRing::resetRange(unsigned int from, unsigned int to) {
+    if(seqLeq(to, from)) return;
+    // a whole lap or more clears everything.
+    if(seqDiff(to, from) > (int) mask) {
+        memset(words, 0, (mask + 1) / 8);
+        return;
+    }
+    for(unsigned int seq = from; seq != to; seq++) {
+        // whole words at a time once aligned.
+        unsigned int i = seq & mask;
+        if(i % 32 == 0 && seqDiff(to, seq) >= 32) {
+            words[i / 32] = 0;
+            seq += 31;
+        } else {
+            reset(seq);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _SEQRING_H_
+#define _SEQRING_H_
+
+// serial number arithmetic (RFC 1982) on 32-bit sequence numbers, so a
+// stream can wrap past 2^32 segments. a is "before" b if it is less than
+// 2^31 behind it.
+inline int seqDiff(unsigned int a, unsigned int b) { return (int) (a - b); }
+inline bool seqLt(unsigned int a, unsigned int b) { return seqDiff(a, b) < 0; }
+inline bool seqLeq(unsigned int a, unsigned int b) { return seqDiff(a, b) <= 0; }
+inline bool seqGt(unsigned int a, unsigned int b) { return seqDiff(a, b) > 0; }
+inline bool seqGeq(unsigned int a, unsigned int b) { return seqDiff(a, b) >= 0; }
+
+// per-segment flags for one window, indexed by sequence number. the ring is
+// a power of two long, so seq # s lives in slot s & (capacity - 1), and it
+// holds any capacity consecutive sequence numbers. memory depends on the
+// window only, never on how long the transfer is.
+class SeqRing {
+ public:
+    SeqRing(int window);           // capacity: window rounded up to 2^n
+    ~SeqRing();
+    int capacity();                // # of sequence numbers it can hold
+    int slot(unsigned int seq);    // index for arrays kept alongside
+    bool test(unsigned int seq);   // is the flag for seq set
+    void set(unsigned int seq);
+    void reset(unsigned int seq);
+    void resetRange(unsigned int from, unsigned int to); // [from, to)
+ private:
+    SeqRing(const SeqRing &);      // not copyable
+    SeqRing &operator=(const SeqRing &);
+    unsigned int *words;           // one bit per slot
+    unsigned int mask;             // capacity - 1
+};
+
+#endif
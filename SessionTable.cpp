@@ -0,0 +1,193 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "SessionTable.h"
+
+#define INIT_BUCKETS 64
+
+Session::Session(const struct sockaddr &peer, unsigned int connId,
+        int windowSize, unsigned int isn, int max)
+    : peer(peer), connId(connId), window(windowSize, isn, max), segments(0),
+      lastSeen(0), finished(false), next(NULL), newer(NULL), older(NULL) {
+    window.setConnId(connId);
+}
+
+// only the ipv4 address and port identify a peer, the rest is padding.
+static bool samePeer(const struct sockaddr &a, const struct sockaddr &b) {
+    const struct sockaddr_in &x = (const struct sockaddr_in &) a;
+    const struct sockaddr_in &y = (const struct sockaddr_in &) b;
+    return x.sin_addr.s_addr == y.sin_addr.s_addr && x.sin_port == y.sin_port;
+}
+
+SessionTable::SessionTable(int windowSize, unsigned int isn, int max,
+        int capacity, long idleUsec, long lingerUsec)
+    : buckets(new Session*[INIT_BUCKETS]()), mask(INIT_BUCKETS - 1), count(0),
+      seen(0), retired(0), windowSize(windowSize), isn(isn), max(max),
+      capacity(capacity > 0 ? capacity : 1), idleUsec(idleUsec),
+      lingerUsec(lingerUsec) {
+    active.newest = active.oldest = NULL;
+    done.newest = done.oldest = NULL;
+    clock.start();
+}
+
+SessionTable::~SessionTable() {
+    for(unsigned int b = 0; b <= mask; b++) {
+        while(buckets[b] != NULL) {
+            Session *s = buckets[b];
+            buckets[b] = s->next;
+            delete s;
+        }
+    }
+    delete[] buckets;
+}
+
+unsigned int SessionTable::bucketOf(const struct sockaddr &peer,
+        unsigned int connId) {
+    const struct sockaddr_in &in = (const struct sockaddr_in &) peer;
+    // fibonacci hashing; the high bits are the best mixed.
+    unsigned int h = in.sin_addr.s_addr * 2654435761u;
+    h = (h ^ in.sin_port) * 2654435761u;
+    h = (h ^ connId) * 2654435761u;
+    return (h >> 16) & mask;
+}
+
+Session *SessionTable::find(const struct sockaddr &peer, unsigned int connId) {
+    long now = clock.lap();
+    unsigned int b = bucketOf(peer, connId);
+    for(Session *s = buckets[b]; s != NULL; s = s->next) {
+        if(s->connId == connId && samePeer(s->peer, peer)) {
+            List &list = s->finished ? done : active;
+            unlink(list, s);
+            s->lastSeen = now;
+            push(list, s);
+            return s;
+        }
+    }
+
+    // first segment of a new transfer. a full table gives up the finished
+    //     session heard from longest ago, but never one under way: the new
+    //     one waits until one finishes or goes quiet for idleUsec.
+    if(count >= capacity)
+        expire();
+    if(count >= capacity) {
+        if(done.oldest == NULL)
+            return NULL;
+        remove(done, done.oldest);
+    }
+    // keep chains about one long.
+    if(count > (int) mask)
+        grow();
+    b = bucketOf(peer, connId);
+    Session *s = new Session(peer, connId, windowSize, isn, max);
+    s->next = buckets[b];
+    buckets[b] = s;
+    s->lastSeen = now;
+    push(active, s);
+    count++;
+    seen++;
+    return s;
+}
+
+void SessionTable::finish(Session *s) {
+    if(s->finished)
+        return;
+    unlink(active, s);
+    s->finished = true;
+    push(done, s);
+}
+
+int SessionTable::expire() {
+    long now = clock.lap();
+    int expired = 0;
+    for(; done.oldest != NULL && now - done.oldest->lastSeen >= lingerUsec;
+            expired++)
+        remove(done, done.oldest);
+    for(; active.oldest != NULL && now - active.oldest->lastSeen >= idleUsec;
+            expired++)
+        remove(active, active.oldest);
+    return expired;
+}
+
+int SessionTable::size() {
+    return seen;
+}
+
+int SessionTable::live() {
+    return count;
+}
+
+long SessionTable::segments() {
+    long segments = retired;
+    for(Session *s = first(); s != NULL; s = next(s))
+        segments += s->segments;
+    return segments;
+}
+
+Session *SessionTable::first() {
+    for(unsigned int b = 0; b <= mask; b++)
+        if(buckets[b] != NULL)
+            return buckets[b];
+    return NULL;
+}
+
+Session *SessionTable::next(Session *s) {
+    if(s->next != NULL)
+        return s->next;
+    for(unsigned int b = bucketOf(s->peer, s->connId) + 1; b <= mask; b++)
+        if(buckets[b] != NULL)
+            return buckets[b];
+    return NULL;
+}
+
+void SessionTable::grow() {
+    Session **old = buckets;
+    unsigned int oldMask = mask;
+    mask = mask * 2 + 1;
+    buckets = new Session*[mask + 1]();
+    for(unsigned int b = 0; b <= oldMask; b++) {
+        while(old[b] != NULL) {
+            Session *s = old[b];
+            old[b] = s->next;
+            unsigned int nb = bucketOf(s->peer, s->connId);
+            s->next = buckets[nb];
+            buckets[nb] = s;
+        }
+    }
+    delete[] old;
+}
+
+void SessionTable::push(List &list, Session *s) {
+    s->newer = NULL;
+    s->older = list.newest;
+    if(list.newest != NULL)
+        list.newest->newer = s;
+    else
+        list.oldest = s;
+    list.newest = s;
+}
+
+void SessionTable::unlink(List &list, Session *s) {
+    if(s->newer != NULL)
+        s->newer->older = s->older;
+    else
+        list.newest = s->older;
+    if(s->older != NULL)
+        s->older->newer = s->newer;
+    else
+        list.oldest = s->newer;
+    s->newer = s->older = NULL;
+}
+
+void SessionTable::remove(List &list, Session *s) {
+    unlink(list, s);
+    Session **link = &buckets[bucketOf(s->peer, s->connId)];
+    while(*link != s)
+        link = &(*link)->next;
+    *link = s->next;
+    retired += s->segments;
+    count--;
+    delete s;
+}
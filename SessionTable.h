@@ -0,0 +1,79 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _SESSIONTABLE_H_
+#define _SESSIONTABLE_H_
+
+#include "UdpSocket.h"
+#include "Timer.h"
+#include "ReceiveWindow.h"
+
+// one client transfer at a multi-session server, known by the address it
+// sends from and the connection id in its segments' wire header.
+struct Session {
+    Session(const struct sockaddr &peer, unsigned int connId, int windowSize,
+            unsigned int isn, int max);
+
+    struct sockaddr peer;          // where its acks go
+    unsigned int connId;
+    ReceiveWindow window;          // its own receive state
+    long segments;                 // datagrams taken in, duplicates included
+    long lastSeen;                 // usec of its last segment
+    bool finished;                 // in the done list, not the active one
+    Session *next;                 // next in the same hash bucket
+    Session *newer, *older;        // neighbours in its list, by lastSeen
+};
+
+// hash table of sessions keyed by (peer address, port, connection id).
+// every new session starts a transfer of max segments at seq # isn.
+// nothing stays forever: a finished session goes after lingerUsec without
+// a segment, one under way after idleUsec, and past capacity sessions the
+// least recently heard finished one makes room for a new one.
+class SessionTable {
+ public:
+    SessionTable(int windowSize, unsigned int isn, int max, int capacity,
+            long idleUsec, long lingerUsec);
+    ~SessionTable();
+    // the session for peer and connId, created on its first segment; NULL
+    //     if it's new and capacity sessions are all still under way.
+    Session *find(const struct sockaddr &peer, unsigned int connId);
+    void finish(Session *s);       // s just received its whole transfer
+    int expire();                  // drop who stayed quiet too long,
+                                   //     returns how many
+    int size();                    // # of sessions seen so far
+    int live();                    // # of them still kept
+    long segments();               // datagrams taken in by all of them
+    Session *first();              // walk the kept sessions: first(), then
+    Session *next(Session *s);     //     next() until NULL
+ private:
+    // sessions from the most to the least recently heard.
+    struct List {
+        Session *newest, *oldest;
+    };
+    SessionTable(const SessionTable &); // not copyable
+    SessionTable &operator=(const SessionTable &);
+    unsigned int bucketOf(const struct sockaddr &peer, unsigned int connId);
+    void grow();                   // double the buckets and rehash
+    void push(List &list, Session *s); // make s list's newest
+    void unlink(List &list, Session *s);
+    void remove(List &list, Session *s); // forget s for good
+    Session **buckets;
+    unsigned int mask;             // # of buckets - 1, a power of two
+    int count;                     // sessions kept
+    int seen;                      // sessions ever created
+    long retired;                  // segments of the ones dropped
+    List active;                   // transfers under way
+    List done;                     // finished, acking stragglers
+    Timer clock;                   // lastSeen is read off it
+    int windowSize;                // settings for new sessions
+    unsigned int isn;
+    int max;
+    int capacity;
+    long idleUsec;
+    long lingerUsec;
+};
+
+#endif
@@ -0,0 +1,211 @@
+// Project:      CSS432 UDP Socket Class
+// Professor:    Munehiro Fukuda
+// Organization: CSS, University of Washington, Bothell
+// Date:         March 5, 2004
+
+// the endpoints switch stacks with _longjmp( ), which a fortified libc
+// takes for stack smashing
+#undef _FORTIFY_SOURCE
+
+#include "SimNetwork.h"
+#include "Timer.h"
+
+SimNetwork* SimNetwork::running = NULL;
+
+// Constructor ----------------------------------------------------------------
+SimNetwork::SimNetwork( ) : nPorts( 0 ), nEndpoints( 0 ), current( -1 ),
+			    progress( 0 ), clock( 0 ) {
+}
+
+// Destructor -----------------------------------------------------------------
+SimNetwork::~SimNetwork( ) {
+  for ( int i = 0; i < nPorts; i++ ) {
+    Port& p = ports[i];
+    for ( int j = 0; j < p.count; j++ )
+      pool.give( p.queue[( p.head + j ) % SIMQUEUE].data,
+		 p.queue[( p.head + j ) % SIMQUEUE].length );
+    delete[] p.queue;
+  }
+  for ( int i = 0; i < nEndpoints; i++ )
+    delete[] endpoints[i].stack;
+}
+
+// Virtual usec since construction --------------------------------------------
+long SimNetwork::now( ) {
+  return clock;
+}
+
+// Add an endpoint that runs function( arg ) ----------------------------------
+void SimNetwork::spawn( void ( *function )( void* ), void* arg ) {
+  if ( nEndpoints == SIMPORTS ) {
+    cerr << "Too many simulated endpoints." << endl;
+    return;
+  }
+  Endpoint& endpoint = endpoints[nEndpoints++];
+  endpoint.stack = new char[SIMSTACK];
+  endpoint.function = function;
+  endpoint.arg = arg;
+  endpoint.state = RUNNABLE;
+  endpoint.port = -1;
+  endpoint.deadline = -1;
+  endpoint.yielded = false;
+  endpoint.epoch = 0;
+  endpoint.started = false;
+  getcontext( &endpoint.context );
+  endpoint.context.uc_stack.ss_sp = endpoint.stack;
+  endpoint.context.uc_stack.ss_size = SIMSTACK;
+  endpoint.context.uc_link = NULL; // start( ) never returns
+  makecontext( &endpoint.context, start, 0 );
+}
+
+// Run an endpoint's function, on its own stack -------------------------------
+void SimNetwork::start( ) {
+  SimNetwork* net = running;
+  Endpoint& endpoint = net->endpoints[net->current];
+  endpoint.function( endpoint.arg );
+  endpoint.state = DONE;
+  _longjmp( net->scheduler, 1 );   // its stack is left for good
+}
+
+// Run every endpoint until all of them return --------------------------------
+bool SimNetwork::run( ) {
+  running = this;
+  Timer::simulate( &clock );
+
+  // run whoever can, in order, and only move the clock when nobody can. a
+  // yielder gets on again at the same time once anybody else got anywhere,
+  // and a tick later if nobody did, so spinning endpoints move the clock
+  int alive = nEndpoints;
+  bool stuck = false;
+  while ( alive > 0 && !stuck ) {
+    bool ran = false;
+    for ( current = 0; current < nEndpoints; current++ ) {
+      Endpoint& endpoint = endpoints[current];
+      bool turn = false;         // woken only because the others went on
+      if ( endpoint.state == WAITING ) {
+	if ( ( endpoint.port >= 0 && pending( endpoint.port ) )
+	     || ( endpoint.deadline >= 0 && endpoint.deadline <= clock ) )
+	  endpoint.state = RUNNABLE;
+	else if ( endpoint.yielded && endpoint.epoch != progress ) {
+	  endpoint.state = RUNNABLE;
+	  turn = true;
+	}
+      }
+      if ( endpoint.state != RUNNABLE )
+	continue;
+      if ( !turn )
+	progress++;
+
+      // the first turn starts it on its stack, the others go on where it
+      // waited. swapcontext( ) would do both, but saves and restores the
+      // signal mask with a system call every time
+      if ( _setjmp( scheduler ) == 0 ) {
+	if ( !endpoint.started ) {
+	  endpoint.started = true;
+	  setcontext( &endpoint.context );
+	}
+	_longjmp( endpoint.jump, 1 );
+      }
+      ran = true;
+      if ( endpoint.state == DONE )
+	alive--;
+    }
+    current = -1;
+    if ( ran )
+      continue;
+
+    long next = -1;
+    for ( int i = 0; i < nEndpoints; i++ )
+      if ( endpoints[i].state == WAITING && endpoints[i].deadline >= 0
+	   && ( next < 0 || endpoints[i].deadline < next ) )
+	next = endpoints[i].deadline;
+    if ( next < 0 )
+      stuck = true;              // everyone waits for data nobody sends
+    else
+      clock = next;
+  }
+
+  Timer::simulate( NULL );
+  running = NULL;
+  if ( stuck )
+    cerr << "Simulated endpoints deadlocked at " << clock << " usec." << endl;
+  return !stuck;
+}
+
+// Find the port a socket is bound to -----------------------------------------
+SimNetwork::Port* SimNetwork::find( int port ) {
+  for ( int i = 0; i < nPorts; i++ )
+    if ( ports[i].port == port )
+      return &ports[i];
+  return NULL;
+}
+
+// Bind a socket to port ------------------------------------------------------
+void SimNetwork::attach( int port ) {
+  if ( find( port ) != NULL )
+    return;
+  if ( nPorts == SIMPORTS ) {
+    cerr << "Too many simulated ports." << endl;
+    return;
+  }
+  Port& p = ports[nPorts++];
+  p.port = port;
+  p.queue = new Datagram[SIMQUEUE];
+  p.head = p.count = 0;
+}
+
+// Deliver a datagram to port to, at once -------------------------------------
+void SimNetwork::send( int from, int to, const char msg[], int length ) {
+
+  // nobody bound there, or a full queue, drops it like a socket would
+  Port* p = find( to );
+  if ( p == NULL || p->count == SIMQUEUE )
+    return;
+  Datagram& d = p->queue[( p->head + p->count++ ) % SIMQUEUE];
+  d.from = from;
+  d.length = ( length < MAXMSGSIZE ) ? length : MAXMSGSIZE;
+  d.data = pool.take( d.length );
+  memcpy( d.data, msg, d.length );
+}
+
+// Take the first datagram waiting at port ------------------------------------
+int SimNetwork::recv( int port, char msg[], int length, int& from ) {
+  Port* p = find( port );
+  if ( p == NULL || p->count == 0 )
+    return -1;
+  Datagram& d = p->queue[p->head];
+  p->head = ( p->head + 1 ) % SIMQUEUE;
+  p->count--;
+  from = d.from;
+  if ( length > d.length )
+    length = d.length;
+  memcpy( msg, d.data, length );
+  pool.give( d.data, d.length );
+  return length;
+}
+
+// Check if port has data -----------------------------------------------------
+bool SimNetwork::pending( int port ) {
+  Port* p = find( port );
+  return p != NULL && p->count > 0;
+}
+
+// Give the other endpoints a turn until port has data or usec pass -----------
+int SimNetwork::wait( int port, long usec ) {
+  if ( pending( port ) )
+    return 1;
+  if ( current < 0 )             // nothing else could send in between
+    return 0;
+  Endpoint& endpoint = endpoints[current];
+  endpoint.state = WAITING;
+  endpoint.port = port;
+  endpoint.deadline = ( usec > 0 ) ? clock + usec : ( usec == 0 ) ? clock + 1
+    : -1;
+  endpoint.yielded = ( usec == 0 );
+  endpoint.epoch = progress;
+  if ( _setjmp( endpoint.jump ) == 0 )
+    _longjmp( scheduler, 1 );
+  endpoint.port = -1;
+  endpoint.yielded = false;
+  return pending( port ) ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// Project:      CSS432 UDP Socket Class
+// Professor:    Munehiro Fukuda
+// Organization: CSS, University of Washington, Bothell
+// Date:         March 5, 2004
+
+#ifndef _SIMNETWORK_H_
+#define _SIMNETWORK_H_
+
+#include "UdpSocket.h"
+#include "DatagramPool.h"
+
+extern "C"
+{
+#include <ucontext.h>     // for the endpoints' coroutines
+#include <setjmp.h>       // for switching between them
+}
+
+#define SIMPORTS 8        // max # ports, and of endpoints
+#define SIMQUEUE 2048     // max # datagrams waiting at one port
+#define SIMSTACK ( 1 << 20 ) // stack bytes of each endpoint
+
+// An in-memory network of UdpSockets on a virtual clock, for running the
+// client and the server of a test in one process as a discrete-event
+// simulation. Each endpoint is a coroutine; only one runs at a time, and
+// the clock only moves when all of them wait, straight to the earliest
+// time one of them waits for. Computing takes no time, only waits do, so
+// a transfer takes as long in virtual time as its waits add up to and as
+// little in real time as its code needs. A poll that finds nothing lets
+// the others run first, and a spin that keeps finding nothing moves the
+// clock a usec a round, so it ends like it would. The network delivers
+// everything at once; an Impairment on each socket adds the delay, loss
+// and bandwidth of a link. Nothing depends on the system clock or on
+// thread scheduling, so a run replays exactly.
+class SimNetwork {
+ public:
+  SimNetwork( );
+  ~SimNetwork( );
+  void spawn( void (*)( void* ), void* ); // add an endpoint running
+                                 // function( void* ) once run( ) starts
+  bool run( );                   // run the endpoints to completion with
+                                 // Timer on the virtual clock; false: they
+                                 // all wait on each other forever
+  long now( );                   // virtual usec since construction
+
+  // used by UdpSocket
+  void attach( int );            // a socket is bound to port int
+  void send( int, int, const char[], int ); // from port int to port int
+  int recv( int, char[], int, int& ); // take the first datagram at port
+                                 // int into char[] of int size and its
+                                 // source port; return its size or -1
+  bool pending( int );           // has port int anything to receive
+  int wait( int, long );         // wait up to long usec (<0: forever) for
+                                 // port int to have data; 1 if so, else 0.
+                                 // 0 usec still gives the others a turn
+ private:
+  struct Datagram {
+    int from;                    // source port
+    int length;
+    char* data;                  // length bytes, from pool
+  };
+  struct Port {
+    int port;
+    Datagram* queue;             // ring of SIMQUEUE
+    int head, count;
+  };
+  enum State { RUNNABLE, WAITING, DONE };
+  struct Endpoint {
+    ucontext_t context;          // where it starts, on its own stack
+    jmp_buf jump;                // where it goes on once started
+    bool started;
+    char* stack;
+    void (*function)( void* );
+    void* arg;
+    State state;
+    int port;                    // what it waits on, -1: nothing
+    long deadline;               // when it stops waiting, -1: never
+    bool yielded;                // waits 0 usec, only for the others ...
+    long epoch;                  // ... to get on past this much progress
+  };
+  SimNetwork( const SimNetwork& );            // not copyable
+  SimNetwork& operator=( const SimNetwork& );
+  Port* find( int );
+  static void start( );          // an endpoint's entry point
+  static SimNetwork* running;    // the network whose endpoint runs
+  Port ports[SIMPORTS];
+  DatagramPool pool;             // what the queued datagrams are held in
+  int nPorts;
+  Endpoint endpoints[SIMPORTS];
+  int nEndpoints;
+  int current;                   // the running endpoint, -1: none
+  long progress;                 // # turns not just given to a yielder
+  jmp_buf scheduler;             // where run( ) goes on
+  long clock;
+};
+
+#endif
@@ -0,0 +1,88 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _SLIDINGWINDOW_H_
+#define _SLIDINGWINDOW_H_
+
+#include "Pacer.h"
+#include "Fec.h"
+#include "LatencyHistogram.h"
+#include "ProtocolStats.h"
+
+// switches for the sliding window client. the defaults are plain go-back-n:
+// resend everything from the base, and only after a timeout. spinUsec also
+// applies to the stop & wait client.
+struct SenderOptions {
+    SenderOptions() : sackOn(false), fastRetransmitOn(false),
+        perSegmentTimersOn(false), spinUsec(0), isn(0), connId(0),
+        segSize(MSGSIZE), source(NULL), sourceLength(0), pacer(NULL),
+        fec(NULL), rtts(NULL), stats(NULL) {}
+
+    bool sackOn;             // skip selectively acked segments when resending
+    bool fastRetransmitOn;   // resend the base on the third duplicate ack and
+                             //     stay in fast recovery until it is all acked
+    bool perSegmentTimersOn; // time every segment on its own and resend only
+                             //     the expired ones, not the whole window
+    long spinUsec;           // busy poll this long in a wait before sleeping
+                             //     in the kernel, -1 busy polls until timeout
+    unsigned int isn;        // first sequence #, the server must use the same
+    unsigned int connId;     // in every segment header, so a server taking
+                             //     many transfers at once can tell them apart
+    int segSize;             // bytes per segment, header included, up to
+                             //     MAXMSGSIZE (FEC_MAXSEGSIZE with fec; the
+                             //     encoder's own). stop & wait uses MSGSIZE
+    const char *source;      // send these sourceLength bytes instead of the
+    long sourceLength;       //     message, segSize - WIRE_HDR of them per
+                             //     segment straight from here (a mapped file,
+                             //     say). max must be segmentsFor() them; the
+                             //     last segment is zero padded to segSize
+    Pacer *pacer;            // spread sends out with this token bucket, NULL
+                             //     sends whatever the window allows at once
+    FecEncoder *fec;         // follow each group of segments with parity the
+                             //     server rebuilds losses from, NULL: none
+    LatencyHistogram *rtts;  // record the rtt in nsec of every ack that rtt
+                             //     samples too (karn), NULL: don't
+    ProtocolStats *stats;    // count the sender's side there, NULL: don't
+};
+
+// switches for the early retransmit server. the defaults ack every segment.
+struct ReceiverOptions {
+    ReceiverOptions() : isn(0), connId(0), segSize(MSGSIZE), sink(NULL),
+        sinkLength(0), reader(NULL), readerArg(NULL), ackEvery(1),
+        ackDelay(0), fecOn(false), lingerUsec(0), dropSeed(0), stats(NULL) {}
+
+    unsigned int isn;        // first sequence #, the client must use the same
+    unsigned int connId;     // take in only segments of this connection, 0:
+                             //     of the one the first segment is from
+    int segSize;             // largest segment taken in, anything longer is
+                             //     cut short and fails its checksum. with
+                             //     fec, exactly the client's segSize
+    char *sink;              // put the payloads of a client's source here,
+    long sinkLength;         //     each at its place by seq #, received in
+                             //     place where the next one is guessed right.
+                             //     sinkLength is the source's, NULL: drop them
+    long (*reader)(const char *, long, void *); // hand the payloads over in
+    void *readerArg;         //     order, a contiguous span at a time, to
+                             //     reader(span, length, readerArg), which
+                             //     returns how much of it it's done with.
+                             //     they're received into a ReceiveBuffer of
+                             //     one window and wait there until read, so
+                             //     a slow reader shuts the window. whatever
+                             //     it leaves at the end is dropped. NULL:
+                             //     nothing reads them
+    int ackEvery;            // ack every ackEvery in-order segments ...
+    long ackDelay;           // ... or this many usec after the first unacked
+                             //     one. out of order segments are acked at once
+    bool fecOn;              // rebuild lost segments from the client's parity
+    long lingerUsec;         // after the last segment, keep acking resends
+                             //     until none came for this long, 0: don't
+    unsigned long dropSeed;  // which segments a drop percent loses; the same
+                             //     seed loses the same ones, so vary it to
+                             //     repeat a run with other losses
+    ProtocolStats *stats;    // count the receiver's side there, NULL: don't
+};
+
+#endif
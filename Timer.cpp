@@ -5,43 +5,59 @@
 
 #include "Timer.h"
 
+const long* Timer::virtualUsec = NULL;
+
 // Constructor ----------------------------------------------------------------
 Timer::Timer( ) {
-  startTime.tv_sec = 0;
-  startTime.tv_usec = 0;
-  endTime.tv_sec = 0;
-  endTime.tv_usec = 0;
+  startTime = 0;
+  endTime = 0;
+}
+
+// Run every timer off a simulated clock --------------------------------------
+void Timer::simulate( const long* usec ) {
+  virtualUsec = usec;
+}
+
+// Get the current time from the system or the simulated clock ----------------
+long Timer::now( ) {
+  if ( virtualUsec != NULL )
+    return *virtualUsec * 1000;
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec * 1000000000L + ts.tv_nsec;
 }
 
 // Memorize the current time in startTime -------------------------------------
 void Timer::start( ) {
-  gettimeofday( &startTime, NULL );
+  startTime = now( );
 }
 
 // Get the diff between the start and the curren time -------------------------
 long Timer::lap( ) {
-  gettimeofday( &endTime, NULL );
-  long interval =
-    ( endTime.tv_sec - startTime.tv_sec ) * 1000000 +
-    ( endTime.tv_usec - startTime.tv_usec );
-  return interval;
+  return lapNsec( ) / 1000;
+}
+
+// Get the same in nsec -------------------------------------------------------
+long Timer::lapNsec( ) {
+  endTime = now( );
+  return endTime - startTime;
 }
 
 // Get the diff between the old and the current time --------------------------
 long Timer::lap( long oldTv_sec, long oldTv_usec ) {
-  gettimeofday( &endTime, NULL );
+  endTime = now( );
   long interval =
-    ( endTime.tv_sec - oldTv_sec ) * 1000000 +
-    ( endTime.tv_usec - oldTv_usec );
+    ( endTime / 1000000000L - oldTv_sec ) * 1000000 +
+    ( endTime % 1000000000L / 1000 - oldTv_usec );
   return interval;
 }
 
 // Get sec --------------------------------------------------------------------
 long Timer::getSec( ) {
-  return startTime.tv_sec;
+  return startTime / 1000000000L;
 }
 
 // Get usec -------------------------------------------------------------------
 long Timer::getUsec( ) {
-  return startTime.tv_usec;
+  return startTime % 1000000000L / 1000;
 }
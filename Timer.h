@@ -12,20 +12,29 @@ using namespace std;
 
 extern "C"
 {
-#include <sys/time.h>
+#include <time.h>
 }
 
+// Reads CLOCK_MONOTONIC, which a change to the wall clock (an NTP step,
+// date -s) never moves, in nanoseconds. On Linux the read goes through the
+// vDSO and takes the TSC without a system call, so spinning on lap( ) is
+// cheap.
 class Timer {
  public:
   Timer( );                  // Constructor
   void start( );             // Memorize the curren time in startTime
-  long lap( );               // endTime - startTime
+  long lap( );               // endTime - startTime in usec
+  long lapNsec( );           // endTime - startTime in nsec
   long lap( long oldTv_sec, long oldTv_usec ); // endTime - oldTime
-  long getSec( );            // get startTime.tv_sec
-  long getUsec( );           // get startTime.tv_usec
+  long getSec( );            // get startTime's sec
+  long getUsec( );           // get startTime's usec within its sec
+  static void simulate( const long* ); // read the time in usec from long
+                             // instead of the system clock; NULL: go back
  private:
-  struct timeval startTime;  // Memorize the time to have started an evaluation
-  struct timeval endTime;    // Memorize the time to have stopped an evaluation
+  static const long* virtualUsec; // the simulated clock, NULL if none
+  static long now( );        // the current time in nsec, either clock
+  long startTime;            // Memorize the time to have started an evaluation
+  long endTime;              // Memorize the time to have stopped an evaluation
 };
 
 #endif
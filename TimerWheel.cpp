@@ -0,0 +1,159 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "TimerWheel.h"
+#include <stddef.h>
+
+const int BITS0 = 8;           // log2(WHEEL_SLOTS0)
+const int BITS = 6;            // log2(WHEEL_SLOTS)
+
+// first tick a timer in wheel level can be for, relative to current.
+static long span(int level) {
+    return 1L << (BITS0 + BITS * level);
+}
+
+TimerWheel::Entry::Entry() : prev(NULL), next(NULL), deadline(0), id(0),
+        level(-1) {
+}
+
+TimerWheel::TimerWheel(long tickUsec) : tickUsec(tickUsec), current(0) {
+    // every list head starts out empty, linked to itself.
+    for(int i = 0; i < WHEEL_SLOTS0; i++)
+        wheel0[i].prev = wheel0[i].next = &wheel0[i];
+    for(int l = 0; l < WHEEL_LEVELS - 1; l++)
+        for(int i = 0; i < WHEEL_SLOTS; i++)
+            wheels[l][i].prev = wheels[l][i].next = &wheels[l][i];
+    expired.prev = expired.next = &expired;
+    for(int l = 0; l < WHEEL_LEVELS; l++) counts[l] = 0;
+}
+
+void TimerWheel::schedule(Entry &e, long deadline) {
+    unlink(e);
+    e.deadline = deadline;
+    insert(e);
+}
+
+void TimerWheel::cancel(Entry &e) {
+    unlink(e);
+}
+
+bool TimerWheel::armed(Entry &e) {
+    return e.level >= 0;
+}
+
+int TimerWheel::size() {
+    int total = 0;
+    for(int l = 0; l < WHEEL_LEVELS; l++) total += counts[l];
+    return total;
+}
+
+void TimerWheel::expire(long now) {
+    long target = now / tickUsec;
+    while(current < target) {
+        if(size() == 0) {
+            // nothing armed, nothing to cascade: jump straight there.
+            current = target;
+            break;
+        }
+        if(counts[0] == 0) {
+            // skip the empty rest of this turn of the inner wheel, up to
+            //     the tick before the next cascade.
+            long last = current | (WHEEL_SLOTS0 - 1);
+            current = last < target ? last : target;
+            if(current == target) break;
+        }
+        tick();
+    }
+}
+
+TimerWheel::Entry *TimerWheel::popExpired() {
+    if(expired.next == &expired) return NULL;
+    Entry *e = expired.next;
+    unlink(*e);
+    return e;
+}
+
+long TimerWheel::nextDeadline() {
+    if(expired.next != &expired) return current * tickUsec;
+    if(counts[0] > 0) {
+        // the inner wheel holds exactly one turn, so walk it in order.
+        for(long t = current + 1; t <= current + WHEEL_SLOTS0; t++) {
+            Entry *head = &wheel0[t & (WHEEL_SLOTS0 - 1)];
+            if(head->next != head) return t * tickUsec;
+        }
+    }
+    if(size() == 0) return -1;
+    // nothing due this turn: the next cascade is the earliest it can be.
+    return ((current | (WHEEL_SLOTS0 - 1)) + 1) * tickUsec;
+}
+
+void TimerWheel::insert(Entry &e) {
+    long due = (e.deadline + tickUsec - 1) / tickUsec; // never fire early
+    long delta = due - current;
+
+    if(delta <= 0) {
+        link(&expired, e, -1);
+    } else if(delta < span(0)) {
+        link(&wheel0[due & (WHEEL_SLOTS0 - 1)], e, 0);
+    } else {
+        int level = 1;
+        while(level < WHEEL_LEVELS - 1 && delta >= span(level)) level++;
+        // past the outermost wheel: park in its farthest slot, it is
+        //     re-inserted by its real deadline when that slot cascades.
+        if(delta >= span(level)) due = current + span(level) - 1;
+        int shift = BITS0 + BITS * (level - 1);
+        link(&wheels[level - 1][(due >> shift) & (WHEEL_SLOTS - 1)], e, level);
+    }
+}
+
+void TimerWheel::link(Entry *head, Entry &e, int level) {
+    e.prev = head->prev;
+    e.next = head;
+    head->prev->next = &e;
+    head->prev = &e;
+    e.level = level;
+    if(level >= 0) counts[level]++;
+}
+
+void TimerWheel::unlink(Entry &e) {
+    if(e.prev == NULL) return;
+    e.prev->next = e.next;
+    e.next->prev = e.prev;
+    e.prev = e.next = NULL;
+    if(e.level >= 0) counts[e.level]--;
+    e.level = -1;
+}
+
+void TimerWheel::cascade(int level, int slot) {
+    Entry *head = &wheels[level - 1][slot];
+    while(head->next != head) {
+        Entry *e = head->next;
+        unlink(*e);
+        insert(*e);
+    }
+}
+
+void TimerWheel::tick() {
+    current++;
+
+    // at the start of each turn of a wheel, bring the next slot of the
+    //     wheel outside it in: outermost first so it can cascade twice.
+    if((current & (WHEEL_SLOTS0 - 1)) == 0) {
+        int level = 1;
+        while(level < WHEEL_LEVELS - 1
+                && ((current >> (BITS0 + BITS * (level - 1))) & (WHEEL_SLOTS - 1)) == 0)
+            level++;
+        for(; level >= 1; level--)
+            cascade(level, (current >> (BITS0 + BITS * (level - 1))) & (WHEEL_SLOTS - 1));
+    }
+
+    Entry *head = &wheel0[current & (WHEEL_SLOTS0 - 1)];
+    while(head->next != head) {
+        Entry *e = head->next;
+        unlink(*e);
+        link(&expired, *e, -1);
+    }
+}
@@ -0,0 +1,55 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+#define WHEEL_TICK 16          // usec per tick of the innermost wheel
+#define WHEEL_LEVELS 4         // wheels, each slot of one spans the next
+#define WHEEL_SLOTS0 256       // slots in the innermost wheel
+#define WHEEL_SLOTS 64         // slots in every outer wheel
+
+// hierarchical timing wheel (Varghese & Lauck). arming, cancelling and
+// firing a timer are O(1); timers far in the future sit in coarse outer
+// slots and cascade inward as time gets close. with 16 usec ticks the wheels
+// span 4 msec, 262 msec, 16.7 sec and 17.9 min.
+class TimerWheel {
+ public:
+    // one timer, embedded in whatever it times (e.g. one per segment).
+    struct Entry {
+        Entry();
+        Entry *prev;
+        Entry *next;
+        long deadline;          // usec, on the clock passed to expire()
+        int id;                 // caller's tag, e.g. the sequence #
+        int level;              // wheel it sits in, -1 if expired or idle
+    };
+
+    TimerWheel(long tickUsec);
+    void schedule(Entry &e, long deadline); // (re)arm e to fire at deadline
+    void cancel(Entry &e);                  // disarm e if armed
+    bool armed(Entry &e);                   // is e waiting to fire
+    int size();                             // # of armed timers
+    void expire(long now);                  // move everything due by now
+                                            //     to the expired list
+    Entry *popExpired();                    // next expired timer or NULL
+    long nextDeadline();                    // earliest time a timer can
+                                            //     fire, -1 if none armed
+ private:
+    void insert(Entry &e);                  // link e by its deadline
+    void link(Entry *head, Entry &e, int level);
+    void unlink(Entry &e);
+    void cascade(int level, int slot);      // spread a slot one level in
+    void tick();                            // advance current by one
+    long tickUsec;
+    long current;                           // last tick processed
+    int counts[WHEEL_LEVELS];               // armed timers per wheel
+    Entry wheel0[WHEEL_SLOTS0];             // list heads of each slot
+    Entry wheels[WHEEL_LEVELS - 1][WHEEL_SLOTS];
+    Entry expired;                          // fired, not yet popped
+};
+
+#endif
@@ -0,0 +1,119 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "TraceRing.h"
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+// where dumpOnSignal()/dumpAtExit() write to, without the pid.
+static char dumpPrefix[256];
+
+TraceRing::TraceRing(int capacity) : head(0) {
+    uint64_t size = 1;
+    while(size < (uint64_t) capacity)
+        size <<= 1;
+    events = new TraceEvent[size];
+    memset(events, 0, size * sizeof(TraceEvent));
+    mask = size - 1;
+    clock.start();
+}
+
+TraceRing::~TraceRing() {
+    delete[] events;
+}
+
+void TraceRing::clear() {
+    head.store(0, std::memory_order_release);
+}
+
+uint64_t TraceRing::recorded() {
+    return head.load(std::memory_order_acquire);
+}
+
+// write all of buffer, past short writes and signals.
+static bool writeAll(int fd, const char *buffer, size_t length) {
+    while(length > 0) {
+        ssize_t n = write(fd, buffer, length);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        buffer += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool TraceRing::dump(const char *path) {
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t size = mask + 1;
+    uint64_t count = end < size ? end : size;
+    uint64_t first = end - count;
+
+    TraceHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.eventSize = sizeof(TraceEvent);
+    header.reserved = 0;
+    header.count = count;
+    header.lost = first;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) return false;
+    // the oldest events run to the end of the array, the rest wrap around.
+    uint64_t start = first & mask;
+    uint64_t tail = count < size - start ? count : size - start;
+    bool ok = writeAll(fd, (const char*) &header, sizeof(header))
+        && writeAll(fd, (const char*) &events[start], tail * sizeof(TraceEvent))
+        && writeAll(fd, (const char*) events, (count - tail) * sizeof(TraceEvent));
+    close(fd);
+    return ok;
+}
+
+TraceRing &TraceRing::process() {
+    static TraceRing ring(TRACE_EVENTS);
+    return ring;
+}
+
+// <dumpPrefix>-<pid>.trace, put together by hand: snprintf isn't safe in a
+//     signal handler.
+void TraceRing::dumpProcess() {
+    char path[sizeof(dumpPrefix) + 32];
+    size_t length = strlen(dumpPrefix);
+    memcpy(path, dumpPrefix, length);
+    path[length++] = '-';
+    char digits[16];
+    int n = 0;
+    for(long pid = getpid(); pid > 0 || n == 0; pid /= 10)
+        digits[n++] = '0' + pid % 10;
+    while(n > 0)
+        path[length++] = digits[--n];
+    memcpy(path + length, ".trace", 7);
+    process().dump(path);
+}
+
+void TraceRing::onSignal(int signo) {
+    int saved = errno;
+    dumpProcess();
+    errno = saved;
+}
+
+void TraceRing::dumpOnSignal(int signo, const char *prefix) {
+    process();               // not for the first time inside the handler
+    strncpy(dumpPrefix, prefix, sizeof(dumpPrefix) - 1);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    action.sa_flags = SA_RESTART;
+    sigaction(signo, &action, NULL);
+}
+
+void TraceRing::dumpAtExit(const char *prefix) {
+    process();               // constructed first, so destroyed after it runs
+    strncpy(dumpPrefix, prefix, sizeof(dumpPrefix) - 1);
+    atexit(dumpProcess);
+}
@@ -0,0 +1,98 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _TRACERING_H_
+#define _TRACERING_H_
+
+#include "Timer.h"
+#include <stdint.h>
+#include <atomic>
+
+#define TRACE_EVENTS (1 << 16) // events kept, the oldest are overwritten
+#define TRACE_MAGIC "UDPTRACE"
+
+// what happened. seq/ack of each:
+enum TraceType {
+    TRACE_SEND,              // a new segment:            seq sent, base
+    TRACE_RETRANSMIT,        // resent after an rto:      seq sent, base
+    TRACE_FASTRETRANSMIT,    // resent on dup/partial ack: seq sent, base
+    TRACE_ACK,               // an ack moved the base:    old base, ack
+    TRACE_DUPACK,            // the same ack again:       base, ack
+    TRACE_TIMEOUT,           // an rto ran out:           base, base
+    TRACE_RECV,              // the server took a segment: seq, next expected
+    TRACE_TYPES
+};
+
+// one event, 24 bytes in host byte order, written to a trace file as is.
+struct TraceEvent {
+    uint64_t nsec;           // since the ring was created
+    uint32_t seq;
+    uint32_t ack;
+    uint16_t window;         // the window the sender may use
+    uint16_t cwnd;           // the congestion controller's, 0: none
+    uint8_t type;            // a TraceType
+    uint8_t reserved;
+    uint16_t connId;         // low bits of the connection id
+};
+
+// a trace file: this header, then count events, oldest first.
+struct TraceHeader {
+    char magic[8];           // TRACE_MAGIC, not terminated
+    uint32_t eventSize;      // sizeof(TraceEvent)
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t lost;           // events overwritten before the dump
+};
+
+// fixed size flight recorder of protocol events, cheap enough to leave on:
+// record() is a clock read and a 24 byte store, no locks, no allocation, no
+// formatting. one thread writes a ring (the process's sender or receiver),
+// so the head is published with a plain release store; a dump reads it
+// from anywhere, a signal handler included, and at worst gets an event
+// that was being overwritten. the trace2dat tool turns a dump into gnuplot
+// data.
+class TraceRing {
+ public:
+    TraceRing(int capacity);   // capacity is rounded up to a power of two
+    ~TraceRing();
+    inline void record(TraceType type, unsigned int seq, unsigned int ack,
+            int window, int cwnd, unsigned int connId = 0);
+    bool dump(const char *path); // write the events kept; only uses
+                                 //     async-signal-safe calls
+    void clear();
+    uint64_t recorded();         // events since creation or clear()
+
+    static TraceRing &process(); // the ring the protocol code records into
+    // dump process() to <prefix>-<pid>.trace on signo, and/or at exit.
+    static void dumpOnSignal(int signo, const char *prefix);
+    static void dumpAtExit(const char *prefix);
+ private:
+    TraceRing(const TraceRing &);             // not copyable
+    TraceRing &operator=(const TraceRing &);
+    static void dumpProcess();   // the signal and exit handlers' work
+    static void onSignal(int signo);
+    TraceEvent *events;
+    uint64_t mask;
+    std::atomic<uint64_t> head;  // events recorded, the next slot & mask
+    Timer clock;
+};
+
+void TraceRing::record(TraceType type, unsigned int seq, unsigned int ack,
+        int window, int cwnd, unsigned int connId) {
+    uint64_t i = head.load(std::memory_order_relaxed);
+    TraceEvent &e = events[i & mask];
+    e.nsec = clock.lapNsec();
+    e.seq = seq;
+    e.ack = ack;
+    e.window = window < 0xffff ? window : 0xffff;
+    e.cwnd = cwnd < 0xffff ? cwnd : 0xffff;
+    e.type = type;
+    e.reserved = 0;
+    e.connId = connId;
+    head.store(i + 1, std::memory_order_release);
+}
+
+#endif
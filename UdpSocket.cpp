@@ -4,15 +4,82 @@
 // Date:         March 5, 2004
 
 #include "UdpSocket.h"
+#include "UdpUring.h"
+#include "Impairment.h"
+#include "SimNetwork.h"
+
+#ifdef __linux__
+#include <linux/errqueue.h> // for the MSG_ZEROCOPY completions
+#endif
 
 // Constructor ----------------------------------------------------------------
 UdpSocket::UdpSocket( int port ) : port( port ), sd( NULL_SD ) {
+  open( false );
+}
+
+// Constructor for a socket that shares its port ------------------------------
+UdpSocket::UdpSocket( int port, bool reusePort ) : port( port ), sd( NULL_SD ) {
+  open( reusePort );
+}
+
+// Constructor for a socket on a simulated network ----------------------------
+UdpSocket::UdpSocket( SimNetwork& net, int port ) : port( port ),
+						    sd( NULL_SD ) {
+  gsoOn = groOn = false;         // no offloads, and no kernel socket at all
+  groBufs = NULL;
+  groCount = groNext = groOffset = 0;
+  uring = NULL;
+  impaired = NULL;
+  impairBufs = NULL;
+  zerocopyOn = zerocopyUsed = false;
+  zerocopyCopied = 0;
+  zcHeads = NULL;
+  zcIds = NULL;
+  zcBusy = NULL;
+  zcNext = 0;
+  zcId = 0;
+  splitBuf = NULL;
+  sim = &net;
+  sim->attach( port );
+  bzero( (char*)&srcAddr, sizeof( srcAddr ) );
+}
+
+// Open a UDP socket and bind it to port --------------------------------------
+void UdpSocket::open( bool reusePort ) {
+  gsoOn = groOn = false;         // until enableGso( )/enableGro( ) succeed
+  groBufs = NULL;
+  groCount = groNext = groOffset = 0;
+  uring = NULL;
+  impaired = NULL;
+  impairBufs = NULL;
+  zerocopyOn = zerocopyUsed = false;
+  zerocopyCopied = 0;
+  zcHeads = NULL;
+  zcIds = NULL;
+  zcBusy = NULL;
+  zcNext = 0;
+  zcId = 0;
+  splitBuf = NULL;
+  sim = NULL;
 
   // Open a UDP socket (a datagram socket )
   if( ( sd = socket( AF_INET, SOCK_DGRAM, 0 ) ) < 0 ) {
     cerr << "Cannot open a UDP socket." << endl;
   }
 
+  // Let every socket bound this way share the port. The kernel spreads the
+  // incoming datagrams over them by the sender's address and port, so each
+  // sender always lands on the same socket.
+  if ( reusePort ) {
+#ifdef SO_REUSEPORT
+    int on = 1;
+    if ( setsockopt( sd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof( on ) ) < 0 )
+      cerr << "Cannot share the UDP port." << endl;
+#else
+    cerr << "SO_REUSEPORT is not supported." << endl;
+#endif
+  }
+
   // Bind our local address
   bzero( (char*)&myAddr, sizeof( myAddr ) );    // Zero-initialize myAddr
   myAddr.sin_family      = AF_INET;             // Use address family internet
@@ -26,14 +93,206 @@ UdpSocket::UdpSocket( int port ) : port( port ), sd( NULL_SD ) {
 
 // Destructor -----------------------------------------------------------------
 UdpSocket::~UdpSocket( ) {
-  // Close the socket being used
+  // Send what the ring still holds, then close the socket being used
+  delete uring;
   if ( sd != NULL_SD )
     close( sd );
+  delete[] groBufs;
+  delete[] impairBufs;
+  delete[] splitBuf;
+  delete[] zcHeads;
+  delete[] zcIds;
+  delete[] zcBusy;
+}
+
+// Let the kernel segment runs of same-size messages sent by sendBatch( ) -----
+bool UdpSocket::enableGso( ) {
+
+  // a zero segment size sets nothing, it only tells whether the kernel knows
+  // UDP_SEGMENT. each send then asks for its own segment size.
+#if defined( __linux__ ) && defined( UDP_SEGMENT )
+  int size = 0;
+  gsoOn = setsockopt( sd, SOL_UDP, UDP_SEGMENT, &size, sizeof( size ) ) == 0;
+#endif
+  return gsoOn;
+}
+
+// Let sendBatch( ) send the bodies of messages without copying them ---------
+bool UdpSocket::enableZerocopy( ) {
+
+  // the kernel pins the pages and sends from them, then reports on the
+  // error queue when it is done. small messages cost more to pin than to
+  // copy, and loopback copies anyway, so this only pays off for large ones
+  // going out of the host
+#if defined( __linux__ ) && defined( SO_ZEROCOPY ) && defined( MSG_ZEROCOPY )
+  int on = 1;
+  if ( sim == NULL
+       && setsockopt( sd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof( on ) ) == 0 )
+    zerocopyOn = true;
+#endif
+  return zerocopyOn;
+}
+
+// Drain the MSG_ZEROCOPY completions off the error queue ---------------------
+int UdpSocket::reapZerocopy( ) {
+  int reaped = 0;
+#if defined( __linux__ ) && defined( SO_EE_ORIGIN_ZEROCOPY )
+  char ctrl[CMSG_SPACE( sizeof( struct sock_extended_err ) ) + 64];
+  while ( true ) {
+    struct msghdr msg;
+    bzero( (char*)&msg, sizeof( msg ) );
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof( ctrl );
+    if ( recvmsg( sd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT ) < 0 )
+      break;
+    for ( struct cmsghdr* cmsg = CMSG_FIRSTHDR( &msg ); cmsg != NULL;
+	  cmsg = CMSG_NXTHDR( &msg, cmsg ) ) {
+      struct sock_extended_err* err =
+	(struct sock_extended_err*)CMSG_DATA( cmsg );
+      if ( err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY )
+	continue;
+
+      // one completion covers the sends numbered ee_info to ee_data, which
+      // frees their heads. if the kernel had to copy them after all,
+      // pinning is pure overhead here
+      reaped++;
+      for ( int i = 0; zcBusy != NULL && i < ZCHEADS; i++ )
+	if ( zcBusy[i]
+	     && zcIds[i] - err->ee_info <= err->ee_data - err->ee_info )
+	  zcBusy[i] = false;
+      if ( err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED ) {
+	zerocopyCopied += err->ee_data - err->ee_info + 1;
+	if ( zerocopyOn ) {
+	  cerr << "MSG_ZEROCOPY copied anyway, sending with copies." << endl;
+	  zerocopyOn = false;
+	}
+      }
+    }
+  }
+#endif
+  // return the number of completions drained
+  return reaped;
+}
+
+// Check that the next count heads have been sent and completed ---------------
+bool UdpSocket::zerocopyHeads( int count ) {
+
+  // a head sent from in place could be rewritten by the caller before the
+  // kernel is done with it, so zero-copy sends go from copies of their own,
+  // reused round robin. if the next ones are still busy, the send copies
+  if ( zcHeads == NULL ) {
+    zcHeads = new char[ZCHEADS * ZCHEADSIZE];
+    zcIds = new unsigned int[ZCHEADS];
+    zcBusy = new bool[ZCHEADS];
+    for ( int i = 0; i < ZCHEADS; i++ )
+      zcBusy[i] = false;
+  }
+  for ( int pass = 0; pass < 2; pass++ ) {
+    int i = 0;
+    while ( i < count && !zcBusy[( zcNext + i ) % ZCHEADS] )
+      i++;
+    if ( i == count )
+      return true;
+    if ( pass == 0 )
+      reapZerocopy( );
+  }
+  return false;
+}
+
+// Set DF and let sendTo( ) go past the kernel's path MTU guess --------------
+bool UdpSocket::probeMtu( ) {
+
+  // a datagram too big for the local link then fails with EMSGSIZE at once,
+  // and one too big for a link further on is lost instead of fragmented, so
+  // whether a probe's reply comes back says whether its size gets through
+  if ( sim != NULL )
+    return true;                 // the simulated network takes any size
+#if defined( __linux__ ) && defined( IP_PMTUDISC_PROBE )
+  int mode = IP_PMTUDISC_PROBE;
+  return setsockopt( sd, IPPROTO_IP, IP_MTU_DISCOVER, &mode,
+		     sizeof( mode ) ) == 0;
+#else
+  return false;
+#endif
+}
+
+// Let the kernel coalesce received messages into larger datagrams ------------
+bool UdpSocket::enableGro( ) {
+
+  // a coalesced datagram is a run of same-size messages from one sender,
+  // only the last of which may be shorter. recvFrom( ) and recvBatch( )
+  // split them apart again, so callers still see one message at a time.
+#if defined( __linux__ ) && defined( UDP_GRO )
+  int on = 1;
+  if ( setsockopt( sd, SOL_UDP, UDP_GRO, &on, sizeof( on ) ) == 0 ) {
+    if ( groBufs == NULL )
+      groBufs = new char[GROBUFS * GROSIZE];
+    groOn = true;
+  }
+#endif
+  return groOn;
+}
+
+// Move sends and receives onto an io_uring -----------------------------------
+bool UdpSocket::enableUring( ) {
+
+  // the ring sizes its send slots and receive buffers for whatever
+  // offloads are on by now
+  if ( uring == NULL && sim == NULL ) {
+    uring = new UdpUring( sd, gsoOn, groOn );
+    if ( !uring->isOpen( ) ) {
+      delete uring;
+      uring = NULL;
+    }
+  }
+  return uring != NULL;
+}
+
+// Go back to one system call per send or receive batch -----------------------
+void UdpSocket::disableUring( ) {
+
+  // anything the ring has received but not handed out yet is dropped
+  delete uring;
+  uring = NULL;
+}
+
+// Receive everything through a simulated link -------------------------------
+void UdpSocket::impair( Impairment* link ) {
+
+  // datagrams the last one still holds are lost with it, the caller owns
+  // the link and may reuse it
+  if ( impairBufs == NULL && link != NULL ) {
+    impairBufs = new char[MAXBATCH * MAXMSGSIZE];
+    for ( int i = 0; i < MAXBATCH; i++ )
+      impairMsgs[i] = impairBufs + i * MAXMSGSIZE;
+  }
+  impaired = link;
+}
+
+// Return the simulated link in use -------------------------------------------
+Impairment* UdpSocket::impairment( ) {
+  return impaired;
 }
 
 // Set the IP addr given a destination IP name in char[] ----------------------
 bool UdpSocket::setDestAddress( char ipName[] ) {
 
+  // send to the same port as this socket's own
+  return setDestAddress( ipName, port );
+}
+
+// Set the IP addr and port given a destination IP name in char[] -------------
+bool UdpSocket::setDestAddress( char ipName[], int destPort ) {
+
+  // a simulated network only has ports, all on one host
+  if ( sim != NULL ) {
+    bzero( (char*)&destAddr, sizeof( destAddr ) );
+    destAddr.sin_family      = AF_INET;
+    destAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    destAddr.sin_port        = htons( destPort );
+    return true;
+  }
+
   // Get the host entry corresponding to this destination ipName
   struct hostent* host = gethostbyname( ipName );
   if( host == NULL ) {
@@ -46,25 +305,110 @@ bool UdpSocket::setDestAddress( char ipName[] ) {
   destAddr.sin_family      = AF_INET;            // Use address family internet
   destAddr.sin_addr.s_addr =                     // set the destination IP addr
     inet_addr( inet_ntoa( *(struct in_addr*)*host->h_addr_list ) );
-  destAddr.sin_port        = htons( port );      // set the destination port
+  destAddr.sin_port        = htons( destPort );  // set the destination port
 
   return true;                                   // set in success
 }
 
 // Check if this socket has data to receive -----------------------------------
 int UdpSocket::pollRecvFrom( ) {
+
+  // through a simulated link, only datagrams whose time has come count
+  if ( impaired != NULL ) {
+    pullImpaired( );
+    if ( !impaired->ready( ) && sim != NULL && sim->wait( port, 0 ) > 0 )
+      pullImpaired( );           // the others had a turn to send
+    return impaired->ready( ) ? 1 : 0;
+  }
+  return pollDirect( );
+}
+
+// Check if the socket itself has data to receive -----------------------------
+int UdpSocket::pollDirect( ) {
+  if ( groNext < groCount )   // messages left from a coalesced datagram
+    return 1;
+  if ( uring != NULL )
+    return uring->wait( 0 );
+  if ( sim != NULL )
+    return sim->wait( port, 0 ); // nothing yet: the others go first
+
   struct pollfd pfd[1];
   pfd[0].fd = sd;             // declare I'll check the data availability of sd
   pfd[0].events = POLLRDNORM; // declare I'm interested in only reading from sd
 
   // check it immediately and return a positive number if sd is readable,
-  // otherwise return 0 or a negative number
-  return poll( pfd, 1, 0 );
+  // otherwise return 0 or a negative number. a MSG_ZEROCOPY completion
+  // wakes poll( ) as well, but it is no data
+  int ready;
+  while ( ( ready = poll( pfd, 1, 0 ) ) > 0 && zerocopyUsed
+	  && !( pfd[0].revents & POLLRDNORM ) && reapZerocopy( ) > 0 );
+  return ready;
+}
+
+// Wait up to usec microseconds for this socket to have data to receive -------
+int UdpSocket::waitRecvFrom( long usec ) {
+  if ( impaired == NULL )
+    return waitDirect( usec );
+
+  // sleep until either more arrives or the first held datagram is due
+  Timer waited;
+  waited.start( );
+  while ( true ) {
+    pullImpaired( );
+    if ( impaired->ready( ) )
+      return 1;
+    long left = usec - waited.lap( );
+    if ( left <= 0 )
+      return 0;
+    long next = impaired->nextRelease( );
+    waitDirect( ( next >= 0 && next < left ) ? next : left );
+  }
+}
+
+// Wait up to usec microseconds for the socket itself to have data ------------
+int UdpSocket::waitDirect( long usec ) {
+  if ( groNext < groCount )   // messages left from a coalesced datagram
+    return 1;
+  if ( uring != NULL )
+    return uring->wait( usec );
+  if ( sim != NULL )
+    return sim->wait( port, usec );
+
+  struct pollfd pfd[1];
+  pfd[0].fd = sd;             // declare I'll check the data availability of sd
+  pfd[0].events = POLLRDNORM; // declare I'm interested in only reading from sd
+
+  // sleep in the kernel until sd is readable or the timeout passes, then
+  // return a positive number if sd is readable, otherwise 0 or a negative one.
+  // a signal (a stats dump) only interrupts the sleep, it goes on after it
+  Timer waited;
+  waited.start( );
+  int ready;
+  do {
+    long left = usec - waited.lap( );
+    if ( left < 0 )
+      left = 0;
+#ifdef __linux__
+    struct timespec ts;       // ppoll( ) keeps sub-millisecond timeouts
+    ts.tv_sec = left / 1000000;
+    ts.tv_nsec = ( left % 1000000 ) * 1000;
+    ready = ppoll( pfd, 1, &ts, NULL );
+#else
+    ready = poll( pfd, 1, (int)( ( left + 999 ) / 1000 ) ); // round up to msec
+#endif
+  } while ( ( ready < 0 && errno == EINTR )
+	    || ( ready > 0 && zerocopyUsed && !( pfd[0].revents & POLLRDNORM )
+		 && reapZerocopy( ) > 0 ) );
+  return ready;
 }
 
 // Send msg[] of length size through the sd socket ----------------------------
 int UdpSocket::sendTo( char msg[], int length ) {
 
+  // the ring and the simulated network only take batches
+  if ( uring != NULL || sim != NULL )
+    return sendBatch( &msg, &length, 1 ) == 1 ? length : -1;
+
   // return the number of bytes sent
   return sendto( sd, msg, length, 0, (sockaddr *)&destAddr, 
 		 sizeof( destAddr ) );
@@ -72,6 +416,15 @@ int UdpSocket::sendTo( char msg[], int length ) {
 
 // Receive data through the sd socket and store it in msg[] of lenth size -----
 int UdpSocket::recvFrom( char msg[], int length ) {
+
+  // coalesced datagrams are split by recvBatch( ), the ring only takes
+  // batches, and a simulated link holds datagrams back
+  if ( groOn || uring != NULL || impaired != NULL || sim != NULL ) {
+    int received;
+    if ( recvBatch( &msg, length, &received, 1, true, &srcAddr ) == 0 )
+      return -1;
+    return received;
+  }
   
   // zero-initialize the srcAddr structure so that it can be filled out with
   // the address of the source computer that has sent msg[]
@@ -85,9 +438,476 @@ int UdpSocket::recvFrom( char msg[], int length ) {
 // Send through the sd socket an acknowledgment in msg[] whose size is length -
 int UdpSocket::ackTo( char msg[], int length ) {
 
+  // the ring and the simulated network only take batches
+  if ( uring != NULL || sim != NULL )
+    return ackBatch( &msg, &length, 1 ) == 1 ? length : -1;
+
   // assume that srcAddress has be filled out upon the previous recvFrom( )
   // method.
 
   // return the number of bytes sent
   return sendto( sd, msg, length, 0, &srcAddr, sizeof( srcAddr ) );
 }
+
+// Send count messages in msgs[] whose sizes are in lengths[] -----------------
+int UdpSocket::sendBatch( char* msgs[], int lengths[], int count ) {
+
+  // return the number of messages sent
+  return sendBatchTo( msgs, lengths, count, (sockaddr *)&destAddr,
+		      sizeof( destAddr ), 0, NULL, 0 );
+}
+
+// Send count messages, each headLength bytes of heads[] and the rest of its --
+// size in lengths[] from bodies[]
+int UdpSocket::sendBatch( char* heads[], int headLength, char* bodies[],
+			  int lengths[], int count ) {
+
+  // return the number of messages sent
+  return sendBatchTo( heads, lengths, count, (sockaddr *)&destAddr,
+		      sizeof( destAddr ), 0, bodies, headLength );
+}
+
+// Send count acks in msgs[] whose sizes are in lengths[] ---------------------
+int UdpSocket::ackBatch( char* msgs[], int lengths[], int count ) {
+
+  // assume that srcAddress has be filled out upon the previous recvFrom( )
+  // or recvBatch( ) method.
+
+  // return the number of acks sent
+  return sendBatchTo( msgs, lengths, count, &srcAddr, sizeof( srcAddr ), 0,
+		      NULL, 0 );
+}
+
+// Send count acks in msgs[] whose sizes are in lengths[] to addrs[] ----------
+int UdpSocket::ackBatch( char* msgs[], int lengths[], int count,
+			 struct sockaddr addrs[] ) {
+
+  // addrs[i] is usually the source recvBatch( ) reported for message i
+
+  // return the number of acks sent
+  return sendBatchTo( msgs, lengths, count, addrs, sizeof( addrs[0] ), 1,
+		      NULL, 0 );
+}
+
+// Send count messages to addrs with as few system calls as possible ----------
+int UdpSocket::sendBatchTo( char* msgs[], int lengths[], int count,
+			    struct sockaddr* addrs, socklen_t addrlen,
+			    int step, char* bodies[], int headLength ) {
+  int sent = 0;
+
+  // a simulated network delivers each message to its port right away
+  if ( sim != NULL ) {
+    for ( ; sent < count; sent++ ) {
+      char* msg = msgs[sent];
+      if ( bodies != NULL && bodies[sent] != NULL ) {
+	if ( splitBuf == NULL )
+	  splitBuf = new char[MAXMSGSIZE];
+	memcpy( splitBuf, msgs[sent], headLength );
+	memcpy( splitBuf + headLength, bodies[sent],
+		lengths[sent] - headLength );
+	msg = splitBuf;
+      }
+      sim->send( port, ntohs( ( (struct sockaddr_in*)&addrs[sent * step] )
+			      ->sin_port ), msg, lengths[sent] );
+    }
+    return sent;
+  }
+#ifdef __linux__
+  struct mmsghdr hdrs[MAXBATCH];
+  struct iovec iovs[2 * MAXBATCH]; // a head and a body per message at most
+  char ctrls[MAXBATCH][CMSG_SPACE( sizeof( uint16_t ) )];
+  int segs[MAXBATCH];            // # of messages in each of hdrs[]
+  bool copy = false;             // MSG_ZEROCOPY ran out of buffer space
+
+  while ( sent < count ) {
+    int n = ( count - sent < MAXBATCH ) ? count - sent : MAXBATCH;
+    int nhdrs = 0;
+    int v = 0;                   // iovs[] used
+
+    // only bodies are worth sending without a copy, so only batches where
+    // every message has one go that way; the ring copies everything into
+    // its own buffers anyway
+    bool zerocopy = false;
+#ifdef MSG_ZEROCOPY
+    zerocopy = zerocopyOn && bodies != NULL && uring == NULL && !copy
+      && headLength <= ZCHEADSIZE && n <= ZCHEADS;
+    for ( int i = 0; zerocopy && i < n; i++ )
+      zerocopy = bodies[sent + i] != NULL;
+    if ( zerocopy )
+      zerocopy = zerocopyHeads( n );
+#endif
+    bzero( (char*)hdrs, sizeof( hdrs[0] ) * n );
+    for ( int i = 0; i < n; nhdrs++ ) {
+
+      // with gso, one of hdrs[] carries a whole run of same-size messages to
+      // the same address as one datagram, and the kernel cuts it back into
+      // messages. only the last one of a run may be shorter. a message with
+      // a body takes two of iovs[], the kernel gathers them into one.
+      int first = i;
+      int firstIov = v;
+      int size = lengths[sent + i];
+      int bytes = 0;
+      struct sockaddr* addr = &addrs[( sent + i ) * step];
+      do {
+	iovs[v].iov_base = msgs[sent + i];
+	iovs[v].iov_len = lengths[sent + i];
+	if ( bodies != NULL && bodies[sent + i] != NULL ) {
+	  if ( zerocopy ) {
+	    char* head = zcHeads + ( ( zcNext + i ) % ZCHEADS ) * ZCHEADSIZE;
+	    memcpy( head, msgs[sent + i], headLength );
+	    iovs[v].iov_base = head;
+	  }
+	  iovs[v++].iov_len = headLength;
+	  iovs[v].iov_base = bodies[sent + i];
+	  iovs[v].iov_len = lengths[sent + i] - headLength;
+	}
+	v++;
+	bytes += lengths[sent + i];
+	i++;
+      } while ( gsoOn && i < n && i - first < GSOSEGS
+		&& lengths[sent + i - 1] == size && lengths[sent + i] <= size
+		&& bytes + lengths[sent + i] <= GSOBYTES
+		&& ( step == 0
+		     || memcmp( addr, &addrs[( sent + i ) * step], addrlen ) == 0 ) );
+
+      hdrs[nhdrs].msg_hdr.msg_name = addr;
+      hdrs[nhdrs].msg_hdr.msg_namelen = addrlen;
+      hdrs[nhdrs].msg_hdr.msg_iov = &iovs[firstIov];
+      hdrs[nhdrs].msg_hdr.msg_iovlen = v - firstIov;
+      segs[nhdrs] = i - first;
+#ifdef UDP_SEGMENT
+      if ( segs[nhdrs] > 1 ) {
+	hdrs[nhdrs].msg_hdr.msg_control = ctrls[nhdrs];
+	hdrs[nhdrs].msg_hdr.msg_controllen = sizeof( ctrls[nhdrs] );
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR( &hdrs[nhdrs].msg_hdr );
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN( sizeof( uint16_t ) );
+	*(uint16_t*)CMSG_DATA( cmsg ) = size;
+      }
+#endif
+    }
+
+    int flags = 0;
+#ifdef MSG_ZEROCOPY
+    if ( zerocopy ) {
+      flags = MSG_ZEROCOPY;
+      zerocopyUsed = true;
+    }
+#endif
+
+    // sendmmsg( ) may stop short, e.g. when the socket buffer fills up. the
+    // ring only queues them, a failed segmented send shows up later.
+    int ret = ( uring != NULL ) ? uring->sendMsgs( hdrs, nhdrs )
+      : sendmmsg( sd, hdrs, nhdrs, flags );
+    if ( uring != NULL && uring->gsoFailed( ) && gsoOn ) {
+      cerr << "UDP_SEGMENT failed, sending one message at a time." << endl;
+      gsoOn = false;
+    }
+    if ( ret <= 0 ) {
+      // the route or the device may still turn segmentation down, then
+      // fall back to one datagram per message for good
+      if ( gsoOn && ( errno == EIO || errno == EINVAL ) ) {
+	cerr << "UDP_SEGMENT failed, sending one message at a time." << endl;
+	gsoOn = false;
+	continue;
+      }
+      // too many sends waiting for their completions: copy the rest
+      if ( flags != 0 && errno == ENOBUFS ) {
+	reapZerocopy( );
+	copy = true;
+	continue;
+      }
+      // a segmented send pins more pieces of pages than one datagram may
+      // have, so with gso every send would fail: copy for good
+      if ( flags != 0 && errno == EMSGSIZE ) {
+	cerr << "MSG_ZEROCOPY failed, sending with copies." << endl;
+	zerocopyOn = false;
+	continue;
+      }
+      break;
+    }
+    // the kernel numbers each successful zero-copy send in turn, and its
+    // heads stay busy until the completion for that number comes back
+    for ( int i = 0; i < ret; i++ ) {
+      for ( int j = 0; flags != 0 && j < segs[i]; j++ ) {
+	zcIds[zcNext] = zcId;
+	zcBusy[zcNext] = true;
+	zcNext = ( zcNext + 1 ) % ZCHEADS;
+      }
+      if ( flags != 0 )
+	zcId++;
+      sent += segs[i];
+    }
+    if ( flags != 0 )
+      reapZerocopy( );
+  }
+#else
+  // no sendmmsg( ): one sendmsg( ) per message
+  for ( ; sent < count; sent++ ) {
+    struct iovec iov[2];
+    struct msghdr msg;
+    bzero( (char*)&msg, sizeof( msg ) );
+    iov[0].iov_base = msgs[sent];
+    iov[0].iov_len = lengths[sent];
+    msg.msg_iovlen = 1;
+    if ( bodies != NULL && bodies[sent] != NULL ) {
+      iov[0].iov_len = headLength;
+      iov[1].iov_base = bodies[sent];
+      iov[1].iov_len = lengths[sent] - headLength;
+      msg.msg_iovlen = 2;
+    }
+    msg.msg_iov = iov;
+    msg.msg_name = &addrs[sent * step];
+    msg.msg_namelen = addrlen;
+    if ( sendmsg( sd, &msg, 0 ) < 0 )
+      break;
+  }
+#endif
+  // return the number of messages sent
+  return sent;
+}
+
+// Receive up to count messages of length size each into msgs[] ---------------
+int UdpSocket::recvBatch( char* msgs[], int length, int lengths[], int count,
+			  bool wait ) {
+  struct sockaddr addrs[MAXBATCH];
+
+  // return the number of messages received
+  return recvBatch( msgs, length, lengths, count, wait, addrs );
+}
+
+// Receive up to count messages and the address each came from in addrs[] ----
+int UdpSocket::recvBatch( char* msgs[], int length, int lengths[], int count,
+			  bool wait, struct sockaddr addrs[] ) {
+  if ( impaired == NULL )
+    return recvDirect( msgs, length, lengths, count, wait, addrs, NULL, 0 );
+
+  // hand out the datagrams whose time has come, waiting for the first one
+  // if asked to
+  pullImpaired( );
+  while ( wait && !impaired->ready( ) )
+    waitRecvFrom( 1000000 );
+  int received = 0;
+  while ( received < count && impaired->ready( ) ) {
+    lengths[received] = impaired->take( msgs[received], length,
+					addrs[received] );
+    received++;
+  }
+  if ( received > 0 )
+    srcAddr = addrs[received - 1];
+
+  // return the number of messages received
+  return received;
+}
+
+// Receive up to count messages of length size each, the first headLength ----
+// bytes of each into heads[] and the rest into bodies[]
+int UdpSocket::recvBatch( char* heads[], int headLength, char* bodies[],
+			  int length, int lengths[], int count, bool wait ) {
+  struct sockaddr addrs[MAXBATCH];
+  if ( count > MAXBATCH )
+    count = MAXBATCH;
+
+  // the kernel scatters each datagram itself, or it is split straight out
+  // of a coalesced one
+  if ( impaired == NULL && uring == NULL && sim == NULL )
+    return recvDirect( heads, length, lengths, count, wait, addrs, bodies,
+		       headLength );
+
+  // the rest hand out whole datagrams: take one at a time and split it
+  if ( splitBuf == NULL )
+    splitBuf = new char[MAXMSGSIZE];
+  int received = 0;
+  while ( received < count
+	  && recvBatch( &splitBuf, length, &lengths[received], 1,
+			wait && received == 0, &addrs[received] ) == 1 ) {
+    int head = ( lengths[received] < headLength ) ? lengths[received]
+      : headLength;
+    memcpy( heads[received], splitBuf, head );
+    memcpy( bodies[received], splitBuf + head, lengths[received] - head );
+    received++;
+  }
+
+  // return the number of messages received
+  return received;
+}
+
+// Move every datagram the socket has into the simulated link -----------------
+int UdpSocket::pullImpaired( ) {
+  int lengths[MAXBATCH];
+  struct sockaddr addrs[MAXBATCH];
+  int pulled = 0;
+  int received;
+  do {
+    received = recvDirect( impairMsgs, MAXMSGSIZE, lengths, MAXBATCH, false,
+			   addrs, NULL, 0 );
+    for ( int i = 0; i < received; i++ )
+      impaired->arrive( impairMsgs[i], lengths[i], addrs[i] );
+    pulled += received;
+  } while ( received == MAXBATCH );
+
+  // return the number of datagrams moved
+  return pulled;
+}
+
+// Receive up to count messages from the socket itself ------------------------
+int UdpSocket::recvDirect( char* msgs[], int length, int lengths[], int count,
+			   bool wait, struct sockaddr addrs[], char* bodies[],
+			   int headLength ) {
+  if ( count > MAXBATCH )
+    count = MAXBATCH;
+  int received = 0;
+  if ( sim != NULL ) {
+    if ( wait )
+      sim->wait( port, -1 );
+    int from;
+    while ( received < count
+	    && ( lengths[received] = sim->recv( port, msgs[received], length,
+						from ) ) >= 0 ) {
+      struct sockaddr_in* addr = (struct sockaddr_in*)&addrs[received++];
+      bzero( (char*)addr, sizeof( addrs[0] ) );
+      addr->sin_family = AF_INET;
+      addr->sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+      addr->sin_port = htons( from );
+    }
+    if ( received > 0 )
+      srcAddr = addrs[received - 1];
+    return received;
+  }
+#ifdef __linux__
+  if ( uring != NULL ) {
+    received = uring->recvMsgs( msgs, length, lengths, count, wait, addrs );
+    if ( received > 0 )
+      srcAddr = addrs[received - 1];
+    return received;
+  }
+  if ( groOn ) {
+    // hand out the messages in coalesced datagrams one at a time, and only
+    // wait for more if there is nothing at all to return
+    while ( received < count ) {
+      if ( groNext == groCount && fillGro( wait && received == 0 ) == 0 )
+	break;
+      int size = groLengths[groNext] - groOffset;
+      if ( size > groSegSizes[groNext] )
+	size = groSegSizes[groNext];
+      lengths[received] = ( size < length ) ? size : length;
+      char* from = groBufs + groNext * GROSIZE + groOffset;
+      if ( bodies == NULL )
+	memcpy( msgs[received], from, lengths[received] );
+      else {
+	int head = ( lengths[received] < headLength ) ? lengths[received]
+	  : headLength;
+	memcpy( msgs[received], from, head );
+	memcpy( bodies[received], from + head, lengths[received] - head );
+      }
+      addrs[received++] = groAddrs[groNext];
+      if ( ( groOffset += size ) >= groLengths[groNext] ) {
+	groNext++;
+	groOffset = 0;
+      }
+    }
+    if ( received > 0 )
+      srcAddr = addrs[received - 1];
+    return received;
+  }
+
+  struct mmsghdr hdrs[MAXBATCH];
+  struct iovec iovs[MAXBATCH][2]; // a head and a body each at most
+
+  bzero( (char*)hdrs, sizeof( hdrs[0] ) * count );
+  for ( int i = 0; i < count; i++ ) {
+    iovs[i][0].iov_base = msgs[i];
+    iovs[i][0].iov_len = length;
+    hdrs[i].msg_hdr.msg_iovlen = 1;
+    if ( bodies != NULL ) {
+      iovs[i][0].iov_len = headLength;
+      iovs[i][1].iov_base = bodies[i];
+      iovs[i][1].iov_len = length - headLength;
+      hdrs[i].msg_hdr.msg_iovlen = 2;
+    }
+    hdrs[i].msg_hdr.msg_name = &addrs[i];
+    hdrs[i].msg_hdr.msg_namelen = sizeof( addrs[i] );
+    hdrs[i].msg_hdr.msg_iov = iovs[i];
+  }
+
+  // MSG_WAITFORONE blocks for the first message only, MSG_DONTWAIT for none
+  received = recvmmsg( sd, hdrs, count, wait ? MSG_WAITFORONE : MSG_DONTWAIT,
+		       NULL );
+  if ( received <= 0 )
+    return 0;
+  for ( int i = 0; i < received; i++ )
+    lengths[i] = hdrs[i].msg_len;
+
+  // remember the last sender for ackTo( ) and ackBatch( )
+  srcAddr = addrs[received - 1];
+#else
+  // no recvmmsg( ): one recvfrom( ) per message while data is pending
+  while ( received < count ) {
+    if ( !( received == 0 && wait ) && pollDirect( ) <= 0 )
+      break;
+    struct iovec iov[2];
+    struct msghdr msg;
+    bzero( (char*)&msg, sizeof( msg ) );
+    iov[0].iov_base = msgs[received];
+    iov[0].iov_len = length;
+    msg.msg_iovlen = 1;
+    if ( bodies != NULL ) {
+      iov[0].iov_len = headLength;
+      iov[1].iov_base = bodies[received];
+      iov[1].iov_len = length - headLength;
+      msg.msg_iovlen = 2;
+    }
+    msg.msg_iov = iov;
+    msg.msg_name = &addrs[received];
+    msg.msg_namelen = sizeof( addrs[received] );
+    if ( ( lengths[received] = recvmsg( sd, &msg, 0 ) ) < 0 )
+      break;
+    srcAddr = addrs[received++];
+  }
+#endif
+  // return the number of messages received
+  return received;
+}
+
+// Receive up to GROBUFS possibly coalesced datagrams into groBufs ------------
+int UdpSocket::fillGro( bool wait ) {
+  groCount = groNext = groOffset = 0;
+#if defined( __linux__ ) && defined( UDP_GRO )
+  struct mmsghdr hdrs[GROBUFS];
+  struct iovec iovs[GROBUFS];
+  char ctrls[GROBUFS][CMSG_SPACE( sizeof( int ) )];
+
+  bzero( (char*)hdrs, sizeof( hdrs ) );
+  for ( int i = 0; i < GROBUFS; i++ ) {
+    iovs[i].iov_base = groBufs + i * GROSIZE;
+    iovs[i].iov_len = GROSIZE;
+    hdrs[i].msg_hdr.msg_name = &groAddrs[i];
+    hdrs[i].msg_hdr.msg_namelen = sizeof( groAddrs[i] );
+    hdrs[i].msg_hdr.msg_iov = &iovs[i];
+    hdrs[i].msg_hdr.msg_iovlen = 1;
+    hdrs[i].msg_hdr.msg_control = ctrls[i];
+    hdrs[i].msg_hdr.msg_controllen = sizeof( ctrls[i] );
+  }
+
+  int received = recvmmsg( sd, hdrs, GROBUFS,
+			   wait ? MSG_WAITFORONE : MSG_DONTWAIT, NULL );
+  if ( received <= 0 )
+    return 0;
+
+  // a datagram without a UDP_GRO message was not coalesced
+  for ( int i = 0; i < received; i++ ) {
+    groLengths[i] = hdrs[i].msg_len;
+    groSegSizes[i] = hdrs[i].msg_len;
+    for ( struct cmsghdr* cmsg = CMSG_FIRSTHDR( &hdrs[i].msg_hdr );
+	  cmsg != NULL; cmsg = CMSG_NXTHDR( &hdrs[i].msg_hdr, cmsg ) )
+      if ( cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO )
+	groSegSizes[i] = *(int*)CMSG_DATA( cmsg );
+    if ( groSegSizes[i] <= 0 )
+      groSegSizes[i] = groLengths[i] > 0 ? groLengths[i] : 1;
+  }
+  groCount = received;
+#endif
+  // return the number of datagrams received
+  return groCount;
+}
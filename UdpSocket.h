@@ -7,7 +7,16 @@
 #define _UDPSOCKET_H_
 
 #include <iostream>
-#define MSGSIZE 1460      // UDP message size in bytes
+#define MSGSIZE 1460      // default UDP message size in bytes, one ethernet
+                          // frame with room for a header (FEC)
+#define MAXMSGSIZE 65507  // largest datagram, what UDP over IPv4 carries
+#define MAXBATCH 64       // max # messages moved by one batch call
+#define GSOSEGS 64        // max # messages the kernel segments out of one send
+#define GSOBYTES 65507    // max bytes in one segmented send (a UDP datagram)
+#define GROBUFS 8         // max # coalesced datagrams taken in by one call
+#define GROSIZE 65536     // max size of a coalesced datagram
+#define ZCHEADS 1024      // max # heads of MSG_ZEROCOPY sends in flight
+#define ZCHEADSIZE 64     // max size of such a head
 
 using namespace std;
 
@@ -23,25 +32,120 @@ extern "C"
 #include <string.h>       // for bzero( )
 
 #include <sys/poll.h>     // for poll( )
+#include <sys/uio.h>      // for iovec in sendmmsg( ) and recvmmsg( )
+#include <netinet/udp.h>  // for UDP_SEGMENT and UDP_GRO
+#include <errno.h>
+#include <stdint.h>
 }
 
 #define NULL_SD -1        // means no socket descriptor
 
+class UdpUring;
+class Impairment;
+class SimNetwork;
+
 class UdpSocket {
  public:
   UdpSocket( int );              // open an UDP socket with int port
+  UdpSocket( int, bool );        // same as above; bool: let other sockets
+                                 // share the port with SO_REUSEPORT
+  UdpSocket( SimNetwork&, int ); // a socket on port int of a simulated
+                                 // network instead of the kernel's
   ~UdpSocket( );
   bool setDestAddress( char[] ); // set the IP addr given an IP name in char[]
+  bool setDestAddress( char[], int ); // same as above but to another int port
+  bool enableGso( );             // let the kernel split runs of same-size
+                                 // messages in sendBatch( ); false: no support
+  bool enableGro( );             // let the kernel coalesce received messages,
+                                 // split again on receipt; false: no support
+  bool enableZerocopy( );        // send what follows the header of each
+                                 // message in sendBatch( ) with MSG_ZEROCOPY,
+                                 // straight from the caller's pages; false:
+                                 // no support
+  bool probeMtu( );              // send everything with DF set and past the
+                                 // kernel's path MTU guess, so probes find
+                                 // the real one; false: no support
+  bool enableUring( );           // move all I/O onto io_uring, after any
+                                 // enableGso/Gro( ); false: no support
+  void disableUring( );          // back to plain system calls
+  void impair( Impairment* );    // pass everything received through a
+                                 // simulated link first; NULL: none
+  Impairment* impairment( );     // the one in place, NULL if none
   int pollRecvFrom( );           // check if this socket has data to receive
+  int waitRecvFrom( long );      // wait up to long usec for data to receive
   int sendTo( char[], int );     // send a message in char[] whose size is int
   int recvFrom( char[], int );   // receive a message in char[] of int size
   int ackTo( char[], int );      // send an ack message in char[] of int size
+  int sendBatch( char*[], int[], int ); // send int messages in char*[] whose
+                                 // sizes are in int[], in one call if possible
+  int sendBatch( char*[], int, char*[], int[], int ); // same as above, but
+                                 // each message is its first int bytes in
+                                 // char*[] and the rest of its int[] size in
+                                 // char*[] (NULL: all of it in the first),
+                                 // gathered by the kernel. with zerocopy,
+                                 // the kernel may still read the bodies
+                                 // after it returns, so they must not
+                                 // change; the heads are copied
+  int recvBatch( char*[], int, int[], int, bool ); // receive up to int
+                                 // messages of int size each, store their
+                                 // sizes in int[]; bool: wait for the first
+  int recvBatch( char*[], int, int[], int, bool, struct sockaddr[] );
+                                 // same as above but also store each
+                                 // message's source in sockaddr[]
+  int recvBatch( char*[], int, char*[], int, int[], int, bool ); // same as
+                                 // the first, but the first int bytes of
+                                 // each go to char*[] and the rest of up
+                                 // to int bytes to char*[], scattered by the
+                                 // kernel where it can
+  int ackBatch( char*[], int[], int ); // send int acks in char*[] whose sizes
+                                 // are in int[] to the last source
+  int ackBatch( char*[], int[], int, struct sockaddr[] ); // same as above but
+                                 // send each ack to its own sockaddr[]
  private:
   int port;                      // this UDP port
   int sd;                        // this UDP socket descriptor
   struct sockaddr_in myAddr;     // my socket address for internet
   struct sockaddr_in destAddr;   // a destination socket address for internet
   struct sockaddr srcAddr;       // a source socket address for internet
+  void open( bool );             // open and bind; bool: set SO_REUSEPORT
+  bool gsoOn;                    // sendBatch( ) uses UDP_SEGMENT
+  bool groOn;                    // receives go through groBufs
+  char *groBufs;                 // GROBUFS coalesced datagrams of GROSIZE
+  int groLengths[GROBUFS];       // their sizes,
+  int groSegSizes[GROBUFS];      // the size of each message in them,
+  struct sockaddr groAddrs[GROBUFS]; // and who sent them
+  int groCount;                  // # of coalesced datagrams held
+  int groNext;                   // the one being split
+  int groOffset;                 // bytes of it already handed out
+  int fillGro( bool );           // receive coalesced datagrams; bool: wait
+  bool zerocopyOn;               // sendBatch( ) bodies go with MSG_ZEROCOPY
+  bool zerocopyUsed;             // completions may still be on the way
+  long zerocopyCopied;           // sends the kernel copied all the same
+  int reapZerocopy( );           // drain the completions off the error queue
+  bool zerocopyHeads( int );     // are the next int heads free, with room
+  char* zcHeads;                 // ZCHEADS copies of heads sent with bodies,
+  unsigned int* zcIds;           // the id of the send each went out with
+  bool* zcBusy;                  // its completion is still on the way
+  int zcNext;                    // the next of them to use, round robin
+  unsigned int zcId;             // the id the kernel gives the next send
+  char* splitBuf;                // one datagram, split into head and body
+  UdpUring* uring;               // io_uring backend, NULL if not in use
+  Impairment* impaired;          // simulated link, NULL if not in use
+  SimNetwork* sim;               // simulated network, NULL: the kernel's
+  char* impairBufs;              // MAXBATCH datagrams moved into it at once
+  char* impairMsgs[MAXBATCH];    // where each of them goes in impairBufs
+  int pullImpaired( );           // move what the kernel has into impaired
+  int pollDirect( );             // pollRecvFrom( ), waitRecvFrom( ) and
+  int waitDirect( long );        // recvBatch( ) on the socket itself,
+  int recvDirect( char*[], int, int[], int, bool, struct sockaddr[],
+		  char*[], int );
+                                 // bypassing impaired, scattering past the
+                                 // int head bytes into char*[] unless NULL
+  int sendBatchTo( char*[], int[], int, struct sockaddr*, socklen_t, int,
+		   char*[], int );
+                                 // sendBatch( ) to the given addresses, int
+                                 // apart (0: all to the same address), with
+                                 // bodies in char*[] past int head bytes
 };  
 
 #endif  
@@ -0,0 +1,432 @@
+// Project:      CSS432 UDP Socket Class
+// Professor:    Munehiro Fukuda
+// Organization: CSS, University of Washington, Bothell
+// Date:         March 5, 2004
+
+#include "UdpUring.h"
+
+#ifdef __linux__
+extern "C"
+{
+#include <linux/io_uring.h>
+#include <sys/mman.h>     // for mmap( )
+#include <sys/syscall.h>  // for the io_uring system calls, there's no libc
+#include <signal.h>       // for _NSIG
+#include <time.h>         // for clock_gettime( )
+}
+
+#define URINGRECV 0xffffffffffffffffULL // user_data of the recvmsg( )
+#define URINGBGID 0                     // group id of the receive buffers
+
+// Set up the rings, the send slots and the receive buffers -------------------
+UdpUring::UdpUring( int sd, bool gso, bool gro )
+  : fd( -1 ), gro( gro ), gsoBroken( false ),
+    sqes( (struct io_uring_sqe*)MAP_FAILED ), sqMap( MAP_FAILED ),
+    cqMap( MAP_FAILED ), slotData( NULL ), nFree( 0 ), sd( sd ), armed( false ),
+    bufRing( (struct io_uring_buf_ring*)MAP_FAILED ), bufTail( 0 ),
+    bufs( NULL ), readyHead( 0 ), readyCount( 0 ), readyOffset( 0 ) {
+
+  struct io_uring_params params;
+  bzero( (char*)&params, sizeof( params ) );
+  if ( ( fd = syscall( __NR_io_uring_setup, URINGENTRIES, &params ) ) < 0 ) {
+    fd = -1;
+    return;
+  }
+  // the timed waits need IORING_ENTER_EXT_ARG
+  if ( !( params.features & IORING_FEAT_EXT_ARG ) ) {
+    close( fd );
+    fd = -1;
+    return;
+  }
+
+  // map the submission queue, the completion queue and the sqes
+  sqMapSize = params.sq_off.array + params.sq_entries * sizeof( unsigned int );
+  cqMapSize = params.cq_off.cqes
+    + params.cq_entries * sizeof( struct io_uring_cqe );
+  if ( params.features & IORING_FEAT_SINGLE_MMAP ) {
+    if ( cqMapSize > sqMapSize )
+      sqMapSize = cqMapSize;
+    cqMapSize = sqMapSize;
+  }
+  sqMap = mmap( NULL, sqMapSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+  if ( sqMap == MAP_FAILED )
+    return;
+  if ( params.features & IORING_FEAT_SINGLE_MMAP )
+    cqMap = sqMap;
+  else
+    cqMap = mmap( NULL, cqMapSize, PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+  if ( cqMap == MAP_FAILED )
+    return;
+  sqesSize = params.sq_entries * sizeof( struct io_uring_sqe );
+  sqes = (struct io_uring_sqe*)mmap( NULL, sqesSize, PROT_READ | PROT_WRITE,
+				     MAP_SHARED | MAP_POPULATE, fd,
+				     IORING_OFF_SQES );
+  if ( sqes == MAP_FAILED )
+    return;
+
+  char* sq = (char*)sqMap;
+  sqHead = (unsigned int*)( sq + params.sq_off.head );
+  sqTail = (unsigned int*)( sq + params.sq_off.tail );
+  sqMask = (unsigned int*)( sq + params.sq_off.ring_mask );
+  sqArray = (unsigned int*)( sq + params.sq_off.array );
+  sqEntries = params.sq_entries;
+  char* cq = (char*)cqMap;
+  cqHead = (unsigned int*)( cq + params.cq_off.head );
+  cqTail = (unsigned int*)( cq + params.cq_off.tail );
+  cqMask = (unsigned int*)( cq + params.cq_off.ring_mask );
+  cqes = (struct io_uring_cqe*)( cq + params.cq_off.cqes );
+
+  // register the receive buffers as a provided buffer ring: the kernel
+  // picks a free one for every message and hands it back in the completion
+  bufRing = (struct io_uring_buf_ring*)
+    mmap( NULL, URINGBUFS * sizeof( struct io_uring_buf ),
+	  PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if ( bufRing == MAP_FAILED )
+    return;
+  struct io_uring_buf_reg reg;
+  bzero( (char*)&reg, sizeof( reg ) );
+  reg.ring_addr = (unsigned long)bufRing;
+  reg.ring_entries = URINGBUFS;
+  reg.bgid = URINGBGID;
+  if ( syscall( __NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING,
+		&reg, 1 ) < 0 ) {
+    munmap( bufRing, URINGBUFS * sizeof( struct io_uring_buf ) );
+    bufRing = (struct io_uring_buf_ring*)MAP_FAILED;
+    return;
+  }
+
+  // each buffer holds a recvmsg( ) header, the source address, room for a
+  // UDP_GRO control message and the payload
+  bzero( (char*)&recvHdr, sizeof( recvHdr ) );
+  recvHdr.msg_namelen = sizeof( struct sockaddr );
+  recvHdr.msg_controllen = gro ? CMSG_SPACE( sizeof( int ) ) : 0;
+  bufSize = sizeof( struct io_uring_recvmsg_out ) + recvHdr.msg_namelen
+    + recvHdr.msg_controllen + ( gro ? GROSIZE : MAXMSGSIZE );
+  bufs = new char[URINGBUFS * bufSize];
+  for ( int i = 0; i < URINGBUFS; i++ )
+    giveBuffer( i );
+
+  slotSize = gso ? GSOBYTES : MAXMSGSIZE;
+  slotData = new char[URINGSLOTS * slotSize];
+  for ( int i = 0; i < URINGSLOTS; i++ ) {
+    slots[i].data = slotData + i * slotSize;
+    freeSlots[nFree++] = i;
+  }
+
+  arm( );
+}
+
+// Send everything still queued, then tear the ring down ----------------------
+UdpUring::~UdpUring( ) {
+  if ( isOpen( ) ) {
+    while ( nFree < URINGSLOTS && enter( true, NULL ) >= 0 )
+      reap( );
+  }
+  if ( bufRing != MAP_FAILED )
+    munmap( bufRing, URINGBUFS * sizeof( struct io_uring_buf ) );
+  if ( sqes != MAP_FAILED )
+    munmap( sqes, sqesSize );
+  if ( cqMap != MAP_FAILED && cqMap != sqMap )
+    munmap( cqMap, cqMapSize );
+  if ( sqMap != MAP_FAILED )
+    munmap( sqMap, sqMapSize );
+  if ( fd >= 0 )
+    close( fd );
+  delete[] bufs;
+  delete[] slotData;
+}
+
+// Check if the ring came up completely ---------------------------------------
+bool UdpUring::isOpen( ) {
+  return fd >= 0 && bufs != NULL && slotData != NULL;
+}
+
+// Check if a segmented send came back refused --------------------------------
+bool UdpUring::gsoFailed( ) {
+  return gsoBroken;
+}
+
+// Get the next free sqe, submitting the queue if it is full ------------------
+struct io_uring_sqe* UdpUring::getSqe( ) {
+  unsigned int tail = *sqTail;
+  while ( tail - __atomic_load_n( sqHead, __ATOMIC_ACQUIRE ) >= sqEntries )
+    if ( enter( false, NULL ) < 0 )
+      return NULL;
+  struct io_uring_sqe* sqe = &sqes[tail & *sqMask];
+  bzero( (char*)sqe, sizeof( *sqe ) );
+  sqArray[tail & *sqMask] = tail & *sqMask;
+  return sqe;
+}
+
+// Publish the sqe handed out last by getSqe( ) -------------------------------
+static void pushSqe( unsigned int* sqTail ) {
+  __atomic_store_n( sqTail, *sqTail + 1, __ATOMIC_RELEASE );
+}
+
+// Submit queued sqes, and optionally wait for one completion until ts --------
+int UdpUring::enter( bool wait, struct timespec* ts ) {
+  unsigned int toSubmit = *sqTail - __atomic_load_n( sqHead, __ATOMIC_ACQUIRE );
+  unsigned int flags = IORING_ENTER_EXT_ARG;
+  if ( wait )
+    flags |= IORING_ENTER_GETEVENTS;
+  struct io_uring_getevents_arg arg;
+  bzero( (char*)&arg, sizeof( arg ) );
+  arg.sigmask_sz = _NSIG / 8;
+  arg.ts = (unsigned long)ts;
+
+  int ret = syscall( __NR_io_uring_enter, fd, toSubmit, wait ? 1 : 0, flags,
+		     &arg, sizeof( arg ) );
+  // a timeout or a signal only ends the wait
+  if ( ret < 0 && ( errno == ETIME || errno == EINTR ) )
+    return 0;
+  return ret;
+}
+
+// Take in every completion: free the send slots, queue the received ---------
+void UdpUring::reap( ) {
+  unsigned int head = *cqHead;
+  unsigned int tail = __atomic_load_n( cqTail, __ATOMIC_ACQUIRE );
+  for ( ; head != tail; head++ ) {
+    struct io_uring_cqe* cqe = &cqes[head & *cqMask];
+
+    if ( cqe->user_data == URINGRECV ) {
+      // without F_MORE the recvmsg( ) is over, e.g. out of buffers
+      if ( !( cqe->flags & IORING_CQE_F_MORE ) )
+	armed = false;
+      if ( !( cqe->flags & IORING_CQE_F_BUFFER ) )
+	continue;
+      int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+      if ( cqe->res < 0 ) {
+	giveBuffer( bid );
+	continue;
+      }
+
+      // the buffer starts with a header, then the name and control parts
+      // as long as recvHdr asked for, then the payload
+      char* buf = bufs + bid * bufSize;
+      struct io_uring_recvmsg_out* out = (struct io_uring_recvmsg_out*)buf;
+      Received &r = ready[( readyHead + readyCount++ ) % URINGBUFS];
+      r.bid = bid;
+      r.offset = sizeof( *out ) + recvHdr.msg_namelen + recvHdr.msg_controllen;
+      r.length = cqe->res - r.offset;
+      if ( r.length > (int)out->payloadlen )
+	r.length = out->payloadlen;
+      if ( r.length < 0 )
+	r.length = 0;
+      bzero( (char*)&r.addr, sizeof( r.addr ) );
+      memcpy( &r.addr, buf + sizeof( *out ),
+	      out->namelen < sizeof( r.addr ) ? out->namelen : sizeof( r.addr ) );
+
+      // a coalesced datagram says how long its messages are
+      r.segSize = r.length;
+      if ( gro ) {
+	struct msghdr ctrl;
+	bzero( (char*)&ctrl, sizeof( ctrl ) );
+	ctrl.msg_control = buf + sizeof( *out ) + recvHdr.msg_namelen;
+	ctrl.msg_controllen = out->controllen;
+	for ( struct cmsghdr* cmsg = CMSG_FIRSTHDR( &ctrl ); cmsg != NULL;
+	      cmsg = CMSG_NXTHDR( &ctrl, cmsg ) )
+	  if ( cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO )
+	    r.segSize = *(int*)CMSG_DATA( cmsg );
+      }
+      if ( r.segSize <= 0 )
+	r.segSize = r.length > 0 ? r.length : 1;
+    }
+    else {
+      // a failed send is a lost datagram, except that a refused segmented
+      // send tells the socket to stop asking for segmentation
+      Slot &slot = slots[cqe->user_data];
+      if ( ( cqe->res == -EIO || cqe->res == -EINVAL )
+	   && slot.hdr.msg_controllen > 0 )
+	gsoBroken = true;
+      freeSlots[nFree++] = cqe->user_data;
+    }
+  }
+  __atomic_store_n( cqHead, head, __ATOMIC_RELEASE );
+}
+
+// Queue the multishot recvmsg( ) ---------------------------------------------
+void UdpUring::arm( ) {
+  struct io_uring_sqe* sqe = getSqe( );
+  if ( sqe == NULL )
+    return;
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = sd;
+  sqe->addr = (unsigned long)&recvHdr;
+  sqe->len = 1;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = URINGBGID;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->user_data = URINGRECV;
+  pushSqe( sqTail );
+  armed = true;
+}
+
+// Lend receive buffer bid to the kernel again --------------------------------
+void UdpUring::giveBuffer( int bid ) {
+  // the ring is a plain array of io_uring_buf whose first one overlaps the
+  // tail. (bufRing->bufs is off by 8 bytes in C++, where the empty struct
+  // the kernel header puts in front of it takes up space.)
+  struct io_uring_buf* buf =
+    &( (struct io_uring_buf*)bufRing )[bufTail & ( URINGBUFS - 1 )];
+  buf->addr = (unsigned long)( bufs + bid * bufSize );
+  buf->len = bufSize;
+  buf->bid = bid;
+  bufTail++;
+  __atomic_store_n( &bufRing->tail, bufTail, __ATOMIC_RELEASE );
+}
+
+// Queue count messages, copying each into a slot of its own ------------------
+int UdpUring::sendMsgs( struct mmsghdr hdrs[], int count ) {
+  int queued = 0;
+  for ( ; queued < count; queued++ ) {
+    // all slots in flight: submit and wait for some to complete
+    while ( nFree == 0 ) {
+      reap( );
+      if ( nFree == 0 && enter( true, NULL ) < 0 )
+	return queued;
+    }
+
+    struct msghdr &msg = hdrs[queued].msg_hdr;
+    int bytes = 0;
+    for ( size_t i = 0; i < msg.msg_iovlen; i++ )
+      bytes += msg.msg_iov[i].iov_len;
+    if ( bytes > slotSize || msg.msg_namelen > sizeof( struct sockaddr )
+	 || msg.msg_controllen > sizeof( slots[0].ctrl ) ) {
+      errno = EMSGSIZE;
+      break;
+    }
+
+    int s = freeSlots[nFree - 1];
+    Slot &slot = slots[s];
+    bytes = 0;
+    for ( size_t i = 0; i < msg.msg_iovlen; i++ ) {
+      memcpy( slot.data + bytes, msg.msg_iov[i].iov_base,
+	      msg.msg_iov[i].iov_len );
+      bytes += msg.msg_iov[i].iov_len;
+    }
+    slot.iov.iov_base = slot.data;
+    slot.iov.iov_len = bytes;
+    bzero( (char*)&slot.hdr, sizeof( slot.hdr ) );
+    slot.hdr.msg_iov = &slot.iov;
+    slot.hdr.msg_iovlen = 1;
+    if ( msg.msg_name != NULL ) {
+      memcpy( &slot.addr, msg.msg_name, msg.msg_namelen );
+      slot.hdr.msg_name = &slot.addr;
+      slot.hdr.msg_namelen = msg.msg_namelen;
+    }
+    if ( msg.msg_controllen > 0 ) {
+      memcpy( slot.ctrl, msg.msg_control, msg.msg_controllen );
+      slot.hdr.msg_control = slot.ctrl;
+      slot.hdr.msg_controllen = msg.msg_controllen;
+    }
+
+    struct io_uring_sqe* sqe = getSqe( );
+    if ( sqe == NULL )
+      break;
+    nFree--;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = sd;
+    sqe->addr = (unsigned long)&slot.hdr;
+    sqe->len = 1;
+    sqe->user_data = s;
+    pushSqe( sqTail );
+  }
+  // one system call hands the kernel the whole batch, without waiting
+  if ( queued > 0 )
+    enter( false, NULL );
+  // return the number of messages queued
+  return queued;
+}
+
+// Receive up to count messages, splitting coalesced datagrams ----------------
+int UdpUring::recvMsgs( char* msgs[], int length, int lengths[], int count,
+			bool wait, struct sockaddr addrs[] ) {
+  int received = 0;
+  while ( received < count ) {
+    if ( readyCount == 0 ) {
+      reap( );
+      if ( readyCount == 0 ) {
+	// only wait if there is nothing at all to return
+	if ( !wait || received > 0 || this->wait( -1 ) <= 0 )
+	  break;
+	continue;
+      }
+    }
+
+    Received &r = ready[readyHead];
+    int size = r.length - readyOffset;
+    if ( size > r.segSize )
+      size = r.segSize;
+    lengths[received] = ( size < length ) ? size : length;
+    memcpy( msgs[received], bufs + r.bid * bufSize + r.offset + readyOffset,
+	    lengths[received] );
+    addrs[received++] = r.addr;
+    if ( ( readyOffset += size ) >= r.length ) {
+      // all handed out: the buffer goes back to the kernel
+      giveBuffer( r.bid );
+      readyHead = ( readyHead + 1 ) % URINGBUFS;
+      readyCount--;
+      readyOffset = 0;
+    }
+  }
+  if ( !armed )
+    arm( );
+  // return the number of messages received
+  return received;
+}
+
+// Wait up to usec for data, submitting whatever is queued --------------------
+int UdpUring::wait( long usec ) {
+  struct timespec deadline;
+  clock_gettime( CLOCK_MONOTONIC, &deadline );
+  deadline.tv_sec += usec / 1000000;
+  deadline.tv_nsec += ( usec % 1000000 ) * 1000;
+  if ( deadline.tv_nsec >= 1000000000 ) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  while ( true ) {
+    reap( );
+    if ( !armed )
+      arm( );
+    // data that is already here needs no system call
+    if ( readyCount > 0 )
+      return 1;
+
+    struct timespec left;
+    if ( usec >= 0 ) {
+      struct timespec now;
+      clock_gettime( CLOCK_MONOTONIC, &now );
+      left.tv_sec = deadline.tv_sec - now.tv_sec;
+      left.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+      if ( left.tv_nsec < 0 ) {
+	left.tv_sec--;
+	left.tv_nsec += 1000000000;
+      }
+      if ( left.tv_sec < 0 ) {
+	enter( false, NULL );
+	reap( );
+	return readyCount > 0 ? 1 : 0;
+      }
+    }
+    if ( enter( true, usec >= 0 ? &left : NULL ) < 0 )
+      return 0;
+  }
+}
+
+#else
+// no io_uring off Linux: the ring never opens and the socket keeps using
+// its system calls
+UdpUring::UdpUring( int sd, bool gso, bool gro )
+  : fd( -1 ), slotData( NULL ), bufs( NULL ) { }
+UdpUring::~UdpUring( ) { }
+bool UdpUring::isOpen( ) { return false; }
+bool UdpUring::gsoFailed( ) { return false; }
+int UdpUring::recvMsgs( char* msgs[], int length, int lengths[], int count,
+			bool wait, struct sockaddr addrs[] ) { return 0; }
+int UdpUring::wait( long usec ) { return 0; }
+#endif
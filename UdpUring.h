@@ -0,0 +1,89 @@
+// Project:      CSS432 UDP Socket Class
+// Professor:    Munehiro Fukuda
+// Organization: CSS, University of Washington, Bothell
+// Date:         March 5, 2004
+
+#ifndef _UDPURING_H_
+#define _UDPURING_H_
+
+#include "UdpSocket.h"
+
+#define URINGENTRIES 128  // submission queue entries
+#define URINGSLOTS 64     // max # sends in flight, each in a slot of its own
+#define URINGBUFS 64      // receive buffers lent to the kernel, a power of 2
+
+// io_uring backend of a UdpSocket. Sends are copied into slots owned by the
+// ring, and a whole batch goes to the kernel with one io_uring_enter( )
+// that does not wait for them to complete. One multishot recvmsg( ) keeps
+// receiving into buffers registered with the kernel, so messages that are
+// already there are read off the completion queue without a system call.
+class UdpUring {
+ public:
+  UdpUring( int, bool, bool );   // a ring for socket int; bools: size the
+                                 // slots for GSO and the buffers for GRO
+  ~UdpUring( );                  // sends everything still queued first
+  bool isOpen( );                // false: this kernel has no usable io_uring
+#ifdef __linux__
+  int sendMsgs( struct mmsghdr[], int ); // queue int messages, copying each
+                                 // out of mmsghdr[]; return the # queued.
+                                 // only Linux has mmsghdr, and a ring
+#endif
+  int recvMsgs( char*[], int, int[], int, bool, struct sockaddr[] ); // same
+                                 // as UdpSocket::recvBatch( )
+  int wait( long );              // wait up to long usec (<0: forever) for
+                                 // data; return 1 if there is some, else 0
+  bool gsoFailed( );             // did a segmented send fail with EIO/EINVAL
+ private:
+  struct Slot {                  // one send in flight
+    struct msghdr hdr;
+    struct iovec iov;
+    struct sockaddr addr;
+    char ctrl[64];               // room for a UDP_SEGMENT control message
+    char* data;
+  };
+  struct Received {              // one receive buffer the kernel filled
+    int bid;                     // its buffer id
+    int offset;                  // where its payload starts
+    int length;                  // payload bytes
+    int segSize;                 // size of each message in it (GRO)
+    struct sockaddr addr;        // who sent it
+  };
+  int fd;                        // io_uring descriptor, -1 if none
+  bool gro;
+  bool gsoBroken;
+  // submission queue
+  unsigned int *sqHead, *sqTail, *sqMask, *sqArray;
+  struct io_uring_sqe* sqes;
+  unsigned int sqEntries;
+  // completion queue
+  unsigned int *cqHead, *cqTail, *cqMask;
+  struct io_uring_cqe* cqes;
+  void* sqMap;
+  void* cqMap;
+  size_t sqMapSize, cqMapSize, sqesSize;
+  // sends
+  Slot slots[URINGSLOTS];
+  char* slotData;
+  int slotSize;                  // max bytes of one send
+  int freeSlots[URINGSLOTS];     // stack of unused slots
+  int nFree;
+  // receives
+  int sd;
+  bool armed;                    // multishot recvmsg( ) is in flight
+  struct msghdr recvHdr;         // tells the kernel the name/control sizes
+  struct io_uring_buf_ring* bufRing;
+  unsigned short bufTail;
+  char* bufs;
+  int bufSize;
+  Received ready[URINGBUFS];     // filled buffers not handed out yet
+  int readyHead, readyCount;
+  int readyOffset;               // bytes of ready[readyHead] handed out
+
+  struct io_uring_sqe* getSqe( );
+  int enter( bool, struct timespec* ); // submit; bool: wait for a completion
+  void reap( );                  // take in all completions
+  void arm( );                   // queue the multishot recvmsg( )
+  void giveBuffer( int );        // lend buffer int to the kernel again
+};
+
+#endif
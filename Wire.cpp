@@ -0,0 +1,157 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include "Wire.h"
+#include <string.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define WIRE_X86
+#endif
+
+// the reflected Castagnoli polynomial.
+const uint32_t CRC32C_POLY = 0x82f63b78u;
+
+// where the fields sit in a header.
+const int WIRE_WINDOW = 2;
+const int WIRE_CONNID = 4;
+const int WIRE_SEQ = 8;
+const int WIRE_ACKNUM = 12;
+const int WIRE_CRC = 16;
+
+/*==============================================================================
+        CRC32C
+*/
+
+static uint32_t crcTable[256];
+
+typedef uint32_t (*CrcKernel)(uint32_t, const unsigned char *, size_t);
+static CrcKernel crcUpdate = NULL;
+static const char *crcName = "table";
+
+static uint32_t crcTableUpdate(uint32_t crc, const unsigned char *p,
+        size_t length) {
+    while(length-- > 0)
+        crc = crcTable[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef WIRE_X86
+// eight bytes per crc32 instruction. the loads are unaligned, which costs
+//     nothing on anything with sse4.2.
+__attribute__((target("sse4.2")))
+static uint32_t crcSse42Update(uint32_t crc, const unsigned char *p,
+        size_t length) {
+    uint64_t c = crc;
+    for(; length >= 8; p += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        c = _mm_crc32_u64(c, word);
+    }
+    uint32_t c32 = (uint32_t) c;
+    for(; length > 0; p++, length--)
+        c32 = _mm_crc32_u8(c32, *p);
+    return c32;
+}
+#endif
+
+static void crcInit() {
+    if(crcUpdate != NULL)
+        return;
+    for(uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for(int b = 0; b < 8; b++)
+            c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        crcTable[i] = c;
+    }
+    crcUpdate = crcTableUpdate;
+    crcName = "table";
+#ifdef WIRE_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2")) {
+        crcUpdate = crcSse42Update;
+        crcName = "sse4.2";
+    }
+#endif
+}
+
+unsigned int crc32c(unsigned int crc, const void *data, size_t length) {
+    crcInit();
+    return ~crcUpdate(~crc, (const unsigned char*) data, length);
+}
+
+const char *crc32cKernel() {
+    crcInit();
+    return crcName;
+}
+
+/*==============================================================================
+        Header
+*/
+
+static void put32(char *p, uint32_t value) {
+    value = htonl(value);
+    memcpy(p, &value, 4);
+}
+
+static uint32_t get32(const char *p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return ntohl(value);
+}
+
+unsigned int wirePayloadCrc(const char *datagram, int length) {
+    return crc32c(0, datagram + WIRE_HDR, length - WIRE_HDR);
+}
+
+void wireWrite(char *datagram, int length, const WireHeader &header) {
+    wireWrite(datagram, header, wirePayloadCrc(datagram, length));
+}
+
+void wireWrite(char *datagram, const WireHeader &header,
+        unsigned int payloadCrc) {
+    int window = header.window < 0 ? 0
+            : header.window > 0xffff ? 0xffff : header.window;
+    datagram[0] = WIRE_VERSION;
+    datagram[1] = header.flags;
+    uint16_t window16 = htons(window);
+    memcpy(datagram + WIRE_WINDOW, &window16, 2);
+    put32(datagram + WIRE_CONNID, header.connId);
+    put32(datagram + WIRE_SEQ, header.seq);
+    put32(datagram + WIRE_ACKNUM, header.ack);
+    put32(datagram + WIRE_CRC, crc32c(payloadCrc, datagram, WIRE_CRC));
+}
+
+bool wireRead(const char *datagram, int length, WireHeader &header) {
+    return wireRead(datagram, datagram + WIRE_HDR, length, header);
+}
+
+bool wireRead(const char *datagram, const char *payload, int length,
+        WireHeader &header) {
+    if(length < WIRE_HDR || datagram[0] != WIRE_VERSION)
+        return false;
+    unsigned int crc = crc32c(crc32c(0, payload, length - WIRE_HDR), datagram,
+            WIRE_CRC);
+    if(crc != get32(datagram + WIRE_CRC))
+        return false;
+    uint16_t window16;
+    memcpy(&window16, datagram + WIRE_WINDOW, 2);
+    header.flags = (unsigned char) datagram[1];
+    header.window = ntohs(window16);
+    header.connId = get32(datagram + WIRE_CONNID);
+    header.seq = get32(datagram + WIRE_SEQ);
+    header.ack = get32(datagram + WIRE_ACKNUM);
+    return true;
+}
+
+unsigned int wireSeq(const char *datagram) {
+    return get32(datagram + WIRE_SEQ);
+}
+
+unsigned int wireConnId(const char *datagram) {
+    return get32(datagram + WIRE_CONNID);
+}
@@ -0,0 +1,68 @@
+/* 
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#ifndef _WIRE_H_
+#define _WIRE_H_
+
+#include <stddef.h>
+
+#define WIRE_VERSION 1
+#define WIRE_HDR 20      // header bytes at the front of every datagram
+
+// what a datagram carries.
+#define WIRE_DATA 0x01   // a data segment, seq is its sequence #
+#define WIRE_ACK  0x02   // ack is the next seq # wanted
+#define WIRE_SACK 0x04   // a sack bitmap follows the header
+#define WIRE_PROBE 0x08  // a path mtu probe of seq bytes, or with WIRE_ACK
+                         //     the reply to the one of ack bytes
+
+// the header of every data segment and ack, as the host sees it. on the
+// wire it is packed, big-endian and ends in a CRC32C that covers the payload
+// and then the rest of the header:
+//     0 version  1 flags  2-3 window  4-7 connId  8-11 seq  12-15 ack
+//     16-19 crc32c
+struct WireHeader {
+    WireHeader(unsigned int flags = 0, unsigned int seq = 0,
+            unsigned int ack = 0, int window = 0, unsigned int connId = 0)
+        : flags(flags), window(window), connId(connId), seq(seq), ack(ack) {}
+
+    unsigned int flags;
+    int window;              // segments the sender may send (data) or the
+                             //     receiver takes past ack (acks), <= 65535
+    unsigned int connId;     // tells transfers from one peer apart
+    unsigned int seq;
+    unsigned int ack;
+};
+
+// CRC32C (Castagnoli) of length bytes at data, extending crc, the CRC of
+//     whatever came before them (0 for nothing). runs on the SSE4.2 crc32
+//     instruction where the cpu has it.
+unsigned int crc32c(unsigned int crc, const void *data, size_t length);
+const char *crc32cKernel();    // "sse4.2" or "table"
+
+// the CRC of the payload of a datagram of length bytes. a sender that sends
+//     the same payload under many headers computes it once.
+unsigned int wirePayloadCrc(const char *datagram, int length);
+
+// write header into the first WIRE_HDR bytes of a datagram of length bytes
+//     and seal it.
+void wireWrite(char *datagram, int length, const WireHeader &header);
+// same, for a datagram whose payload's wirePayloadCrc() is payloadCrc,
+//     wherever the payload is.
+void wireWrite(char *head, const WireHeader &header, unsigned int payloadCrc);
+
+// read the header of a datagram of length bytes. false if it is too short,
+//     of another version, or its CRC does not match: drop it.
+bool wireRead(const char *datagram, int length, WireHeader &header);
+// same, for one received with its payload apart from its header.
+bool wireRead(const char *head, const char *payload, int length,
+        WireHeader &header);
+
+// the sequence # and connection id of a datagram, unchecked.
+unsigned int wireSeq(const char *datagram);
+unsigned int wireConnId(const char *datagram);
+
+#endif
@@ -0,0 +1,541 @@
+/*
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include "UdpSocket.h"
+#include "Timer.h"
+#include "RttEstimator.h"
+#include "CongestionControl.h"
+#include "SlidingWindow.h"
+#include "LatencyHistogram.h"
+#include "ProtocolStats.h"
+#include "TraceRing.h"
+#include "Pmtu.h"
+#include "MappedFile.h"
+#include <sys/wait.h>
+#include <getopt.h>
+
+using namespace std;
+
+#define PORT 64252       // the server's UDP port, the client takes the next
+#define MAX 20000        // default times of message transfer per run
+#define MAXWIN 30        // default largest window
+#define MAXDROP 10       // default largest drop percent
+#define REPS 5           // default runs per window and drop percent
+#define MAXREPS 1000     // most runs per window and drop percent
+#define MINRTO 100       // lower bound on the retransmission timeout in usec
+#define MAXRTO 1000000   // upper bound on the retransmission timeout in usec
+#define INITRTO 1500     // retransmission timeout before the first rtt sample
+#define ISN 4294963200u  // first sequence #, 4096 short of wrapping around
+#define LINGER 20000     // server acks resends until this long quiet, usec
+#define MAXSIZES 16      // most segment sizes swept
+#define PMTU 0           // in place of a segment size: the probed path mtu
+
+// what the client runs, in the terms of hw3a's tests.
+enum Mode { GOBACKN, SACK, NEWRENO, CUBIC };
+const char *MODES[] = { "gbn", "sack", "newreno", "cubic" };
+const int NMODES = sizeof(MODES) / sizeof(MODES[0]);
+
+struct BenchOptions {
+    Mode mode;
+    int minWin, maxWin;
+    int minDrop, maxDrop;
+    int max;                   // segments per run
+    int sizes[MAXSIZES];       // segment sizes, header included, or PMTU
+    int nSizes;
+    int reps;
+    const char *out;           // writes out.dat, out.csv, out.json and
+                               //     out-server.json
+    const char *trace;         // packet traces go to trace-<pid>.trace on
+                               //     exit and SIGUSR2, NULL: only SIGUSR2
+    const char *file;          // send this file instead of max segments,
+                               //     the server writes it to out.recv
+    bool zerocopy;             // the client sends the file with MSG_ZEROCOPY
+    bool buffered;             // the server reads the file out of its receive
+                               //     buffer, instead of receiving in place
+    bool uring;                // both ends send and receive through io_uring
+};
+
+// one window and drop percent, summed up over its runs.
+struct Row {
+    int segSize;
+    int windowSize;
+    int dropPercent;
+    double mean, stddev;       // elapsed usec
+    long p50, p99;
+    double mbps, pps;          // throughput of the mean run
+    double goodput;            // payload bytes/sec of the mean run
+    double retransmits;        // mean
+    double rttP50, rttP99, rttP999; // usec, over every rtt sample of every run
+    const char *backend;       // "sockets" or "io_uring", the client's
+};
+
+int clientSlidingWindow(UdpSocket &sock, const int max, int message[],
+        int windowSize, const SenderOptions &opts, RttEstimator &rtt,
+        CongestionControl &cc);
+void serverEarlyRetrans(UdpSocket &sock, const int max, int message[],
+        int windowSize, int dropPercent, const ReceiverOptions &opts);
+
+void usage(const char *name) {
+    cerr << "usage: " << name << " [-m gbn|sack|newreno|cubic] [-w min[:max]]"
+         << " [-l min[:max]] [-s bytes|pmtu[,...]] [-n messages]"
+         << " [-r repetitions] [-o prefix] [-t trace] [-u]"
+         << " [-f file [-z] [-b]]"
+         << endl;
+}
+
+// parse "min" or "min:max" into a range.
+bool range(const char *arg, int &min, int &max) {
+    char *end;
+    min = max = strtol(arg, &end, 10);
+    if(*end == ':')
+        max = strtol(end + 1, &end, 10);
+    return *end == '\0' && min >= 0 && min <= max;
+}
+
+// parse "size,size,..." into segment sizes, "pmtu" for the probed one.
+bool sizes(char *arg, BenchOptions &bench) {
+    bench.nSizes = 0;
+    for(char *s = strtok(arg, ","); s != NULL; s = strtok(NULL, ",")) {
+        if(bench.nSizes == MAXSIZES) return false;
+        int size = PMTU;
+        if(strcmp(s, "pmtu") != 0) {
+            char *end;
+            size = strtol(s, &end, 10);
+            if(*end != '\0' || size < 2 * WIRE_HDR || size > MAXMSGSIZE)
+                return false;
+        }
+        bench.sizes[bench.nSizes++] = size;
+    }
+    return bench.nSizes > 0;
+}
+
+bool parse(int argc, char *argv[], BenchOptions &bench) {
+    bench.mode = GOBACKN;
+    bench.minWin = 1;
+    bench.maxWin = MAXWIN;
+    bench.minDrop = 0;
+    bench.maxDrop = MAXDROP;
+    bench.max = MAX;
+    bench.sizes[0] = MSGSIZE;
+    bench.nSizes = 1;
+    bench.reps = REPS;
+    bench.out = "bench";
+    bench.trace = NULL;
+    bench.file = NULL;
+    bench.zerocopy = false;
+    bench.buffered = false;
+    bench.uring = false;
+
+    int c;
+    while((c = getopt(argc, argv, "m:w:l:s:n:r:o:t:f:zbu")) != -1) {
+        switch(c) {
+        case 'm': {
+            int m = 0;
+            while(m < NMODES && strcmp(optarg, MODES[m]) != 0) m++;
+            if(m == NMODES) return false;
+            bench.mode = (Mode) m;
+            break;
+        }
+        case 'w':
+            if(!range(optarg, bench.minWin, bench.maxWin) || bench.minWin < 1)
+                return false;
+            break;
+        case 'l':
+            if(!range(optarg, bench.minDrop, bench.maxDrop)
+                    || bench.maxDrop > 100)
+                return false;
+            break;
+        case 's':
+            if(!sizes(optarg, bench)) return false;
+            break;
+        case 'n':
+            bench.max = atoi(optarg);
+            if(bench.max < 1) return false;
+            break;
+        case 'r':
+            bench.reps = atoi(optarg);
+            if(bench.reps < 1 || bench.reps > MAXREPS) return false;
+            break;
+        case 'o':
+            bench.out = optarg;
+            break;
+        case 't':
+            bench.trace = optarg;
+            break;
+        case 'f':
+            bench.file = optarg;
+            break;
+        case 'z':
+            bench.zerocopy = true;
+            break;
+        case 'b':
+            bench.buffered = true;
+            break;
+        case 'u':
+            bench.uring = true;
+            break;
+        default:
+            return false;
+        }
+    }
+    // the server needs the segment size to know how many segments a file
+    //     takes, and a probed one is only known to the client.
+    for(int s = 0; bench.file != NULL && s < bench.nSizes; s++)
+        if(bench.sizes[s] == PMTU) return false;
+    return optind == argc
+        && (bench.file != NULL || (!bench.zerocopy && !bench.buffered));
+}
+
+// one transfer of max segments of segSize bytes, of message or of the
+//     file in input, as connection connId. returns its elapsed usec, adds
+//     the segments' rtts to rtts and counts into stats. newreno and cubic
+//     size their own window, windowSize only caps it.
+long clientRun(UdpSocket &sock, int message[], MappedFile &input,
+        const BenchOptions &bench, unsigned int connId, int max, int segSize,
+        int windowSize, int &retransmits, LatencyHistogram &rtts,
+        ProtocolStats &stats) {
+    RttEstimator rtt(MINRTO, MAXRTO, INITRTO);
+    CongestionControl *cc;
+    if(bench.mode == NEWRENO)
+        cc = createCongestionControl("newreno", windowSize);
+    else if(bench.mode == CUBIC)
+        cc = createCongestionControl("cubic", windowSize);
+    else
+        cc = new FixedWindow(windowSize);
+    SenderOptions opts;
+    opts.isn = ISN;
+    opts.connId = connId;
+    opts.segSize = segSize;
+    opts.source = input.data();
+    opts.sourceLength = input.length();
+    opts.rtts = &rtts;
+    opts.stats = &stats;
+    if(bench.mode != GOBACKN) {
+        opts.sackOn = true;
+        opts.fastRetransmitOn = true;
+        opts.perSegmentTimersOn = bench.mode != SACK;
+    }
+    Timer timer;
+    timer.start();
+    retransmits = clientSlidingWindow(sock, max, message,
+            windowSize, opts, rtt, *cc);
+    long elapsed = timer.lap();
+    delete cc;
+    return elapsed;
+}
+
+// nearest rank percentile of sorted[n].
+long percentile(const long sorted[], int n, int percent) {
+    int rank = (percent * n + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// a run is segments of segSize bytes carrying payload bytes, less headers.
+Row summarize(const BenchOptions &bench, int segments, long payload,
+        int segSize, int windowSize, int dropPercent, long elapsed[],
+        const int retransmits[], LatencyHistogram &rtts) {
+    Row row;
+    row.segSize = segSize;
+    row.windowSize = windowSize;
+    row.dropPercent = dropPercent;
+    double sum = 0, squares = 0, resent = 0;
+    for(int i = 0; i < bench.reps; i++) {
+        sum += elapsed[i];
+        squares += (double) elapsed[i] * elapsed[i];
+        resent += retransmits[i];
+    }
+    int n = bench.reps;
+    row.mean = sum / n;
+    row.stddev = n > 1 ? sqrt(max(0.0, (squares - sum * sum / n) / (n - 1)))
+                       : 0;
+    sort(elapsed, elapsed + n);
+    row.p50 = percentile(elapsed, n, 50);
+    row.p99 = percentile(elapsed, n, 99);
+    row.pps = row.mean > 0 ? segments * 1000000.0 / row.mean : 0;
+    row.mbps = row.pps * segSize * 8 / 1000000;
+    row.goodput = row.mean > 0 ? payload * 1000000.0 / row.mean : 0;
+    row.retransmits = resent / n;
+    row.rttP50 = rtts.percentile(50) / 1000.0;
+    row.rttP99 = rtts.percentile(99) / 1000.0;
+    row.rttP999 = rtts.percentile(99.9) / 1000.0;
+    return row;
+}
+
+const char *COLUMNS[] = { "window", "drop", "mean_usec", "stddev_usec",
+    "p50_usec", "p99_usec", "mbps", "pps", "retransmits", "rtt_p50_usec",
+    "rtt_p99_usec", "rtt_p999_usec", "segsize", "goodput_bytes_per_sec",
+    "backend" };
+const int NCOLUMNS = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+
+// a row of COLUMNS: spaces between them for gnuplot, commas for the rest.
+void write(ostream &out, const Row &row, const char *sep) {
+    out << row.windowSize << sep << row.dropPercent << sep << row.mean << sep
+        << row.stddev << sep << row.p50 << sep << row.p99 << sep << row.mbps
+        << sep << row.pps << sep << row.retransmits << sep << row.rttP50
+        << sep << row.rttP99 << sep << row.rttP999 << sep << row.segSize
+        << sep << row.goodput << sep << row.backend << endl;
+}
+
+// a line of one run's stats on backend, as a json object.
+void record(ostream &out, const char *backend, int segSize, int windowSize,
+        int dropPercent, int run, long elapsed, ProtocolStats &stats) {
+    out << "{\"backend\": \"" << backend << "\", \"segSize\": " << segSize
+        << ", \"window\": " << windowSize << ", \"drop\": " << dropPercent
+        << ", \"run\": " << run;
+    if(elapsed >= 0)
+        out << ", \"elapsedUsec\": " << elapsed;
+    stats.json(out << ", \"stats\": ") << "}" << endl;
+}
+
+// where the reader of a buffered run puts the file.
+struct Output {
+    char *data;
+    long length;
+    long written;              // bytes read out of the receive buffer so far
+};
+
+// the reader of a buffered run: append span to the output, past its end
+//     only the last segment's padding comes, and that's dropped.
+long writeOut(const char *span, long length, void *arg) {
+    Output &out = *(Output *) arg;
+    long room = out.length - out.written;
+    if(room > 0) {
+        memcpy(out.data + out.written, span, length < room ? length : room);
+        out.written += length < room ? length : room;
+    }
+    return length;
+}
+
+// move sock onto io_uring if bench asks for it. each end does so after
+//     the fork, so that neither shares a ring with the other. returns the
+//     backend sock ends up on.
+const char *backend(UdpSocket &sock, const BenchOptions &bench) {
+    if(!bench.uring)
+        return "sockets";
+    if(sock.enableUring())
+        return "io_uring";
+    cerr << "io_uring is not supported, using sockets." << endl;
+    return "sockets";
+}
+
+// the server tells the client over the pipe fd that it takes run connId
+//     on, and again that it is done with it, lingering included.
+bool tellClient(int fd, unsigned int connId) {
+    return write(fd, &connId, sizeof(connId)) == sizeof(connId);
+}
+
+// the client waits on the pipe fd for the server's word about run connId.
+//     false if the server quit or is at another run.
+bool awaitServer(int fd, unsigned int connId) {
+    unsigned int said;
+    if(read(fd, &said, sizeof(said)) == sizeof(said) && said == connId)
+        return true;
+    cerr << "the server is not in step at run " << connId << endl;
+    return false;
+}
+
+// the server, in a child: the same runs in the same order as the client.
+//     the probed size is only known to the client, so those runs take
+//     anything up to MAXMSGSIZE and the first of them answers the probes.
+//     a file is received into out.recv, made anew for every run and
+//     checked against input, which the fork left mapped here too. each
+//     run starts and ends with a word to the client on toClient.
+void server(UdpSocket &sock, const BenchOptions &bench, MappedFile &input,
+        int toClient) {
+    const char *on = backend(sock, bench);
+    ofstream json((string(bench.out) + "-server.json").c_str());
+    int *message = new int[MSGSIZE / 4];
+    ProtocolStats stats;
+    ReceiverOptions opts;
+    opts.isn = ISN;
+    opts.lingerUsec = LINGER;
+    opts.stats = &stats;
+    string received = string(bench.out) + ".recv";
+    MappedFile output;
+    Output buffered;
+    unsigned int connId = 0; // the same ones the client's runs count up
+    for(int s = 0; s < bench.nSizes; s++) {
+        int segSize = bench.sizes[s];
+        opts.segSize = segSize == PMTU ? MAXMSGSIZE : segSize;
+        int max = bench.file != NULL
+                ? segmentsFor(input.length(), segSize) : bench.max;
+        for(int w = bench.minWin; w <= bench.maxWin; w++) {
+            for(int d = bench.minDrop; d <= bench.maxDrop; d++) {
+                for(int r = 0; r < bench.reps; r++) {
+                    stats.reset();
+                    opts.connId = ++connId;
+                    opts.dropSeed = r; // each repetition loses its own
+                    if(bench.file != NULL) {
+                        if(!output.create(received.c_str(), input.length()))
+                            return;
+                        buffered.data = output.data();
+                        buffered.length = output.length();
+                        buffered.written = 0;
+                        if(bench.buffered) {
+                            opts.reader = writeOut;
+                            opts.readerArg = &buffered;
+                        } else {
+                            opts.sink = output.data();
+                            opts.sinkLength = output.length();
+                        }
+                    }
+                    if(!tellClient(toClient, connId))
+                        return;
+                    serverEarlyRetrans(sock, max, message, w, d, opts);
+                    if(!tellClient(toClient, connId))
+                        return;
+                    record(json, on, segSize, w, d, r, -1, stats);
+                    if(bench.file != NULL && memcmp(output.data(),
+                            input.data(), input.length()) != 0)
+                        cerr << received << " differs from " << bench.file
+                             << endl;
+                }
+            }
+        }
+    }
+    delete[] message;
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions bench;
+    if(!parse(argc, argv, bench)) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    // both sockets are bound before the fork, so the client's first
+    //     segments never find the server's port closed.
+    UdpSocket serverSock(PORT);
+    UdpSocket clientSock(PORT + 1);
+    serverSock.enableGso();
+    serverSock.enableGro();
+    clientSock.enableGso();
+    clientSock.enableGro();
+    // DF and sizes past the kernel's guess only for runs that probe.
+    for(int s = 0; s < bench.nSizes; s++)
+        if(bench.sizes[s] == PMTU) {
+            clientSock.probeMtu();
+            break;
+        }
+    if(bench.zerocopy && !clientSock.enableZerocopy())
+        cerr << "MSG_ZEROCOPY is not supported, sending with copies." << endl;
+
+    // mapped before the fork, so the server can check what it received.
+    MappedFile input;
+    if(bench.file != NULL
+            && (!input.openRead(bench.file) || input.length() == 0)) {
+        cerr << "cannot send " << bench.file << endl;
+        return -1;
+    }
+    if(clientSock.setDestAddress((char *) "localhost", PORT) == false) {
+        cerr << "cannot find the destination IP name: localhost" << endl;
+        return -1;
+    }
+
+    string prefix = bench.out;
+    ofstream dat((prefix + ".dat").c_str());
+    ofstream csv((prefix + ".csv").c_str());
+    ofstream json((prefix + ".json").c_str());
+    if(!dat || !csv || !json) {
+        cerr << "cannot write " << prefix << ".dat/.csv/.json" << endl;
+        return -1;
+    }
+    // kill -USR1 prints the stats of the transfer under way, on both ends,
+    //     and kill -USR2 writes both ends' packet traces.
+    ProtocolStats::dumpOnSignal();
+    TraceRing::dumpOnSignal(SIGUSR2, bench.trace != NULL ? bench.trace : "bench");
+    if(bench.trace != NULL)
+        TraceRing::dumpAtExit(bench.trace);
+
+    // the server tells the client when each run starts and ends, so runs
+    //     never overlap and none waits longer than it has to.
+    int fromServer[2];
+    if(pipe(fromServer) < 0) {
+        perror("pipe");
+        return -1;
+    }
+    pid_t child = fork();
+    if(child < 0) {
+        perror("fork");
+        return -1;
+    }
+    if(child == 0) {
+        close(fromServer[0]);
+        server(serverSock, bench, input, fromServer[1]);
+        exit(0);
+    }
+    close(fromServer[1]);
+    const char *on = backend(clientSock, bench);
+
+    dat << "# " << MODES[bench.mode] << " on " << on << ", ";
+    if(bench.file != NULL)
+        dat << bench.file << " (" << input.length() << " bytes), ";
+    else
+        dat << bench.max << " segments, ";
+    dat << bench.reps << " runs each" << endl << "#";
+    for(int c = 0; c < NCOLUMNS; c++) {
+        dat << " " << COLUMNS[c];
+        csv << (c > 0 ? "," : "") << COLUMNS[c];
+    }
+    dat << endl;
+    csv << endl;
+
+    int *message = new int[(MAXMSGSIZE + 3) / 4];
+    memset(message, 0, MAXMSGSIZE);
+    long elapsed[MAXREPS];
+    int retransmits[MAXREPS];
+    LatencyHistogram rtts;
+    ProtocolStats stats;
+    unsigned int connId = 0; // each run is a connection of its own
+    bool inStep = true;
+    for(int s = 0; s < bench.nSizes && inStep; s++) {
+        int segSize = bench.sizes[s];
+        if(segSize == PMTU) {
+            segSize = probePathMtu(clientSock, 0, MSGSIZE, MAXMSGSIZE);
+            cerr << "path mtu probe: " << segSize << " bytes" << endl;
+        }
+        int max = bench.file != NULL
+                ? segmentsFor(input.length(), segSize) : bench.max;
+        long payload = bench.file != NULL ? input.length()
+                : (long) max * (segSize - WIRE_HDR);
+        for(int w = bench.minWin; w <= bench.maxWin && inStep; w++) {
+            for(int d = bench.minDrop; d <= bench.maxDrop && inStep; d++) {
+                rtts.reset();
+                for(int r = 0; r < bench.reps && inStep; r++) {
+                    stats.reset();
+                    inStep = awaitServer(fromServer[0], ++connId);
+                    if(!inStep)
+                        break;
+                    elapsed[r] = clientRun(clientSock, message, input, bench,
+                            connId, max, segSize, w, retransmits[r], rtts,
+                            stats);
+                    record(json, on, segSize, w, d, r, elapsed[r], stats);
+                    // the server stops lingering before the next run.
+                    inStep = awaitServer(fromServer[0], connId);
+                }
+                if(!inStep)
+                    break;
+                Row row = summarize(bench, max, payload, segSize, w, d,
+                        elapsed, retransmits, rtts);
+                row.backend = on;
+                write(dat, row, " ");
+                write(csv, row, ",");
+                write(cout, row, " ");
+            }
+        }
+    }
+    delete[] message;
+    close(fromServer[0]);
+
+    int status;
+    waitpid(child, &status, 0);
+    cerr << "finished" << endl;
+    return inStep ? 0 : -1;
+}
@@ -1,9 +1,13 @@
+# window.dat comes from: bench -w 1:30 -l 0 -o window (make plots)
 set terminal postscript landscape
-set key on left
+set key on right
 set nolabel
 set xlabel "window"
 set xrange [0:30]
 set ylabel "usec"
-set yrange [0:38000000]
+set yrange [0:*]
+set y2label "Mbit/s"
+set y2range [0:*]
+set y2tics
 set output "udp.ps"
-plot "100mbps_sw.dat" title "100mbps sliding window" with linespoints, "1gbps_sw.dat" title "1gbps sliding window" with linespoints, 30860033 title "100mbs stopNwait" with line, 4813490 title "1gbps stopNwait" with line
+plot "window.dat" using 1:3:4 title "sliding window, mean +- stddev" with yerrorlines, "window.dat" using 1:6 title "sliding window, p99" with linespoints, "window.dat" using 1:7 axes x1y2 title "throughput" with linespoints
@@ -1,9 +1,10 @@
+# loss-1.dat and loss-30.dat come from: bench -w 1 -l 0:10 -o loss-1 and
+# bench -w 30 -l 0:10 -o loss-30 (make plots)
 set terminal postscript landscape
 set nolabel
 set xlabel "Loss Rate (%)"
 set xrange [0:10]
 set ylabel "usec"
-set yrange [0:25000000]
+set yrange [0:*]
 set output "udpa.ps"
-plot "100mbpsa-1.dat" title "100mbps Stop-n-Wait" with linespoints, "100mbpsa-30.dat" title "100mbps Window=30" with linespoints, "1gbpsa-1.dat" title "1gbps Stop-n-Wait" with linespoints, "1gbpsa-30.dat" title "1gbps Window=30" with linespoints
-
+plot "loss-1.dat" using 2:3:4 title "Stop-n-Wait, mean +- stddev" with yerrorlines, "loss-30.dat" using 2:3:4 title "Window=30, mean +- stddev" with yerrorlines, "loss-1.dat" using 2:6 title "Stop-n-Wait, p99" with linespoints, "loss-30.dat" using 2:6 title "Window=30, p99" with linespoints
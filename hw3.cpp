@@ -1,6 +1,13 @@
 #include <iostream>
 #include "UdpSocket.h"
 #include "Timer.h"
+#include "RttEstimator.h"
+#include "CongestionControl.h"
+#include "SlidingWindow.h"
+#include "TraceRing.h"
+#include "Wire.h"
+#include "SimNetwork.h"
+#include "Impairment.h"
 
 using namespace std;
 
@@ -8,22 +15,32 @@ using namespace std;
 #define MAX 20000        // times of message transfer
 #define MAXWIN 30        // the maximum window size
 #define LOOP 10          // loop in test 4 and 5
+#define MINRTO 100       // lower bound on the retransmission timeout in usec
+#define MAXRTO 1000000   // upper bound on the retransmission timeout in usec
+#define INITRTO 1500     // retransmission timeout before the first rtt sample
+#define SPINUSEC 0       // busy poll budget per wait before blocking, -1 spins
+#define ISN 4294963200u  // first sequence #, 4096 short of wrapping around
+#define OFFLOAD true     // use UDP GSO/GRO where the kernel supports them
+#define TRACE "hw3"      // kill -USR2 writes the packet trace to hw3-<pid>.trace
+#define SIMDELAY 250     // one way delay of test 4's simulated link in usec
+#define SIMRATE 12500000 // its bandwidth in bytes/sec (100 Mbps)
 
 // client packet sending functions
 void clientUnreliable( UdpSocket &sock, const int max, int message[] );
-int clientStopWait( UdpSocket &sock, const int max, int message[] );
+int clientStopWait( UdpSocket &sock, const int max, int message[],
+		    const SenderOptions &opts, RttEstimator &rtt );
 int clientSlidingWindow( UdpSocket &sock, const int max, int message[], 
-			  int windowSize );
-//int clientSlowAIMD( UdpSocket &sock, const int max, int message[],
-//		     int windowSize, bool rttOn );
+			  int windowSize, const SenderOptions &opts, RttEstimator &rtt,
+			  CongestionControl &cc );
 
 // server packet receiving fucntions
 void serverUnreliable( UdpSocket &sock, const int max, int message[] );
 void serverReliable( UdpSocket &sock, const int max, int message[] );
 void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
-			 int windowSize );
-//void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
-//			 int windowSize, bool congestion );
+			 int windowSize, const ReceiverOptions &opts );
+
+// both ends of test 3 in this process, on a simulated link
+void simulatedWindows( );
 
 enum myPartType { CLIENT, SERVER, ERROR } myPart;
 
@@ -31,8 +48,13 @@ int main( int argc, char *argv[] ) {
 
   int message[MSGSIZE/4]; // prepare a 1460-byte message: 1460/4 = 365 ints;
   UdpSocket sock( PORT );  // define a UDP socket
+  if ( OFFLOAD ) {         // fall back to a datagram per message without
+    sock.enableGso( );
+    sock.enableGro( );
+  }
 
   myPart = ( argc == 1 ) ? SERVER : CLIENT;
+  TraceRing::dumpOnSignal( SIGUSR2, TRACE );
 
   if ( argc != 1 && argc != 2 ) {
     cerr << "usage: " << argv[0] << " [serverIpName]" << endl;
@@ -50,9 +72,16 @@ int main( int argc, char *argv[] ) {
   cerr << "   1: unreliable test" << endl;
   cerr << "   2: stop-and-wait test" << endl;
   cerr << "   3: sliding windows" << endl;
+  cerr << "   4: sliding windows, simulated (no peer needed)" << endl;
   cerr << "--> ";
   cin >> testNumber;
 
+  if ( testNumber == 4 ) { // the same on either end, and nothing to ack
+    simulatedWindows( );
+    cerr << "finished" << endl;
+    return 0;
+  }
+
   if ( myPart == CLIENT ) {
 
     Timer timer;           // define a timer
@@ -65,23 +94,34 @@ int main( int argc, char *argv[] ) {
       cerr << "Elasped time = ";                               // lap timer
       cout << timer.lap( ) << endl;
       break;
-    case 2:
+    case 2: {
+      RttEstimator rtt( MINRTO, MAXRTO, INITRTO );             // per transfer
+      SenderOptions opts;
+      opts.spinUsec = SPINUSEC;
       timer.start( );                                          // start timer
-      retransmits = clientStopWait( sock, MAX, message );      // actual test
+      retransmits = clientStopWait( sock, MAX, message, opts, rtt ); // test
       cerr << "Elasped time = ";                               // lap timer
       cout << timer.lap( ) << endl;
       cerr << "retransmits = " << retransmits << endl;
+      cerr << "srtt = " << rtt.srtt( ) << " rto = " << rtt.rto( ) << endl;
       break;
+    }
     case 3:
       for ( int windowSize = 1; windowSize <= MAXWIN; windowSize++ ) {
+	RttEstimator rtt( MINRTO, MAXRTO, INITRTO );           // per transfer
+	FixedWindow cc( windowSize );                          // no cwnd
+	SenderOptions opts;                                    // go-back-n
+	opts.spinUsec = SPINUSEC;
+	opts.isn = ISN;
 	timer.start( );                                        // start timer
 	retransmits =
-	clientSlidingWindow( sock, MAX, message, windowSize ); // actual test
+	clientSlidingWindow( sock, MAX, message, windowSize, opts, rtt, cc );
 	cerr << "Window size = ";                              // lap timer
 	cout << windowSize << " ";
 	cerr << "Elasped time = "; 
 	cout << timer.lap( ) << endl;
 	cerr << "retransmits = " << retransmits << endl;
+	cerr << "srtt = " << rtt.srtt( ) << " rto = " << rtt.rto( ) << endl;
       }
       break;
     default:
@@ -90,6 +130,8 @@ int main( int argc, char *argv[] ) {
     }
   }
   if ( myPart == SERVER ) {
+    ReceiverOptions opts;  // acks every segment
+    opts.isn = ISN;
     switch( testNumber ) {
     case 1:
       serverUnreliable( sock, MAX, message );
@@ -99,7 +141,7 @@ int main( int argc, char *argv[] ) {
       break;
     case 3:
       for ( int windowSize = 1; windowSize <= MAXWIN; windowSize++ )
-	serverEarlyRetrans( sock, MAX, message, windowSize );
+	serverEarlyRetrans( sock, MAX, message, windowSize, opts );
       break;
     default:
       cerr << "no such test case" << endl;
@@ -111,8 +153,9 @@ int main( int argc, char *argv[] ) {
     cerr << "server ending..." << endl;
     for ( int i = 0; i < 10; i++ ) {
       sleep( 1 );
-      int ack = MAX - 1;
-      sock.ackTo( (char *)&ack, sizeof( ack ) );
+      char ack[WIRE_HDR];
+      wireWrite( ack, WIRE_HDR, WireHeader( WIRE_ACK, 0, MAX - 1 ) );
+      sock.ackTo( ack, WIRE_HDR );
     }
   }
 
@@ -127,9 +170,9 @@ void clientUnreliable( UdpSocket &sock, const int max, int message[] ) {
 
   // transfer message[] max times
   for ( int i = 0; i < max; i++ ) {
-    message[0] = i;                            // message[0] has a sequence #
+    wireWrite( ( char * )message, MSGSIZE, WireHeader( WIRE_DATA, i ) );
     sock.sendTo( ( char * )message, MSGSIZE ); // udp message send
-    cerr << "message = " << message[0] << endl;
+    TraceRing::process( ).record( TRACE_SEND, i, 0, 0, 0 );
   }
 }
 
@@ -139,7 +182,86 @@ void serverUnreliable( UdpSocket &sock, const int max, int message[] ) {
 
   // receive message[] max times
   for ( int i = 0; i < max; i++ ) {
-    sock.recvFrom( ( char * ) message, MSGSIZE );   // udp message receive
-    cerr << message[0] << endl;                     // print out message
+    // udp message receive, corrupt ones aren't traced
+    int length = sock.recvFrom( ( char * ) message, MSGSIZE );
+    WireHeader header;
+    if ( wireRead( ( char * )message, length, header ) )
+      TraceRing::process( ).record( TRACE_RECV, header.seq, 0, 0, 0 );
+  }
+}
+
+// Test 4: test 3's client and server on a simulated link --------------------
+struct SimWindow {
+  UdpSocket *client;
+  UdpSocket *server;
+  int windowSize;
+  int retransmits;
+  long elapsed;                  // virtual usec
+  long srtt, rto;
+};
+
+void simClient( void *arg ) {
+  SimWindow &run = *( SimWindow * )arg;
+  int message[MSGSIZE/4];
+  memset( message, 0, sizeof( message ) );
+  RttEstimator rtt( MINRTO, MAXRTO, INITRTO );
+  FixedWindow cc( run.windowSize );
+  SenderOptions opts;            // go-back-n, as in test 3
+  opts.spinUsec = SPINUSEC;
+  opts.isn = ISN;
+  Timer timer;
+  timer.start( );
+  run.retransmits = clientSlidingWindow( *run.client, MAX, message,
+					 run.windowSize, opts, rtt, cc );
+  run.elapsed = timer.lap( );
+  run.srtt = rtt.srtt( );
+  run.rto = rtt.rto( );
+}
+
+void simServer( void *arg ) {
+  SimWindow &run = *( SimWindow * )arg;
+  int message[MSGSIZE/4];
+  ReceiverOptions opts;
+  opts.isn = ISN;
+  serverEarlyRetrans( *run.server, MAX, message, run.windowSize, opts );
+}
+
+// every window size of test 3, each on a fresh network whose links are
+// SIMRATE and SIMDELAY each way. the clock is virtual, so elapsed times
+// are what the link would give and a run replays exactly
+void simulatedWindows( ) {
+  cerr << "simulated sliding windows test:" << endl;
+  Timer wall;
+  wall.start( );
+  for ( int windowSize = 1; windowSize <= MAXWIN; windowSize++ ) {
+    SimNetwork net;
+    UdpSocket client( net, PORT + 1 );
+    UdpSocket server( net, PORT );
+    client.setDestAddress( ( char * )"localhost", PORT );
+    Impairment data( 0 ), acks( 0 );
+    data.delay( SIMDELAY, 0 );
+    data.bandwidth( SIMRATE, 1 << 20 );
+    acks.delay( SIMDELAY, 0 );
+    acks.bandwidth( SIMRATE, 1 << 20 );
+    server.impair( &data );
+    client.impair( &acks );
+
+    SimWindow run;
+    run.client = &client;
+    run.server = &server;
+    run.windowSize = windowSize;
+    run.retransmits = 0;
+    run.elapsed = run.srtt = run.rto = 0;
+    net.spawn( simServer, &run );
+    net.spawn( simClient, &run );
+    net.run( );
+
+    cerr << "Window size = ";
+    cout << windowSize << " ";
+    cerr << "Elasped time = ";
+    cout << run.elapsed << endl;
+    cerr << "retransmits = " << run.retransmits << endl;
+    cerr << "srtt = " << run.srtt << " rto = " << run.rto << endl;
   }
+  cerr << "wall clock time = " << wall.lap( ) << endl;
 }
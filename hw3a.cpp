@@ -7,6 +7,14 @@ Program 3 - TCP Sliding Window
 #include <iostream>
 #include "UdpSocket.h"
 #include "Timer.h"
+#include "RttEstimator.h"
+#include "CongestionControl.h"
+#include "SlidingWindow.h"
+#include "Impairment.h"
+#include "SimNetwork.h"
+#include "TraceRing.h"
+#include "Wire.h"
+#include <sys/wait.h>
 
 using namespace std;
 
@@ -15,20 +23,205 @@ using namespace std;
 #define MAXWIN 30        // the maximum window size
 #define LOOP 10          // loop in test 4 and 5
 #define MAXDROP 10      // max percentage to drop.
+#define MINRTO 100       // lower bound on the retransmission timeout in usec
+#define MAXRTO 1000000   // upper bound on the retransmission timeout in usec
+#define INITRTO 1500     // retransmission timeout before the first rtt sample
+#define MAXCWND 256      // window cap when a congestion controller sizes it
+#define SPINUSEC 0       // busy poll budget per wait before blocking, -1 spins
+#define ISN 4294963200u  // first sequence #, 4096 short of wrapping around
+#define OFFLOAD true     // use UDP GSO/GRO where the kernel supports them
+#define PACERATE 0       // pacing rate cap in bytes/sec in test 10, 0: cwnd/srtt
+#define PACEBURST 4      // segments the pacer lets go back to back
+#define ACKEVERY 2       // delayed acks in test 11: ack every 2nd segment ...
+#define ACKDELAY 200     // ... or 200 usec after the first unacked one
+#define FECN 16          // data segments per fec group in test 12 ...
+#define FECK 2           // ... and the parity segments that follow them
+#define FECMAXK 6        // most parity per group when adapting to the loss
+#define WANMAX 2000      // times of message transfer per link in test 13
+#define WANSEED 1        // seeds the simulated links of test 13
+#define WANLINGER 200000 // server acks resends until this long quiet, usec
+#define SIMDELAY 250     // one way delay of the simulated link in usec
+#define SIMRATE 12500000 // its bandwidth in bytes/sec (100 Mbps)
+#define SIMSEED 1        // seeds its losses
+#define SESSIONS 100     // concurrent clients in test 7
+#define SESSIONMAX 2000  // times of message transfer per client in test 7
+#define SHARDS 0         // receive shards in test 8, 0: one per online core
+#define TRACE "hw3a"     // kill -USR2 writes the packet trace to hw3a-<pid>.trace
 
 // client packet sending functions
 void clientUnreliable(UdpSocket &sock, const int max, int message[]);
-int clientStopWait(UdpSocket &sock, const int max, int message[]);
+int clientStopWait(UdpSocket &sock, const int max, int message[],
+        const SenderOptions &opts, RttEstimator &rtt);
 int clientSlidingWindow(UdpSocket &sock, const int max, int message[],
-        int windowSize);
-//int clientSlowAIMD( UdpSocket &sock, const int max, int message[],
-//           int windowSize, bool rttOn );
+        int windowSize, const SenderOptions &opts, RttEstimator &rtt,
+        CongestionControl &cc);
 
 // server packet receiving fucntions
 void serverUnreliable(UdpSocket &sock, const int max, int message[]);
 void serverReliable(UdpSocket &sock, const int max, int message[]);
 void serverEarlyRetrans(UdpSocket &sock, const int max, int message[],
-        int windowSize, int dropPercent);
+        int windowSize, int dropPercent, const ReceiverOptions &opts);
+void serverSessions(UdpSocket &sock, const int max, int windowSize,
+        int sessions, int dropPercent, unsigned int isn);
+void serverShardedSessions(UdpSocket *socks[], int shards, const int max,
+        int windowSize, int sessions, int dropPercent, unsigned int isn);
+
+// a simulated link for test 13, the same both ways. delays are one way.
+struct LinkProfile {
+    const char *name;
+    long delay, jitter;        // usec
+    double loss;               // independent, or while not in a burst
+    double toBad, toGood;      // bursts start/end, toBad 0: no bursts
+    double burstLoss;          // loss during a burst
+    double reorder;            // share of datagrams held back ...
+    long reorderDelay;         // ... this many usec more
+    double duplicate;          // share of datagrams delivered twice
+    long rate;                 // bytes/sec, 0: uncapped ...
+    int queue;                 // ... behind a queue of this many bytes
+};
+
+const LinkProfile PROFILES[] = {
+    // name        delay jitter  loss  toBad toGood burst reord  usec  dup      rate     queue
+    { "lan",          50,    10, 0,     0,    0,    0,    0,     0,    0,     125000000, 1 << 20 },
+    { "wan",        5000,   500, 0.005, 0,    0,    0,    0.01,  1000, 0,      12500000, 1 << 20 },
+    { "wifi",       2000,  2000, 0.001, 0.01, 0.3,  0.5,  0,     0,    0.01,    6250000, 1 << 19 },
+    { "satellite", 30000,  1000, 0.01,  0,    0,    0,    0,     0,    0,      2500000, 1 << 21 },
+};
+const int NPROFILES = sizeof(PROFILES) / sizeof(PROFILES[0]);
+
+void setLink(Impairment &link, const LinkProfile &profile) {
+    if (profile.toBad > 0)
+        link.gilbertElliott(profile.toBad, profile.toGood, profile.loss,
+                profile.burstLoss);
+    else
+        link.bernoulli(profile.loss);
+    link.delay(profile.delay, profile.jitter);
+    link.reorder(profile.reorder, profile.reorderDelay);
+    link.duplicate(profile.duplicate);
+    link.bandwidth(profile.rate, profile.queue);
+}
+
+// one run of test 14: a client and a server on a simulated network.
+struct SimTransfer {
+    UdpSocket *client;
+    UdpSocket *server;
+    int windowSize;
+    int dropPercent;
+    int retransmits;
+    long elapsed;              // virtual usec
+};
+
+void simClient(void *arg) {
+    SimTransfer &t = *(SimTransfer *) arg;
+    int message[MSGSIZE / 4];
+    memset(message, 0, sizeof(message));
+    RttEstimator rtt(MINRTO, MAXRTO, INITRTO);
+    FixedWindow cc(t.windowSize);
+    SenderOptions opts;        // go-back-n
+    opts.isn = ISN;
+    Timer timer;
+    timer.start();
+    t.retransmits = clientSlidingWindow(*t.client, MAX, message,
+            t.windowSize, opts, rtt, cc);
+    t.elapsed = timer.lap();
+}
+
+void simServer(void *arg) {
+    SimTransfer &t = *(SimTransfer *) arg;
+    int message[MSGSIZE / 4];
+    ReceiverOptions opts;
+    opts.isn = ISN;
+    serverEarlyRetrans(*t.server, MAX, message, t.windowSize,
+            t.dropPercent, opts);
+}
+
+// the window x loss grid of test 3, run in this process on a virtual clock
+//     over a SIMRATE link SIMDELAY each way. the server's drops are on the
+//     link, seeded per run, so every run replays exactly.
+void simulatedSweep() {
+    Timer wall;
+    wall.start();
+    for(int windowSize = 1; windowSize <= MAXWIN; windowSize++) {
+        for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+            SimNetwork net;
+            UdpSocket client(net, PORT + 1);
+            UdpSocket server(net, PORT);
+            client.setDestAddress((char *) "localhost", PORT);
+            Impairment data(SIMSEED * 1000 + windowSize * 100 + dropPercent);
+            data.bernoulli(dropPercent / 100.0);
+            data.delay(SIMDELAY, 0);
+            data.bandwidth(SIMRATE, 1 << 20);
+            Impairment acks(0);
+            acks.delay(SIMDELAY, 0);
+            acks.bandwidth(SIMRATE, 1 << 20);
+            server.impair(&data);
+            client.impair(&acks);
+
+            SimTransfer t;
+            t.client = &client;
+            t.server = &server;
+            t.windowSize = windowSize;
+            t.dropPercent = dropPercent;
+            t.retransmits = 0;
+            t.elapsed = 0;
+            net.spawn(simServer, &t);
+            net.spawn(simClient, &t);
+            net.run();
+
+            cerr << "Window size = ";
+            cout << windowSize << " ";
+            cerr << "drop percent = ";
+            cout << dropPercent << " ";
+            cerr << "Elasped time = ";
+            cout << t.elapsed << " ";
+            cerr << "retransmits = ";
+            cout << t.retransmits << endl;
+        }
+    }
+    cerr << "wall clock time = " << wall.lap() << endl;
+}
+
+// turn on the segmentation/coalescing offloads sock's kernel supports, it
+//     falls back to a datagram per message without them.
+void offload(UdpSocket &sock) {
+    if (OFFLOAD) {
+        sock.enableGso();
+        sock.enableGro();
+    }
+}
+
+// one timed transfer of a test, with its own rtt estimate and the options
+//     every test starts from: busy polling for SPINUSEC from ISN, and with
+//     tcp's recovery (sack, fast retransmit, per segment timers) if asked.
+struct Transfer {
+    Transfer(bool tcpRecovery = false);
+    // send max messages over sock with windowSize and cc, timed.
+    void run(UdpSocket &sock, int max, int message[], int windowSize,
+            CongestionControl &cc);
+
+    RttEstimator rtt;
+    SenderOptions opts;
+    long elapsed;              // usec
+    int retransmits;
+};
+
+Transfer::Transfer(bool tcpRecovery)
+    : rtt(MINRTO, MAXRTO, INITRTO), elapsed(0), retransmits(0) {
+    opts.spinUsec = SPINUSEC;
+    opts.isn = ISN;
+    opts.sackOn = tcpRecovery;
+    opts.fastRetransmitOn = tcpRecovery;
+    opts.perSegmentTimersOn = tcpRecovery;
+}
+
+void Transfer::run(UdpSocket &sock, int max, int message[], int windowSize,
+        CongestionControl &cc) {
+    Timer timer;
+    timer.start();
+    retransmits = clientSlidingWindow(sock, max, message, windowSize, opts,
+            rtt, cc);
+    elapsed = timer.lap();
+}
 
 enum myPartType {
     CLIENT, SERVER, ERROR
@@ -37,29 +230,45 @@ enum myPartType {
 int main(int argc, char *argv[]) {
 
     int message[MSGSIZE / 4]; // prepare a 1460-byte message: 1460/4 = 365 ints;
-    UdpSocket sock( PORT);  // define a UDP socket
-
     myPart = (argc == 1) ? SERVER : CLIENT;
+    TraceRing::dumpOnSignal(SIGUSR2, TRACE);
 
     if (argc != 1 && argc != 2) {
         cerr << "usage: " << argv[0] << " [serverIpName]" << endl;
         return -1;
     }
 
-    if (myPart == CLIENT) // I am a client and thus set my server address
-        if (sock.setDestAddress(argv[1]) == false) {
-            cerr << "cannot find the destination IP name: " << argv[1] << endl;
-            return -1;
-        }
-
     int testNumber;
     cerr << "Choose a testcase" << endl;
     cerr << "   1: unreliable test" << endl;
     cerr << "   2: stop-and-wait test" << endl;
     cerr << "   3: sliding windows" << endl;
+    cerr << "   4: go-back-n vs. selective ack" << endl;
+    cerr << "   5: congestion control" << endl;
+    cerr << "   6: timeout vs. fast retransmit" << endl;
+    cerr << "   7: many clients, one server" << endl;
+    cerr << "   8: many clients, sharded server" << endl;
+    cerr << "   9: sockets vs. io_uring" << endl;
+    cerr << "  10: bursts vs. pacing" << endl;
+    cerr << "  11: every ack vs. delayed acks" << endl;
+    cerr << "  12: retransmission vs. fec" << endl;
+    cerr << "  13: simulated links" << endl;
+    cerr << "  14: simulated window x loss sweep" << endl;
     cerr << "--> ";
     cin >> testNumber;
 
+    // the server of test 8 shares its port so it can add more sockets to
+    //     it. a client on the same host must not join them, it would steal
+    //     data, and no other test lets anything else in.
+    UdpSocket sock( PORT, myPart == SERVER && testNumber == 8); // a UDP socket
+    offload(sock);
+
+    if (myPart == CLIENT) // I am a client and thus set my server address
+        if (sock.setDestAddress(argv[1]) == false) {
+            cerr << "cannot find the destination IP name: " << argv[1] << endl;
+            return -1;
+        }
+
     if (myPart == CLIENT) {
 
         Timer timer;           // define a timer
@@ -72,38 +281,282 @@ int main(int argc, char *argv[]) {
             cerr << "Elasped time = ";                              // lap timer
             cout << timer.lap() << endl;
             break;
-        case 2:
+        case 2: {
+            RttEstimator rtt(MINRTO, MAXRTO, INITRTO);            // per transfer
+            SenderOptions opts;
+            opts.spinUsec = SPINUSEC;
+            opts.isn = ISN;
             timer.start();                                        // start timer
-            retransmits = clientStopWait(sock, MAX, message);     // actual test
+            retransmits = clientStopWait(sock, MAX, message, opts, rtt); // test
             cerr << "Elasped time = ";                              // lap timer
             cout << timer.lap() << endl;
             cerr << "retransmits = " << retransmits << endl;
+            cerr << "srtt = " << rtt.srtt() << " rto = " << rtt.rto() << endl;
             break;
-        case 3:
-                for(int dropPercent = 0; dropPercent <=MAXDROP; dropPercent++) {
-                    timer.start();                                    // start timer
-                    retransmits = clientSlidingWindow(sock, MAX, message,
-                            1); // actual test
-                    cerr << "Window size = ";                           // lap timer
-                    cout << 1 << " ";
+        }
+        case 3: {
+            // window 1, then window 30, over every drop percent.
+            const int windows[] = { 1, 30 };
+            for(int w = 0; w < 2; w++) {
+                for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++){
+                    Transfer t;                               // go-back-n
+                    FixedWindow cc(windows[w]);               // no cwnd
+                    t.run(sock, MAX, message, windows[w], cc); // actual test
+                    cerr << "Window size = ";
+                    cout << windows[w] << " ";
                     cerr << "drop percent = ";
                     cout << dropPercent << " ";
                     cerr << "Elasped time = ";
-                    cout << timer.lap() << endl;
-                    cerr << "retransmits = " << retransmits << endl;
+                    cout << t.elapsed << endl;
+                    cerr << "retransmits = " << t.retransmits << endl;
+                    cerr << "srtt = " << t.rtt.srtt() << " rto = "
+                         << t.rtt.rto() << endl;
                 }
-                for(int dropPercent = 0; dropPercent <=MAXDROP; dropPercent++) {
-                    timer.start();                                    // start timer
-                    retransmits = clientSlidingWindow(sock, MAX, message,
-                            30); // actual test
-                    cerr << "Window size = ";                           // lap timer
-                    cout << 30 << " ";
-                    cerr << "drop percent = ";
-                    cout << dropPercent << " ";
-                    cerr << "Elasped time = ";
-                    cout << timer.lap() << endl;
-                    cerr << "retransmits = " << retransmits << endl;
+            }
+            break;
+        }
+        case 4:
+            // same lossy transfer twice per drop percent: first go-back-n,
+            // then selective ack, printed side by side.
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                Transfer gbn;
+                FixedWindow gbnCc(MAXWIN);
+                gbn.run(sock, MAX, message, MAXWIN, gbnCc);
+
+                Transfer sack;
+                FixedWindow sackCc(MAXWIN);
+                sack.opts.sackOn = true;
+                sack.run(sock, MAX, message, MAXWIN, sackCc);
+
+                cerr << "Window size = ";
+                cout << MAXWIN << " ";
+                cerr << "drop percent = ";
+                cout << dropPercent << " ";
+                cerr << "go-back-n elapsed/retransmits = ";
+                cout << gbn.elapsed << " " << gbn.retransmits << " ";
+                cerr << "sack elapsed/retransmits = ";
+                cout << sack.elapsed << " " << sack.retransmits << endl;
+            }
+            break;
+        case 5: {
+            char ccName[16];
+            cerr << "Choose a congestion controller "
+                 << "(fixed, aimd, newreno, cubic)" << endl;
+            cerr << "--> ";
+            cin.width(sizeof(ccName));
+            cin >> ccName;
+
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                CongestionControl *cc = createCongestionControl(ccName, MAXCWND);
+                if(cc == NULL) {
+                    cerr << "no such congestion controller" << endl;
+                    return -1;
                 }
+                Transfer t(true);
+                t.run(sock, MAX, message, MAXCWND, *cc);
+                cerr << cc->name() << " drop percent = ";
+                cout << dropPercent << " ";
+                cerr << "Elasped time = ";
+                cout << t.elapsed << endl;
+                cerr << "retransmits = " << t.retransmits << endl;
+                cerr << "cwnd = " << cc->cwnd() << " ssthresh = "
+                     << cc->ssthresh() << endl;
+                delete cc;
+            }
+            break;
+        }
+        case 6:
+            // same lossy transfer twice per drop percent: first recovering
+            // only on timeouts, then with fast retransmit/recovery.
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                Transfer rto;
+                FixedWindow rtoCc(MAXWIN);
+                rto.run(sock, MAX, message, MAXWIN, rtoCc);
+
+                Transfer fr;
+                FixedWindow frCc(MAXWIN);
+                fr.opts.fastRetransmitOn = true;
+                fr.run(sock, MAX, message, MAXWIN, frCc);
+
+                cerr << "Window size = ";
+                cout << MAXWIN << " ";
+                cerr << "drop percent = ";
+                cout << dropPercent << " ";
+                cerr << "timeout only elapsed/retransmits = ";
+                cout << rto.elapsed << " " << rto.retransmits << " ";
+                cerr << "fast retransmit elapsed/retransmits = ";
+                cout << fr.elapsed << " " << fr.retransmits << endl;
+            }
+            break;
+        case 7:
+        case 8:
+            // one child process per session, each sending from its own port
+            //     with its own connection id, all at once.
+            timer.start();
+            for(int session = 0; session < SESSIONS; session++) {
+                if(fork() != 0)
+                    continue;
+                UdpSocket own(0);                       // any free port
+                offload(own);
+                if(own.setDestAddress(argv[1], PORT) == false)
+                    exit(-1);
+                CongestionControl *cc = createCongestionControl("newreno",
+                        MAXWIN);
+                Transfer t(true);
+                t.opts.connId = session;
+                t.run(own, SESSIONMAX, message, MAXWIN, *cc);
+                cerr << "session = ";
+                cout << session << " ";
+                cerr << "Elasped time = ";
+                cout << t.elapsed << " ";
+                cerr << "retransmits = ";
+                cout << t.retransmits << endl;
+                delete cc;
+                exit(0);
+            }
+            while(wait(NULL) > 0)
+                ;
+            cerr << "all sessions elapsed time = ";
+            cout << timer.lap() << endl;
+            break;
+        case 9:
+            // same lossy transfer twice per drop percent: first with a
+            //     system call per batch, then through io_uring.
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                Transfer sockets;
+                FixedWindow socketsCc(MAXWIN);
+                sockets.opts.sackOn = true;
+                sockets.opts.fastRetransmitOn = true;
+                sockets.run(sock, MAX, message, MAXWIN, socketsCc);
+
+                if(!sock.enableUring())
+                    cerr << "no io_uring, using sockets" << endl;
+                Transfer uring;
+                FixedWindow uringCc(MAXWIN);
+                uring.opts.sackOn = true;
+                uring.opts.fastRetransmitOn = true;
+                uring.run(sock, MAX, message, MAXWIN, uringCc);
+                sock.disableUring();
+
+                cerr << "Window size = ";
+                cout << MAXWIN << " ";
+                cerr << "drop percent = ";
+                cout << dropPercent << " ";
+                cerr << "sockets elapsed/retransmits = ";
+                cout << sockets.elapsed << " " << sockets.retransmits << " ";
+                cerr << "io_uring elapsed/retransmits = ";
+                cout << uring.elapsed << " " << uring.retransmits << endl;
+            }
+            break;
+        case 10:
+            // same lossy transfer twice per drop percent: first sending
+            //     whatever the window allows at once, then paced.
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                Transfer burst(true);
+                Cubic burstCc(MAXCWND);
+                burst.run(sock, MAX, message, MAXCWND, burstCc);
+
+                Transfer paced(true);
+                Cubic pacedCc(MAXCWND);
+                Pacer pacer(PACERATE, MSGSIZE, PACEBURST);
+                paced.opts.pacer = &pacer;
+                paced.run(sock, MAX, message, MAXCWND, pacedCc);
+
+                cerr << "drop percent = ";
+                cout << dropPercent << " ";
+                cerr << "burst elapsed/retransmits = ";
+                cout << burst.elapsed << " " << burst.retransmits << " ";
+                cerr << "paced elapsed/retransmits/pacing delay = ";
+                cout << paced.elapsed << " " << paced.retransmits << " "
+                     << pacer.delay() << endl;
+            }
+            break;
+        case 11:
+            // same lossy transfer twice per drop percent: the server acks
+            //     every segment the first time, and delays acks the second.
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                Transfer every(true);
+                Cubic everyCc(MAXCWND);
+                every.run(sock, MAX, message, MAXCWND, everyCc);
+
+                Transfer delayed(true);
+                Cubic delayedCc(MAXCWND);
+                delayed.run(sock, MAX, message, MAXCWND, delayedCc);
+
+                cerr << "drop percent = ";
+                cout << dropPercent << " ";
+                cerr << "every ack elapsed/retransmits = ";
+                cout << every.elapsed << " " << every.retransmits << " ";
+                cerr << "delayed acks elapsed/retransmits = ";
+                cout << delayed.elapsed << " " << delayed.retransmits << endl;
+            }
+            break;
+        case 12:
+            // same lossy transfer three times per drop percent: repaired by
+            //     retransmission alone, then with FECK parity per FECN
+            //     segments, then with the parity adapting to the loss.
+            cerr << "fec kernel = " << gfKernel() << endl;
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                Transfer plain(true);
+                Cubic plainCc(MAXCWND);
+                plain.run(sock, MAX, message, MAXCWND, plainCc);
+
+                Transfer fixed(true);
+                Cubic fixedCc(MAXCWND);
+                FecEncoder fixedFec(FECN, FECK);
+                fixed.opts.fec = &fixedFec;
+                fixed.run(sock, MAX, message, MAXCWND, fixedCc);
+
+                Transfer adaptive(true);
+                Cubic adaptiveCc(MAXCWND);
+                FecEncoder adaptiveFec(FECN, 1);
+                adaptiveFec.adapt(1, FECMAXK);
+                adaptive.opts.fec = &adaptiveFec;
+                adaptive.run(sock, MAX, message, MAXCWND, adaptiveCc);
+
+                cerr << "drop percent = ";
+                cout << dropPercent << " ";
+                cerr << "retransmission elapsed/retransmits = ";
+                cout << plain.elapsed << " " << plain.retransmits << " ";
+                cerr << "fec elapsed/retransmits/parity = ";
+                cout << fixed.elapsed << " " << fixed.retransmits << " "
+                     << fixedFec.parities() << " ";
+                cerr << "adaptive fec elapsed/retransmits/parity/k = ";
+                cout << adaptive.elapsed << " " << adaptive.retransmits << " "
+                     << adaptiveFec.parities() << " "
+                     << adaptiveFec.redundancy() << endl;
+            }
+            break;
+        case 13:
+            // one transfer per link profile. this end impairs the acks, the
+            //     server the data, each with its own seed.
+            for(int p = 0; p < NPROFILES; p++) {
+                Impairment link(WANSEED * 2 * NPROFILES + 2 * p + 1);
+                setLink(link, PROFILES[p]);
+                sock.impair(&link);
+                Transfer t(true);
+                Cubic cc(MAXCWND);
+                t.run(sock, WANMAX, message, MAXCWND, cc);
+                sock.impair(NULL);
+
+                cerr << "link = ";
+                cout << PROFILES[p].name << " ";
+                cerr << "elapsed = ";
+                cout << t.elapsed << " ";
+                cerr << "retransmits = ";
+                cout << t.retransmits << " ";
+                cerr << "srtt = ";
+                cout << t.rtt.srtt() << " ";
+                cerr << "acks passed/dropped/duplicated/reordered = ";
+                cout << link.passed() << " " << link.dropped() << " "
+                     << link.duplicated() << " " << link.reordered() << endl;
+
+                // let the server stop lingering before the next transfer.
+                usleep(2 * WANLINGER);
+            }
+            break;
+        case 14:
+            simulatedSweep();
             break;
         default:
             cerr << "no such test case" << endl;
@@ -111,6 +564,8 @@ int main(int argc, char *argv[]) {
         }
     }
     if (myPart == SERVER) {
+        ReceiverOptions opts;                                // ack every segment
+        opts.isn = ISN;
         switch (testNumber) {
         case 1:
             serverUnreliable(sock, MAX, message);
@@ -120,24 +575,122 @@ int main(int argc, char *argv[]) {
             break;
         case 3:
             for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++){
-                serverEarlyRetrans(sock, MAX, message, 1, dropPercent);
+                serverEarlyRetrans(sock, MAX, message, 1, dropPercent, opts);
             }
             for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++){
-                serverEarlyRetrans(sock, MAX, message, 30, dropPercent);
+                serverEarlyRetrans(sock, MAX, message, 30, dropPercent, opts);
+            }
+            break;
+        case 4:
+        case 6:
+            // the server always sacks and repeats its ack for every segment
+            // past a hole, so it just runs each transfer twice.
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                serverEarlyRetrans(sock, MAX, message, MAXWIN, dropPercent, opts);
+                serverEarlyRetrans(sock, MAX, message, MAXWIN, dropPercent, opts);
+            }
+            break;
+        case 5:
+            // the controller only lives in the client.
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                serverEarlyRetrans(sock, MAX, message, MAXCWND, dropPercent, opts);
+            }
+            break;
+        case 7:
+            serverSessions(sock, SESSIONMAX, MAXWIN, SESSIONS, 0, ISN);
+            break;
+        case 8: {
+            // sock is the first shard, the rest join it on the same port.
+            int shards = SHARDS > 0 ? SHARDS : sysconf(_SC_NPROCESSORS_ONLN);
+            if(shards < 1) shards = 1;
+            UdpSocket **socks = new UdpSocket*[shards];
+            socks[0] = &sock;
+            for(int i = 1; i < shards; i++) {
+                socks[i] = new UdpSocket(PORT, true);
+                offload(*socks[i]);
+            }
+            serverShardedSessions(socks, shards, SESSIONMAX, MAXWIN, SESSIONS,
+                    0, ISN);
+            for(int i = 1; i < shards; i++)
+                delete socks[i];
+            delete[] socks;
+            break;
+        }
+        case 9:
+            // the server switches backends along with the client.
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                serverEarlyRetrans(sock, MAX, message, MAXWIN, dropPercent, opts);
+                if(!sock.enableUring())
+                    cerr << "no io_uring, using sockets" << endl;
+                serverEarlyRetrans(sock, MAX, message, MAXWIN, dropPercent, opts);
+                sock.disableUring();
+            }
+            break;
+        case 10:
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                serverEarlyRetrans(sock, MAX, message, MAXCWND, dropPercent, opts);
+                serverEarlyRetrans(sock, MAX, message, MAXCWND, dropPercent, opts);
             }
             break;
+        case 11: {
+            // the ack counts end up on stderr.
+            ReceiverOptions delayed;
+            delayed.isn = ISN;
+            delayed.ackEvery = ACKEVERY;
+            delayed.ackDelay = ACKDELAY;
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                serverEarlyRetrans(sock, MAX, message, MAXCWND, dropPercent, opts);
+                serverEarlyRetrans(sock, MAX, message, MAXCWND, dropPercent,
+                        delayed);
+            }
+            break;
+        }
+        case 12: {
+            // parity is dropped as often as data.
+            ReceiverOptions fec;
+            fec.isn = ISN;
+            fec.fecOn = true;
+            for(int dropPercent = 0; dropPercent <= MAXDROP; dropPercent++) {
+                serverEarlyRetrans(sock, MAX, message, MAXCWND, dropPercent, opts);
+                serverEarlyRetrans(sock, MAX, message, MAXCWND, dropPercent, fec);
+                serverEarlyRetrans(sock, MAX, message, MAXCWND, dropPercent, fec);
+            }
+            break;
+        }
+        case 13: {
+            ReceiverOptions lingering = opts;
+            lingering.lingerUsec = WANLINGER;
+            for(int p = 0; p < NPROFILES; p++) {
+                Impairment link(WANSEED * 2 * NPROFILES + 2 * p);
+                setLink(link, PROFILES[p]);
+                sock.impair(&link);
+                serverEarlyRetrans(sock, WANMAX, message, MAXCWND, 0, lingering);
+                sock.impair(NULL);
+                fprintf(stderr, "link = %s, data passed/dropped/duplicated/"
+                        "reordered = %ld %ld %ld %ld\n", PROFILES[p].name,
+                        link.passed(), link.dropped(), link.duplicated(),
+                        link.reordered());
+            }
+            break;
+        }
+        case 14:
+            // needs no client, both ends run in this process.
+            simulatedSweep();
+            break;
         default:
             cerr << "no such test case" << endl;
             break;
         }
 
         // The server should make sure that the last ack has been delivered to
-        // the client. Send it three time in three seconds
+        // the client. Send it three time in three seconds. test 14 had its
+        // client in this process, and it is long done.
         cerr << "server ending..." << endl;
-        for (int i = 0; i < 10; i++) {
+        for (int i = 0; i < 10 && testNumber != 14; i++) {
             sleep(1);
-            int ack = MAX - 1;
-            sock.ackTo((char *) &ack, sizeof(ack));
+            char ack[WIRE_HDR];
+            wireWrite(ack, WIRE_HDR, WireHeader(WIRE_ACK, 0, MAX - 1));
+            sock.ackTo(ack, WIRE_HDR);
         }
     }
 
@@ -152,9 +705,9 @@ void clientUnreliable(UdpSocket &sock, const int max, int message[]) {
 
     // transfer message[] max times
     for (int i = 0; i < max; i++) {
-        message[0] = i;                           // message[0] has a sequence #
+        wireWrite((char *) message, MSGSIZE, WireHeader(WIRE_DATA, i));
         sock.sendTo((char *) message, MSGSIZE); // udp message send
-        cerr << "message = " << message[0] << endl;
+        TraceRing::process().record(TRACE_SEND, i, 0, 0, 0);
     }
 }
 
@@ -164,7 +717,10 @@ void serverUnreliable(UdpSocket &sock, const int max, int message[]) {
 
     // receive message[] max times
     for (int i = 0; i < max; i++) {
-        sock.recvFrom((char *) message, MSGSIZE);   // udp message receive
-        cerr << message[0] << endl;                     // print out message
+        // udp message receive, corrupt ones aren't traced
+        int length = sock.recvFrom((char *) message, MSGSIZE);
+        WireHeader header;
+        if (wireRead((char *) message, length, header))
+            TraceRing::process().record(TRACE_RECV, header.seq, 0, 0, 0);
     }
 }
@@ -0,0 +1,325 @@
+/*
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+// checks the parts of the protocol that need no socket and no peer: the
+//     wire checksum, sequence number wraparound, the timing wheel, the fec
+//     code and the session table. make test builds and runs it; it prints
+//     what fails and exits non-zero if anything does.
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include "Wire.h"
+#include "SeqRing.h"
+#include "TimerWheel.h"
+#include "Fec.h"
+#include "SessionTable.h"
+
+using namespace std;
+
+#define SEGSIZE 200      // bytes of each fec test segment, header included
+#define FECN 8           // data segments per fec test group
+#define FECK 2           // parity segments per fec test group
+#define WRAPSTART 4294967292u // 4 short of wrapping around
+
+int failures = 0;
+
+void check(bool ok, const char *what) {
+    if(!ok) {
+        cerr << "FAIL: " << what << endl;
+        failures++;
+    }
+}
+
+/*==============================================================================
+        CRC32C and the wire header
+*/
+
+void testWire() {
+    // the check value of the castagnoli polynomial (RFC 3720, B.4).
+    const char *digits = "123456789";
+    check(crc32c(0, digits, 9) == 0xe3069283u, "crc32c check value");
+    check(crc32c(crc32c(0, digits, 4), digits + 4, 5) == 0xe3069283u,
+            "crc32c extends a crc");
+    char zeros[32];
+    memset(zeros, 0, sizeof(zeros));
+    check(crc32c(0, zeros, sizeof(zeros)) == 0x8a9136aau,
+            "crc32c of 32 zero bytes");
+
+    char datagram[SEGSIZE];
+    for(int i = 0; i < SEGSIZE; i++) datagram[i] = (char) (i * 7);
+    WireHeader out(WIRE_DATA | WIRE_SACK, WRAPSTART, 12345, 70000, 42);
+    wireWrite(datagram, SEGSIZE, out);
+    WireHeader in;
+    check(wireRead(datagram, SEGSIZE, in), "wire header reads back");
+    check(in.flags == out.flags && in.seq == out.seq && in.ack == out.ack
+            && in.connId == out.connId, "wire header fields");
+    check(in.window == 0xffff, "wire window saturates at 16 bits");
+    check(wireSeq(datagram) == WRAPSTART && wireConnId(datagram) == 42,
+            "wire seq and conn id unchecked");
+    check(!wireRead(datagram, WIRE_HDR - 1, in), "short datagram");
+    datagram[SEGSIZE - 1] ^= 1;
+    check(!wireRead(datagram, SEGSIZE, in), "corrupt payload");
+    datagram[SEGSIZE - 1] ^= 1;
+    datagram[WIRE_HDR / 2] ^= 0x10;
+    check(!wireRead(datagram, SEGSIZE, in), "corrupt header");
+}
+
+/*==============================================================================
+        Sequence numbers
+*/
+
+void testSeqRing() {
+    check(seqLt(0xffffffffu, 0) && seqGt(0, 0xffffffffu),
+            "seq # order across the wrap");
+    check(seqDiff(1, 0xffffffffu) == 2, "seq # distance across the wrap");
+    check(seqLeq(5, 5) && seqGeq(5, 5) && !seqLt(5, 5), "seq # equal");
+
+    SeqRing ring(40);
+    check(ring.capacity() == 64, "ring rounds up to a power of two");
+    for(unsigned int seq = WRAPSTART; seq != WRAPSTART + 8; seq++)
+        check(!ring.test(seq), "ring starts clear");
+    for(unsigned int seq = WRAPSTART; seq != WRAPSTART + 8; seq += 2)
+        ring.set(seq);
+    for(unsigned int seq = WRAPSTART; seq != WRAPSTART + 8; seq++)
+        check(ring.test(seq) == ((seq - WRAPSTART) % 2 == 0),
+                "ring flags across the wrap");
+    check(ring.slot(0xffffffffu) == 63 && ring.slot(0) == 0,
+            "ring slots across the wrap");
+    ring.resetRange(WRAPSTART + 2, WRAPSTART + 6);
+    for(unsigned int seq = WRAPSTART; seq != WRAPSTART + 8; seq++)
+        check(ring.test(seq) == (seq == WRAPSTART || seq == WRAPSTART + 6),
+                "ring range reset across the wrap");
+    ring.reset(WRAPSTART);
+    check(!ring.test(WRAPSTART), "ring reset");
+}
+
+/*==============================================================================
+        Timing wheel
+*/
+
+// # of timers expired by now, whose ids are or-ed into fired.
+int popAll(TimerWheel &wheel, long now, int &fired) {
+    wheel.expire(now);
+    int count = 0;
+    for(TimerWheel::Entry *e = wheel.popExpired(); e != NULL;
+            e = wheel.popExpired()) {
+        check(!wheel.armed(*e), "an expired timer is not armed");
+        fired |= e->id;
+        count++;
+    }
+    return count;
+}
+
+void testTimerWheel() {
+    // one timer per wheel, and one cancelled.
+    long deadlines[] = { 100, 3000, 200000, 10000000, 500 };
+    const int n = sizeof(deadlines) / sizeof(deadlines[0]);
+    TimerWheel wheel(WHEEL_TICK);
+    TimerWheel::Entry entries[n];
+    for(int i = 0; i < n; i++) {
+        entries[i].id = 1 << i;
+        wheel.schedule(entries[i], deadlines[i]);
+    }
+    check(wheel.size() == n, "wheel counts armed timers");
+    wheel.cancel(entries[n - 1]);
+    check(wheel.size() == n - 1 && !wheel.armed(entries[n - 1]),
+            "wheel cancels");
+    check(wheel.nextDeadline() >= 100
+            && wheel.nextDeadline() < 100 + WHEEL_TICK,
+            "wheel's next deadline, to a tick");
+
+    // each fires within a tick of its deadline, not before, and in turn.
+    int fired = 0;
+    for(int i = 0; i < n - 1; i++) {
+        check(popAll(wheel, deadlines[i] - 2 * WHEEL_TICK, fired) == 0,
+                "wheel fires no timer early");
+        check(popAll(wheel, deadlines[i] + WHEEL_TICK, fired) == 1
+                && (fired & (1 << i)) != 0, "wheel fires a timer on time");
+    }
+    check(wheel.size() == 0 && wheel.nextDeadline() < 0, "wheel empties");
+    check((fired & (1 << (n - 1))) == 0, "a cancelled timer never fires");
+
+    // re-arming moves a timer, it doesn't add one.
+    wheel.schedule(entries[0], deadlines[3] + 1000);
+    wheel.schedule(entries[0], deadlines[3] + 5000);
+    check(wheel.size() == 1, "wheel re-arms in place");
+    fired = 0;
+    check(popAll(wheel, deadlines[3] + 2000, fired) == 0
+            && popAll(wheel, deadlines[3] + 6000, fired) == 1,
+            "a re-armed timer fires at its new deadline");
+}
+
+/*==============================================================================
+        Forward error correction
+*/
+
+// segment seq # of a group: a data header and a payload made of its seq #.
+void makeSegment(char *segment, unsigned int seq) {
+    for(int i = WIRE_HDR; i < SEGSIZE; i++)
+        segment[i] = (char) (seq * 31 + i * 13);
+    wireWrite(segment, SEGSIZE, WireHeader(WIRE_DATA, seq, 0, 0, 9));
+}
+
+// code a group of FECN segments from WRAPSTART, across the wrap, into
+//     segments and parity; returns the # of parity datagrams.
+int encodeGroup(char segments[][SEGSIZE], char parity[][SEGSIZE + FECHDR]) {
+    FecEncoder encoder(FECN, FECK, SEGSIZE);
+    char *parityPtrs[FEC_MAXK];
+    for(int j = 0; j < FEC_MAXK; j++) parityPtrs[j] = parity[j];
+    int made = 0;
+    for(int i = 0; i < FECN; i++) {
+        makeSegment(segments[i], WRAPSTART + i);
+        made = encoder.add(segments[i], i == FECN - 1, parityPtrs);
+    }
+    return made;
+}
+
+// does decoder hold segment i of the group, as it was sent.
+bool holds(FecDecoder &decoder, char segments[][SEGSIZE], int i) {
+    const char *held = decoder.segment(WRAPSTART + i);
+    return held != NULL && memcmp(held, segments[i], SEGSIZE) == 0;
+}
+
+// hand the group's segments but the holes to decoder in order, each with
+//     the receiver's next in-order seq # at the time; returns that seq #.
+unsigned int receive(FecDecoder &decoder, char segments[][SEGSIZE],
+        bool hole(int)) {
+    unsigned int expected = WRAPSTART;
+    unsigned int repaired[FEC_MAXK];
+    for(int i = 0; i < FECN; i++) {
+        if(hole(i)) continue;
+        check(decoder.data(WRAPSTART + i, segments[i], expected,
+                repaired) == 0, "no repair before parity");
+        if(WRAPSTART + i == expected) expected++;
+    }
+    return expected;
+}
+
+bool twoHoles(int i) { return i == 1 || i == 6; }
+bool threeHoles(int i) { return i < 3; }
+bool oneHole(int i) { return i == 4; }
+
+void testFec() {
+    char segments[FECN][SEGSIZE];
+    char parity[FEC_MAXK][SEGSIZE + FECHDR];
+    check(encodeGroup(segments, parity) == FECK, "a full group's parity");
+    for(int j = 0; j < FECK; j++)
+        check(isParity(parity[j], SEGSIZE + FECHDR, SEGSIZE)
+                && !isParity(segments[0], SEGSIZE, SEGSIZE),
+                "parity tells itself from data");
+
+    // as many holes as parity: both rebuilt, byte for byte.
+    unsigned int repaired[FEC_MAXK];
+    {
+        FecDecoder decoder(16, SEGSIZE);
+        unsigned int expected = receive(decoder, segments, twoHoles);
+        check(decoder.parity(parity[0], expected, repaired) == 0,
+                "one parity can't fill two holes");
+        check(decoder.parity(parity[1], expected, repaired) == 2,
+                "two parity fill two holes");
+        check(decoder.rebuilt() == 2, "decoder counts what it rebuilt");
+        check(holds(decoder, segments, 1) && holds(decoder, segments, 6),
+                "rebuilt segments are the lost ones");
+    }
+
+    // one hole too many waits for a resend, which then repairs the rest.
+    {
+        FecDecoder decoder(16, SEGSIZE);
+        unsigned int expected = receive(decoder, segments, threeHoles);
+        for(int j = 0; j < FECK; j++)
+            check(decoder.parity(parity[j], expected, repaired) == 0,
+                    "three holes, two parity: no repair");
+        check(decoder.data(WRAPSTART + 1, segments[1], expected,
+                repaired) == 2, "a resend leaves few enough holes");
+        check(holds(decoder, segments, 0) && holds(decoder, segments, 2),
+                "repaired after the resend");
+        check(decoder.data(WRAPSTART + 1, segments[1], expected,
+                repaired) == 0, "a duplicate repairs nothing");
+    }
+
+    // corrupt parity rebuilds nothing, and leaves the ring alone, even the
+    //     slot of the hole, which still holds a segment a ring earlier. the
+    //     ring of a 16 segment window is 128 long.
+    {
+        FecDecoder decoder(16, SEGSIZE);
+        char older[SEGSIZE];
+        makeSegment(older, WRAPSTART + 4 - 128);
+        decoder.data(WRAPSTART + 4 - 128, older, WRAPSTART + 4 - 128,
+                repaired);
+        unsigned int expected = receive(decoder, segments, oneHole);
+        parity[0][FECHDR + 50] ^= 0x55;
+        check(decoder.parity(parity[0], expected, repaired) == 0
+                && decoder.segment(WRAPSTART + 4) == NULL
+                && decoder.rebuilt() == 0, "corrupt parity rebuilds nothing");
+        check(holds(decoder, segments, 3) && holds(decoder, segments, 5)
+                && decoder.segment(WRAPSTART + 4 - 128) != NULL
+                && memcmp(decoder.segment(WRAPSTART + 4 - 128), older,
+                        SEGSIZE) == 0,
+                "held segments survive a failed rebuild");
+        parity[0][FECHDR + 50] ^= 0x55;
+        check(decoder.parity(parity[1], expected, repaired) == 1
+                && holds(decoder, segments, 4),
+                "sound parity still rebuilds after a corrupt one");
+    }
+}
+
+/*==============================================================================
+        Session table
+*/
+
+// a peer on localhost at port.
+struct sockaddr peerAt(int port) {
+    struct sockaddr_in in;
+    memset(&in, 0, sizeof(in));
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    in.sin_port = htons(port);
+    return (struct sockaddr &) in;
+}
+
+void testSessionTable() {
+    struct sockaddr a = peerAt(1001), b = peerAt(1002), c = peerAt(1003);
+    {
+        // room for two, and no one goes quiet long enough to expire.
+        SessionTable table(4, WRAPSTART, 10, 2, 1000000000, 1000000000);
+        Session *sa = table.find(a, 7);
+        Session *sb = table.find(b, 7);
+        check(sa != NULL && sb != NULL && sa != sb, "two sessions");
+        check(table.find(a, 7) == sa && table.find(a, 8) == NULL,
+                "a session is found by peer and conn id");
+        check(table.find(c, 7) == NULL && table.live() == 2
+                && table.find(b, 7) == sb, "a full table keeps transfers "
+                "under way");
+        table.finish(sa);
+        Session *sc = table.find(c, 7);
+        check(sc != NULL && table.live() == 2 && table.size() == 3,
+                "a finished session makes room");
+        check(table.find(a, 7) == NULL, "a finished session is gone");
+    }
+    {
+        // room for one, and a transfer expires as soon as it's quiet.
+        SessionTable table(4, WRAPSTART, 10, 1, 0, 0);
+        check(table.find(a, 7) != NULL && table.find(b, 7) != NULL
+                && table.live() == 1, "a quiet transfer makes room");
+    }
+}
+
+int main() {
+    testWire();
+    testSeqRing();
+    testTimerWheel();
+    testFec();
+    testSessionTable();
+    cerr << "crc32c kernel = " << crc32cKernel() << ", fec kernel = "
+         << gfKernel() << endl;
+    if(failures > 0) {
+        cerr << failures << " checks failed" << endl;
+        return 1;
+    }
+    cerr << "all checks passed" << endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+Tom Petit
+CSS 432 - Spring 2015
+Program 3 - TCP Sliding Window
+*/
+
+// turns a trace TraceRing::dump() wrote into gnuplot data: one file per
+//     event type of "msec seq ack window cwnd connId" lines, the sender's
+//     window over time, and a plot file drawing the time/sequence graph.
+//     seq and ack are counted from the first event's seq, so a transfer
+//     wrapping around 2^32 still plots as a line.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include "TraceRing.h"
+
+using namespace std;
+
+const char *NAMES[TRACE_TYPES] = { "send", "retransmit", "fastretransmit",
+    "ack", "dupack", "timeout", "recv" };
+
+// how each type is drawn in the time/sequence plot.
+const char *STYLES[TRACE_TYPES] = { "dots", "points pt 2", "points pt 6",
+    "steps", "points pt 1", "impulses", "dots" };
+
+int main(int argc, char *argv[]) {
+    if(argc != 2 && argc != 3) {
+        cerr << "usage: " << argv[0] << " trace [prefix]" << endl;
+        return -1;
+    }
+    string prefix = argc == 3 ? argv[2] : argv[1];
+    if(argc == 2 && prefix.size() > 6
+            && prefix.compare(prefix.size() - 6, 6, ".trace") == 0)
+        prefix.erase(prefix.size() - 6);
+
+    FILE *in = fopen(argv[1], "rb");
+    if(in == NULL) {
+        perror(argv[1]);
+        return -1;
+    }
+    TraceHeader header;
+    if(fread(&header, sizeof(header), 1, in) != 1
+            || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+            || header.eventSize != sizeof(TraceEvent)) {
+        cerr << argv[1] << ": not a trace, or from another build" << endl;
+        fclose(in);
+        return -1;
+    }
+    if(header.lost > 0)
+        cerr << header.lost << " events before the first were overwritten"
+             << endl;
+
+    ofstream out[TRACE_TYPES];
+    long counts[TRACE_TYPES] = { 0 };
+    for(int t = 0; t < TRACE_TYPES; t++)
+        out[t].open((prefix + "-" + NAMES[t] + ".dat").c_str());
+    ofstream window((prefix + "-window.dat").c_str());
+
+    TraceEvent e;
+    uint64_t firstNsec = 0;
+    uint32_t firstSeq = 0;
+    for(uint64_t n = 0; n < header.count && fread(&e, sizeof(e), 1, in) == 1;
+            n++) {
+        if(n == 0) {
+            firstNsec = e.nsec;
+            firstSeq = e.seq;
+        }
+        if(e.type >= TRACE_TYPES) continue;
+        double msec = (e.nsec - firstNsec) / 1000000.0;
+        int seq = (int) (e.seq - firstSeq);
+        int ack = (int) (e.ack - firstSeq);
+        out[e.type] << msec << " " << seq << " " << ack << " " << e.window
+                    << " " << e.cwnd << " " << e.connId << "\n";
+        counts[e.type]++;
+        if(e.type == TRACE_SEND || e.type == TRACE_ACK)
+            window << msec << " " << e.window << " " << e.cwnd << "\n";
+    }
+    fclose(in);
+
+    // only what happened goes into the plot, gnuplot balks at empty files.
+    ofstream plot((prefix + ".plt").c_str());
+    plot << "set terminal postscript landscape" << endl
+         << "set output \"" << prefix << ".ps\"" << endl
+         << "set key on left" << endl
+         << "set xlabel \"msec\"" << endl
+         << "set ylabel \"sequence #\"" << endl;
+    string sep = "plot ";
+    for(int t = 0; t < TRACE_TYPES; t++) {
+        cerr << NAMES[t] << " = " << counts[t] << endl;
+        if(counts[t] == 0) continue;
+        int column = t == TRACE_ACK || t == TRACE_DUPACK ? 3 : 2;
+        plot << sep << "\"" << prefix << "-" << NAMES[t] << ".dat\" using 1:"
+             << column << " title \"" << NAMES[t] << "\" with " << STYLES[t];
+        sep = ", ";
+    }
+    plot << endl;
+    if(counts[TRACE_SEND] + counts[TRACE_ACK] > 0)
+        plot << "set ylabel \"segments\"" << endl
+             << "plot \"" << prefix << "-window.dat\" using 1:2 title "
+             << "\"window\" with steps, \"" << prefix << "-window.dat\" "
+             << "using 1:3 title \"cwnd\" with steps" << endl;
+    return 0;
+}
@@ -6,56 +6,111 @@ Program 3 - TCP Sliding Window
 
 #include "UdpSocket.h"
 #include "Timer.h"
+#include "Sack.h"
+#include "Wire.h"
+#include "Pmtu.h"
+#include "RttEstimator.h"
+#include "CongestionControl.h"
+#include "SlidingWindow.h"
+#include "TraceRing.h"
+#include "TimerWheel.h"
+#include "SeqRing.h"
+#include "ReceiveWindow.h"
+#include "Pacer.h"
 #include "stdlib.h"
 #include "stdio.h"
 
-const int TIMEOUT_USEC = 1500;
-
 bool canRecv(UdpSocket& sock) {
     return sock.pollRecvFrom() > 0;
 }
 
-int recvAck(UdpSocket& sock) {
-    int ackNum;
-    sock.recvFrom((char*)&ackNum, sizeof(int));
-    return ackNum;
+// the ack # of the ack waiting at sock, -1 if it is corrupt.
+int recvAck(UdpSocket& sock, ProtocolStats &stats) {
+    char ack[WIRE_HDR];
+    WireHeader header;
+    int length = sock.recvFrom(ack, WIRE_HDR);
+    if(!wireRead(ack, length, header) || !(header.flags & WIRE_ACK)) {
+        stats.corrupt++;
+        return -1;
+    }
+    return header.ack;
+}
+
+bool isTimeout(Timer& t, RttEstimator& rtt) {
+    return t.lap() >= rtt.rto();
 }
 
-bool isTimeout(Timer& t) {
-    return t.lap() >= TIMEOUT_USEC;
+// wait until sock has data or t passes timeout. busy polls for the first
+// spinUsec (forever if negative), then sleeps in the kernel for the rest.
+bool waitRecv(UdpSocket& sock, Timer& t, long timeout, long spinUsec) {
+    while(spinUsec < 0 || t.lap() < spinUsec) {
+        if(canRecv(sock)) return true;
+        if(t.lap() >= timeout) return false;
+    }
+    long left = timeout - t.lap();
+    if(left <= 0) return canRecv(sock);
+    return sock.waitRecvFrom(left) > 0;
 }
 
 /*==============================================================================
         Stop & Wait Implementation
 */
 
-int clientStopWait( UdpSocket &sock, const int max, int message[] ) {
+int clientStopWait( UdpSocket &sock, const int max, int message[],
+          const SenderOptions &opts, RttEstimator &rtt ) {
     cerr << "client: stop & wait test:" << endl;
 
     int retransmission = 0;
     int ackNum = -1;
     Timer timeout;
+    ProtocolStats untracked;
+    ProtocolStats &stats = opts.stats != NULL ? *opts.stats : untracked;
+    stats.connId = opts.connId;
+    TraceRing &trace = TraceRing::process();
+    // only the header changes from one segment to the next.
+    unsigned int payloadCrc = wirePayloadCrc((char*) message, MSGSIZE);
 
     for ( int i = 0; i < max; i++ ) {
-        message[0] = i; // place sequence # in message[0].
+        wireWrite((char*) message,
+                WireHeader(WIRE_DATA, i, 0, 1, opts.connId), payloadCrc);
+        bool retransmitted = false;
 
         while(ackNum != i) {
             sock.sendTo( ( char * )message, MSGSIZE ); // send the message
+            trace.record(retransmitted ? TRACE_RETRANSMIT : TRACE_SEND, i, i,
+                    1, 0, opts.connId);
+            stats.segmentsSent++;
+            stats.bytesSent += MSGSIZE;
+            if(stats.dumpDue()) stats.json(cerr) << endl;
 
             timeout.start();
 
-            while(!isTimeout(timeout) && !canRecv(sock)) {}
-
             // recv if available, otherwise count the retransmission.
-            if(canRecv(sock)) {
-                ackNum = recvAck(sock);
+            if(waitRecv(sock, timeout, rtt.rto(), opts.spinUsec)) {
+                ackNum = recvAck(sock, stats);
+                if(ackNum < 0) continue;
+                trace.record(ackNum == i ? TRACE_ACK : TRACE_DUPACK, i, ackNum,
+                        1, 0, opts.connId);
+                stats.acksReceived++;
+                if(ackNum == i) {
+                    stats.segmentsDelivered++;
+                    stats.bytesDelivered += MSGSIZE;
+                }
+                // karn: only time acks of segments sent exactly once.
+                if(ackNum == i && !retransmitted) {
+                    long rttNsec = timeout.lapNsec();
+                    rtt.sample(rttNsec / 1000);
+                    if(opts.rtts != NULL) opts.rtts->record(rttNsec);
+                }
             } else {
                 retransmission++;
-                // cerr << "timeout: retransmitting " << i << endl;
+                retransmitted = true;
+                stats.timeouts++;
+                stats.timeoutRetransmits++;
+                rtt.backoff();
+                trace.record(TRACE_TIMEOUT, i, i, 1, 0, opts.connId);
             }
         }
-
-        // cerr << "ack = " << ackNum << " message = " << message[0] << endl;
     }
     return retransmission;
 }
@@ -64,13 +119,17 @@ void serverReliable( UdpSocket &sock, const int max, int message[] ) {
     cerr << "server reliable test:" << endl;
 
     for ( int i = 0; i < max; i++ ) {
-        int ackNum;
+        // corrupt segments are dropped like lost ones.
+        WireHeader header;
+        int length;
         do {
-            sock.recvFrom( ( char * ) message, MSGSIZE );
-            ackNum = message[0];
-        } while(ackNum != i);
-        sock.ackTo( (char*) &ackNum, sizeof(int));
-        cerr << "ack " << ackNum << endl;
+            length = sock.recvFrom( ( char * ) message, MSGSIZE );
+        } while(!wireRead((char*) message, length, header)
+                || header.seq != (unsigned int) i);
+        char ack[WIRE_HDR];
+        wireWrite(ack, WIRE_HDR, WireHeader(WIRE_ACK, i, i, 1, header.connId));
+        sock.ackTo(ack, WIRE_HDR);
+        TraceRing::process().record(TRACE_RECV, i, i + 1, 1, 0, header.connId);
     }
 }
 
@@ -78,90 +137,505 @@ void serverReliable( UdpSocket &sock, const int max, int message[] ) {
         Sliding Window Implementation
 */
 
-int clientSlidingWindow( UdpSocket &sock, const int max, int message[], int windowSize ) {
-    // used to track messages that were already sent.
-    bool sent[max];
-    for(int i=0; i<max; i++) sent[i] = false;
+// resend seqNum, a segment of segSize bytes, right away, outside of the
+//     normal walk through the window, under the rest of header.
+void resend(UdpSocket &sock, int message[], int segSize, unsigned int seqNum,
+        WireHeader header, unsigned int payloadCrc, ProtocolStats &stats) {
+    header.seq = seqNum;
+    wireWrite((char*) message, header, payloadCrc);
+    sock.sendTo( (char*) message, segSize);
+    stats.segmentsSent++;
+    stats.bytesSent += segSize;
+}
+
+// the socket took only the first sent of a batch of count, whose slots go
+//     on from seqs[]: back up nextSeqNum to the first slot left, and take
+//     back the resends (seq #s below batchStart) that never went out. the
+//     new ones left are new again, unless fec coded them already; then they
+//     go as resends and their parity is lost, as on the wire.
+void unsendTail(int sent, int count, const unsigned int seqs[],
+        unsigned int batchStart, bool coded, unsigned int &nextSeqNum,
+        unsigned int &sendMax, int &retransmitted, ProtocolStats &stats) {
+    if(sent < 0) sent = 0;
+    if(sent >= count)
+        return;
+    for(int i = sent; i < count; i++) {
+        if(seqLt(seqs[i], batchStart)) {
+            retransmitted--;
+            stats.timeoutRetransmits--;
+        }
+    }
+    nextSeqNum = seqs[sent];
+    if(!coded)
+        sendMax = seqLt(nextSeqNum, batchStart) ? batchStart : nextSeqNum;
+}
+
+int clientSlidingWindow( UdpSocket &sock, const int max, int message[], int windowSize,
+          const SenderOptions &opts, RttEstimator &rtt, CongestionControl &cc ) {
+    // per segment state lives in rings one window long, indexed by seq #.
+    // used to skip rtt samples of retransmitted messages (karn's rule).
+    SeqRing resent(windowSize);
+    // used to track messages the server selectively acked past the base.
+    SeqRing sacked(windowSize);
+    // time each message was last sent at in nsec, relative to clock.
+    long *sentAt = new long[resent.capacity()];
+
+    // a copy of message per batch slot, so a whole window goes out in one
+    //     sendBatch() and only the header differs between slots. with
+    //     fec, parity is written into the slots after a group's last segment.
+    //     slots are whole ints, parity headers are read as such.
+    int segSize = opts.segSize;
+    int slotInts = (segSize + FECHDR + 3) / 4;
+    int *batch = new int[MAXBATCH * slotInts];
+    char *batchPtrs[MAXBATCH];
+    int batchLengths[MAXBATCH];
+    // the seq # to go on from if a slot doesn't go out: its own for a
+    //     segment, the next one for the parity after it.
+    unsigned int batchSeqs[MAXBATCH];
+    // so the payload is checksummed once, not once per segment.
+    unsigned int payloadCrc = wirePayloadCrc((char*) message, segSize);
+    for(int i=0; i<MAXBATCH; i++) {
+        batchPtrs[i] = (char*) (batch + i * slotInts);
+        memcpy(batchPtrs[i], message, segSize);
+        batchLengths[i] = segSize;
+    }
+    // per segment retransmission timers, used with perSegmentTimersOn.
+    TimerWheel wheel(WHEEL_TICK);
+    TimerWheel::Entry *timers = new TimerWheel::Entry[resent.capacity()];
+
+    // all pending acks are drained into these with one recvBatch().
+    SackAck acks[MAXBATCH];
+    char *ackPtrs[MAXBATCH];
+    int ackLengths[MAXBATCH];
+    for(int i=0; i<MAXBATCH; i++) ackPtrs[i] = (char*) &acks[i];
 
     int retransmitted   = 0;
-    int base            = 0; // start of the window
-    int nextSeqNum      = 0; // expected sequence number.
+    unsigned int end    = opts.isn + max; // one past the last sequence #.
+    unsigned int base   = opts.isn; // start of the window
+    unsigned int nextSeqNum = opts.isn; // expected sequence number.
+    unsigned int sendMax = opts.isn; // one past the highest seq # ever sent.
+    int dupAcks         = 0; // repeats of the current base ack in a row.
+    bool inRecovery     = false; // fast recovery after a fast retransmit.
+    unsigned int recover = 0; // recovery ends once this is cumulatively acked.
+    // with fec, a hole may still be rebuilt from parity up to a group later,
+    //     so it takes that many more duplicate acks to resend it.
+    int dupThreshold = DUPACK_THRESHOLD;
+    if(opts.fec != NULL) dupThreshold += opts.fec->groupSize();
+    // room left in a batch for the parity of the last segment in it.
+    int parityRoom = opts.fec != NULL ? FEC_MAXK : 0;
     Timer timer;
-
-    while(nextSeqNum < max || base < max) {
-        // fprintf(stderr, "window = %d, base = %d, nextSeqNum = %d, base+windowSize = %d\n", windowSize, base, nextSeqNum, base+windowSize);
+    Timer clock;
+    clock.start();
+    // counted into opts.stats, or where nobody looks without it.
+    ProtocolStats untracked;
+    ProtocolStats &stats = opts.stats != NULL ? *opts.stats : untracked;
+    stats.connId = opts.connId;
+    long limitedSince = -1; // when the window filled up, -1: it isn't full.
+    TraceRing &trace = TraceRing::process();
+
+    while(seqLt(nextSeqNum, end) || seqLt(base, end)) {
+        // the congestion window, capped by windowSize.
+        int window = cc.window() < windowSize ? cc.window() : windowSize;
+        WireHeader header(WIRE_DATA, 0, 0, window, opts.connId);
+        if(stats.dumpDue()) stats.json(cerr) << endl;
+
+        // the clock is only read when the window fills up or opens again.
+        bool limited = seqLt(nextSeqNum, end)
+                && !seqLt(nextSeqNum, base + window);
+        if(limited != (limitedSince >= 0)) {
+            if(limited) {
+                stats.windowStalls++;
+                limitedSince = clock.lap();
+            } else {
+                stats.windowLimitedUsec += clock.lap() - limitedSince;
+                limitedSince = -1;
+            }
+        }
 
         // in window & not finished transmitting.
-        if(nextSeqNum < base + windowSize && nextSeqNum < max) {
-            message[0] = nextSeqNum; // place sequence # in message[0].
-            // cerr << "send seq # = " << nextSeqNum << endl;
-            sock.sendTo( (char*) message, MSGSIZE);
-
-            // if the packets has already been sent, count as a retransmission.
-            if(sent[nextSeqNum]) retransmitted++;
-            sent[nextSeqNum] = true;
+        bool canSend = seqLt(nextSeqNum, base + window) && seqLt(nextSeqNum, end);
+        // with a pacer, only as many as its tokens allow go out at once.
+        int allowance = MAXBATCH;
+        if(canSend && opts.pacer != NULL) {
+            opts.pacer->setRate(window, rtt.srtt());
+            allowance = opts.pacer->allowance(clock.lap());
+        }
+        bool paced = canSend && allowance == 0;
+
+        if(canSend && !paced) {
+            // queue up everything the window and the pacer allow.
+            int count = 0;
+            unsigned int batchStart = sendMax; // resends are those below
+            long nowNsec = clock.lapNsec();
+            long now = nowNsec / 1000;
+            while(seqLt(nextSeqNum, base + window) && seqLt(nextSeqNum, end)
+                    && count + parityRoom < MAXBATCH && count < allowance) {
+                // with sack, skip over what the server already holds so
+                //     only the holes are resent after a timeout.
+                if(opts.sackOn && sacked.test(nextSeqNum)) {
+                    nextSeqNum++;
+                    continue;
+                }
+                if(batchLengths[count] != segSize) { // held parity last time
+                    memcpy(batchPtrs[count], message, segSize);
+                    batchLengths[count] = segSize;
+                }
+                header.seq = nextSeqNum;
+                batchSeqs[count] = nextSeqNum;
+                wireWrite(batchPtrs[count++], header, payloadCrc);
+
+                // if the packets has already been sent, count as a retransmission.
+                if(seqLt(nextSeqNum, sendMax)) {
+                    retransmitted++;
+                    stats.timeoutRetransmits++; // go-back-n after an rto
+                    resent.set(nextSeqNum);
+                    trace.record(TRACE_RETRANSMIT, nextSeqNum, base, window,
+                            cc.window(), opts.connId);
+                } else {
+                    sendMax = nextSeqNum + 1;
+                    trace.record(TRACE_SEND, nextSeqNum, base, window,
+                            cc.window(), opts.connId);
+                    // code it the first time only, and follow a full group
+                    //     (or the last one) with its parity.
+                    if(opts.fec != NULL) {
+                        char *parity[FEC_MAXK];
+                        for(int j = 0; j < FEC_MAXK; j++)
+                            parity[j] = batchPtrs[count + j];
+                        int made = opts.fec->add(batchPtrs[count - 1],
+                                sendMax == end, parity);
+                        for(int j = 0; j < made; j++) {
+                            batchSeqs[count] = nextSeqNum + 1;
+                            batchLengths[count++] = segSize + FECHDR;
+                        }
+                    }
+                }
+                sentAt[resent.slot(nextSeqNum)] = nowNsec;
+                if(opts.perSegmentTimersOn) {
+                    timers[resent.slot(nextSeqNum)].id = nextSeqNum;
+                    wheel.schedule(timers[resent.slot(nextSeqNum)], now + rtt.rto());
+                }
 
-            nextSeqNum++;
+                nextSeqNum++;
+            }
+            int sent = sock.sendBatch(batchPtrs, batchLengths, count);
+            unsendTail(sent, count, batchSeqs, batchStart, opts.fec != NULL,
+                    nextSeqNum, sendMax, retransmitted, stats);
+            stats.sent(batchLengths, sent);
+            if(opts.pacer != NULL) opts.pacer->sent(sent, now);
         }
         // outside window
         else {
+            // a hole at the base holds the window shut before the group
+            //     being coded fills up: send its parity now, not never.
+            if(opts.fec != NULL && !canSend && dupAcks > 0) {
+                int made = opts.fec->flush(batchPtrs);
+                for(int j = 0; j < made; j++)
+                    batchLengths[j] = segSize + FECHDR;
+                sock.sendBatch(batchPtrs, batchLengths, made);
+                stats.sent(batchLengths, made);
+                if(opts.pacer != NULL) opts.pacer->charge(made, clock.lap());
+            }
             timer.start();
             bool windowMoved = false;
 
-            // wait for either a timeout or an ack recv.
-            while(!isTimeout(timer) & !canRecv(sock)) {}
+            // with per segment timers, wait no longer than the first expiry.
+            long timeout = rtt.rto();
+            if(opts.perSegmentTimersOn && wheel.nextDeadline() >= 0)
+                timeout = wheel.nextDeadline() - clock.lap();
+            // held back by the pacer: sleep only until it lets one go.
+            if(paced) {
+                long release = opts.pacer->nextRelease(clock.lap());
+                if(release < timeout) timeout = release;
+            }
 
-            // ack received.
-            if(canRecv(sock)) {
-                int ack = recvAck(sock);
-                // cerr << "receive ACK " << ack << endl;
-                if(ack > base) {
+            // wait for either a timeout or acks, taking all that are pending.
+            int ackCount = 0;
+            if(waitRecv(sock, timer, timeout, opts.spinUsec))
+                ackCount = sock.recvBatch(ackPtrs, sizeof(SackAck),
+                        ackLengths, MAXBATCH, false);
+
+            // acks received.
+            long ackedNsec = clock.lapNsec();
+            stats.acksReceived += ackCount;
+            for(int a = 0; a < ackCount; a++) {
+                SackAck &sackAck = acks[a];
+                int length = ackLengths[a];
+                WireHeader ackHeader;
+                if(!wireRead(sackAck.header, length, ackHeader)
+                        || !(ackHeader.flags & WIRE_ACK)) {
+                    stats.corrupt++;
+                    continue;
+                }
+                // left over from another transfer, or from probing.
+                if(ackHeader.connId != opts.connId
+                        || (ackHeader.flags & WIRE_PROBE)) continue;
+                unsigned int ack = ackHeader.ack;
+
+                // stale (before the base) or bogus (past anything sent).
+                if(seqLt(ack, base) || seqGt(ack, sendMax)) continue;
+
+                if(opts.sackOn)
+                    applySackAck(sackAck, length, ackHeader, sacked, sendMax);
+                if(seqGt(ack, base)) {
+                    trace.record(TRACE_ACK, base, ack, window, cc.window(),
+                            opts.connId);
+                    stats.segmentsDelivered += seqDiff(ack, base);
+                    stats.bytesDelivered += (long) seqDiff(ack, base) * segSize;
+                    if(opts.fec != NULL) opts.fec->observe(seqDiff(ack, base), 0);
+                    // the newest segment covered is the one that was acked,
+                    //     unless a resent hole filler may have triggered it.
+                    bool ambiguous = false;
+                    for(unsigned int i = base; i != ack && !ambiguous; i++)
+                        ambiguous = resent.test(i);
+                    // the older ones it covers waited behind a hole or a
+                    //     delayed ack, which is no part of their rtt.
+                    if(!ambiguous) {
+                        long rttNsec = ackedNsec - sentAt[resent.slot(ack - 1)];
+                        rtt.sample(rttNsec / 1000);
+                        if(opts.rtts != NULL) opts.rtts->record(rttNsec);
+                    }
+
+                    // a partial ack in recovery points at the next hole:
+                    //     resend it now instead of waiting for a timeout.
+                    bool partial = inRecovery && seqLt(ack, recover);
+                    if(partial) {
+                        cc.onPartialAck(seqDiff(ack, base), clock.lap());
+                    } else {
+                        cc.onAck(seqDiff(ack, base), clock.lap(), rtt.srtt());
+                        inRecovery = false;
+                    }
+
+                    // free the acked slots for the next lap of the rings.
+                    for(unsigned int i = base; i != ack; i++)
+                        wheel.cancel(timers[resent.slot(i)]);
+                    resent.resetRange(base, ack);
+                    sacked.resetRange(base, ack);
                     base = ack;
+                    if(seqLt(nextSeqNum, base)) nextSeqNum = base;
+                    dupAcks = 0;
                     windowMoved = true;
+
+                    if(partial) {
+                        resend(sock, message, segSize, base, header,
+                                payloadCrc, stats);
+                        trace.record(TRACE_FASTRETRANSMIT, base, base, window,
+                                cc.window(), opts.connId);
+                        if(opts.pacer != NULL) opts.pacer->charge(1, clock.lap());
+                        retransmitted++;
+                        stats.fastRetransmits++;
+                        resent.set(base);
+                        sentAt[resent.slot(base)] = clock.lapNsec();
+                        if(opts.perSegmentTimersOn) {
+                            timers[resent.slot(base)].id = base;
+                            wheel.schedule(timers[resent.slot(base)],
+                                    sentAt[resent.slot(base)] / 1000 + rtt.rto());
+                        }
+                    }
+                }
+                // the same ack again while data is outstanding.
+                else if(seqGt(nextSeqNum, base)) {
+                    dupAcks++;
+                    stats.dupAcks++;
+                    trace.record(TRACE_DUPACK, base, ack, window, cc.window(),
+                            opts.connId);
+                    cc.onDupAck(dupAcks, clock.lap());
+                    // a new hole at the base, fec sizes its parity by these.
+                    if(opts.fec != NULL && dupAcks == 1) opts.fec->observe(0, 1);
+
+                    // fast retransmit: the base is lost, don't wait for it.
+                    if(opts.fastRetransmitOn && !inRecovery
+                            && dupAcks == dupThreshold) {
+                        inRecovery = true;
+                        recover = nextSeqNum;
+                        cc.onFastRetransmit(clock.lap());
+                        resend(sock, message, segSize, base, header,
+                                payloadCrc, stats);
+                        trace.record(TRACE_FASTRETRANSMIT, base, base, window,
+                                cc.window(), opts.connId);
+                        if(opts.pacer != NULL) opts.pacer->charge(1, clock.lap());
+                        retransmitted++;
+                        stats.fastRetransmits++;
+                        resent.set(base);
+                        sentAt[resent.slot(base)] = clock.lapNsec();
+                        if(opts.perSegmentTimersOn) {
+                            timers[resent.slot(base)].id = base;
+                            wheel.schedule(timers[resent.slot(base)],
+                                    sentAt[resent.slot(base)] / 1000 + rtt.rto());
+                        }
+                    }
+                }
+            }
+            // per segment timeouts: resend just the segments whose own timer
+            //     ran out and that the server doesn't hold yet.
+            if(opts.perSegmentTimersOn) {
+                wheel.expire(clock.lap());
+                TimerWheel::Entry *e;
+                while((e = wheel.popExpired()) != NULL) {
+                    unsigned int seqNum = e->id;
+                    if(seqLt(seqNum, base) || sacked.test(seqNum)) continue;
+                    // only the base expiring counts as an rto event, so the
+                    //     backoff doubles once per rto, not once per segment.
+                    if(seqNum == base) {
+                        stats.timeouts++;
+                        trace.record(TRACE_TIMEOUT, base, base, window,
+                                cc.window(), opts.connId);
+                        rtt.backoff();
+                        cc.onTimeout(clock.lap());
+                        dupAcks = 0;
+                        inRecovery = false;
+                    }
+                    resend(sock, message, segSize, seqNum, header, payloadCrc,
+                            stats);
+                    trace.record(TRACE_RETRANSMIT, seqNum, base, window,
+                            cc.window(), opts.connId);
+                    if(opts.pacer != NULL) opts.pacer->charge(1, clock.lap());
+                    retransmitted++;
+                    stats.timeoutRetransmits++;
+                    resent.set(seqNum);
+                    sentAt[resent.slot(seqNum)] = clock.lapNsec();
+                    wheel.schedule(*e, sentAt[resent.slot(seqNum)] / 1000
+                            + rtt.rto());
                 }
             }
-            // timeout
-            else {
+            // timeout, unless the wait was only the pacer's.
+            else if(ackCount == 0 && !paced) {
                 if(!windowMoved) {
-                    // cerr << "timeout base = " << base << endl;
+                    trace.record(TRACE_TIMEOUT, base, base, window,
+                            cc.window(), opts.connId);
                     nextSeqNum = base;
+                    stats.timeouts++;
+                    rtt.backoff();
+                    cc.onTimeout(clock.lap());
+                    dupAcks = 0;
+                    inRecovery = false;
                 }
             }
         }
     }
+    if(limitedSince >= 0)
+        stats.windowLimitedUsec += clock.lap() - limitedSince;
+    delete[] timers;
+    delete[] sentAt;
+    delete[] batch;
     return retransmitted;
 }
 
 void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
-          int windowSize) {
+          int windowSize, const ReceiverOptions &opts) {
     cerr << "server: early retransmit test:" << endl;
     cerr << "start window size = " << windowSize << endl;
-    // used to track all received packets.
-    bool packets[max];
-    for(int i=0; i<max; i++) packets[i] = false;
-
-    int expectedSeqNum = 0;
+    // expectedSeqNum and the packets received past it, one window's worth.
+    ReceiveWindow window(windowSize, opts.isn, max);
+    window.delayAcks(opts.ackEvery, opts.ackDelay);
+    ProtocolStats untracked;
+    ProtocolStats &stats = opts.stats != NULL ? *opts.stats : untracked;
+    window.track(stats);
+    // copies of the data segments and parity lost ones are rebuilt from.
+    FecDecoder *fec = opts.fecOn ? new FecDecoder(windowSize, opts.segSize)
+                                 : NULL;
+    unsigned int repaired[FEC_MAXK];
+    TraceRing &trace = TraceRing::process();
+
+    // everything pending is received with one recvBatch(), and the acks
+    //     for it go back with one ackBatch(). slots hold a segment or its
+    //     parity, in whole ints.
+    int slotSize = (opts.segSize + FECHDR + 3) / 4 * 4;
+    int *batch = new int[MAXBATCH * slotSize / 4];
+    char *batchPtrs[MAXBATCH];
+    int batchLengths[MAXBATCH];
+    SackAck acks[MAXBATCH];
+    char *ackPtrs[MAXBATCH];
+    int ackLengths[MAXBATCH];
+    for(int i=0; i<MAXBATCH; i++) {
+        batchPtrs[i] = (char*) batch + i * slotSize;
+        ackPtrs[i] = (char*) &acks[i];
+    }
 
-    while(expectedSeqNum < max) {
-        sock.recvFrom( (char*) message, MSGSIZE);
-        int seqNum = message[0];
+    while(!window.done()) {
+        if(opts.stats != NULL && opts.stats->dumpDue()) opts.stats->json(cerr) << endl;
 
-        // fprintf(stderr,"window = %d, seqNo = %d, received = %d\n", windowSize, expectedSeqNum, seqNum);
+        // a delayed ack goes out on its own if nothing arrives before it's due.
+        long due = window.ackDue();
+        if(due >= 0 && sock.waitRecvFrom(due) <= 0) {
+            ackLengths[0] = window.dueAck(acks[0]);
+            if(ackLengths[0] > 0) sock.ackBatch(ackPtrs, ackLengths, 1);
+            continue;
+        }
 
-        packets[seqNum] = true;
-        if(seqNum == expectedSeqNum) {
-            // fast forward expectedSeqNum to be the 
-            //     next unreceived (false) packet.
-            while(expectedSeqNum < max && packets[expectedSeqNum])
-                expectedSeqNum++;
+        int count = sock.recvBatch(batchPtrs, slotSize, batchLengths,
+                MAXBATCH, true);
+        int ackCount = 0;
+
+        for(int i = 0; i < count; i++) {
+            char *datagram = batchPtrs[i];
+            bool parity = fec != NULL
+                    && isParity(datagram, batchLengths[i], opts.segSize);
+            WireHeader header;
+            if(!parity && !wireRead(datagram, batchLengths[i], header)) {
+                stats.corrupt++;
+                continue;
+            }
+            // a path mtu probe is answered, not taken in.
+            int probeLength = parity ? 0
+                    : answerProbe(header, acks[ackCount].header);
+            if(probeLength > 0) {
+                ackLengths[ackCount++] = probeLength;
+                continue;
+            }
+            unsigned int seqNum = header.seq;
+
+            // data is taken in as usual, parity only when it fills holes.
+            //     one ack, the last, answers the segment and all it rebuilt.
+            int rebuilt = 0;
+            int length = 0;
+            if(parity) {
+                rebuilt = fec->parity(datagram, window.expected(), repaired);
+            } else {
+                if(fec != NULL)
+                    rebuilt = fec->data(seqNum, datagram, window.expected(),
+                            repaired);
+                window.setConnId(header.connId); // acks echo it
+                length = window.receive(seqNum, batchLengths[i],
+                        acks[ackCount]);
+                trace.record(TRACE_RECV, seqNum, window.expected(), windowSize,
+                        0, header.connId);
+            }
+            for(int r = 0; r < rebuilt; r++) {
+                int rebuiltLength = window.receive(repaired[r], opts.segSize,
+                        acks[ackCount]);
+                if(rebuiltLength > 0) length = rebuiltLength;
+            }
+            if(length > 0) ackLengths[ackCount++] = length;
+        }
+        if(ackCount < MAXBATCH) {
+            ackLengths[ackCount] = window.dueAck(acks[ackCount]);
+            if(ackLengths[ackCount] > 0) ackCount++;
         }
+        sock.ackBatch(ackPtrs, ackLengths, ackCount);
+    }
 
-        int ackNum = expectedSeqNum;
-        // ack a valid packet.
-        if(ackNum <= max) {
-            sock.ackTo((char*) &ackNum, sizeof(ackNum));
+    // the last acks can be lost on the way back, so keep answering the
+    //     client's retransmissions with the final ack until it goes quiet.
+    while(opts.lingerUsec > 0 && sock.waitRecvFrom(opts.lingerUsec) > 0) {
+        int count = sock.recvBatch(batchPtrs, slotSize, batchLengths,
+                MAXBATCH, false);
+        int ackCount = 0;
+        for(int i = 0; i < count; i++) {
+            WireHeader header;
+            if(!wireRead(batchPtrs[i], batchLengths[i], header)
+                    || (header.flags & WIRE_PROBE)) continue;
+            ackLengths[ackCount] = window.receive(header.seq, batchLengths[i],
+                    acks[ackCount]);
+            if(ackLengths[ackCount] > 0) ackCount++;
         }
+        sock.ackBatch(ackPtrs, ackLengths, ackCount);
     }
 
-    cerr << "finish window size = " << windowSize << endl;
+    cerr << "finish window size = " << windowSize << " acks = "
+         << window.acks() << endl;
+    delete[] batch;
+    if(fec != NULL) {
+        cerr << "rebuilt = " << fec->rebuilt() << endl;
+        delete fec;
+    }
 }
@@ -6,61 +6,136 @@ Program 3 - TCP Sliding Window
 
 #include "UdpSocket.h"
 #include "Timer.h"
+#include "Sack.h"
+#include "Wire.h"
+#include "Pmtu.h"
+#include "RttEstimator.h"
+#include "CongestionControl.h"
+#include "SlidingWindow.h"
+#include "TraceRing.h"
+#include "TimerWheel.h"
+#include "SeqRing.h"
+#include "ReceiveWindow.h"
+#include "Pacer.h"
+#include "SessionTable.h"
+#include "Impairment.h"
 #include "stdlib.h"
 #include "stdio.h"
 #include <cstdlib>
+#include <atomic>
+#include <pthread.h>
 
-const int TIMEOUT_USEC = 1500;
+// a server's drop percent is independent loss on what its socket receives,
+//     from a generator seeded with this plus the percent (and a run's own
+//     seed), so the same segments are lost every time a test is rerun.
+const unsigned long DROP_SEED = 432;
 
-bool isRandomDrop(int percent) {
-    return rand() % 100 < percent;
+// a shut window is probed after an rto, then after twice that and so on,
+//     doubling at most this many times.
+const int PERSIST_BACKOFFS = 6;
+
+// install that loss on sock for as long as drops lives, unless sock already
+//     has a simulated link of its own. returns what to put back afterwards.
+Impairment *dropOn(UdpSocket &sock, Impairment &drops, int dropPercent) {
+    Impairment *link = sock.impairment();
+    if(link == NULL && dropPercent > 0) {
+        drops.bernoulli(dropPercent / 100.0);
+        sock.impair(&drops);
+    }
+    return link;
 }
 
 bool canRecv(UdpSocket& sock) {
     return sock.pollRecvFrom() > 0;
 }
 
-int recvAck(UdpSocket& sock) {
-    int ackNum;
-    sock.recvFrom((char*)&ackNum, sizeof(int));
-    return ackNum;
+// the ack # of the ack waiting at sock, -1 if it is corrupt.
+int recvAck(UdpSocket& sock, ProtocolStats &stats) {
+    char ack[WIRE_HDR];
+    WireHeader header;
+    int length = sock.recvFrom(ack, WIRE_HDR);
+    if(!wireRead(ack, length, header) || !(header.flags & WIRE_ACK)) {
+        stats.corrupt++;
+        return -1;
+    }
+    return header.ack;
+}
+
+bool isTimeout(Timer& t, RttEstimator& rtt) {
+    return t.lap() >= rtt.rto();
 }
 
-bool isTimeout(Timer& t) {
-    return t.lap() >= TIMEOUT_USEC;
+// wait until sock has data or t passes timeout. busy polls for the first
+// spinUsec (forever if negative), then sleeps in the kernel for the rest.
+bool waitRecv(UdpSocket& sock, Timer& t, long timeout, long spinUsec) {
+    while(spinUsec < 0 || t.lap() < spinUsec) {
+        if(canRecv(sock)) return true;
+        if(t.lap() >= timeout) return false;
+    }
+    long left = timeout - t.lap();
+    if(left <= 0) return canRecv(sock);
+    return sock.waitRecvFrom(left) > 0;
 }
 
 /*==============================================================================
         Stop & Wait Implementation
 */
 
-int clientStopWait( UdpSocket &sock, const int max, int message[] ) {
+int clientStopWait( UdpSocket &sock, const int max, int message[],
+          const SenderOptions &opts, RttEstimator &rtt ) {
     cerr << "client: stop & wait test:" << endl;
 
     int retransmission = 0;
     int ackNum = -1;
     Timer timeout;
+    ProtocolStats untracked;
+    ProtocolStats &stats = opts.stats != NULL ? *opts.stats : untracked;
+    stats.connId = opts.connId;
+    TraceRing &trace = TraceRing::process();
+    // only the header changes from one segment to the next.
+    unsigned int payloadCrc = wirePayloadCrc((char*) message, MSGSIZE);
 
     for ( int i = 0; i < max; i++ ) {
-        message[0] = i; // place sequence # in message[0].
+        wireWrite((char*) message,
+                WireHeader(WIRE_DATA, i, 0, 1, opts.connId), payloadCrc);
+        bool retransmitted = false;
 
         while(ackNum != i) {
             sock.sendTo( ( char * )message, MSGSIZE ); // send the message
+            trace.record(retransmitted ? TRACE_RETRANSMIT : TRACE_SEND, i, i,
+                    1, 0, opts.connId);
+            stats.segmentsSent++;
+            stats.bytesSent += MSGSIZE;
+            if(stats.dumpDue()) stats.json(cerr) << endl;
 
             timeout.start();
 
-            while(!isTimeout(timeout) && !canRecv(sock)) {}
-
             // recv if available, otherwise count the retransmission.
-            if(canRecv(sock)) {
-                ackNum = recvAck(sock);
+            if(waitRecv(sock, timeout, rtt.rto(), opts.spinUsec)) {
+                ackNum = recvAck(sock, stats);
+                if(ackNum < 0) continue;
+                trace.record(ackNum == i ? TRACE_ACK : TRACE_DUPACK, i, ackNum,
+                        1, 0, opts.connId);
+                stats.acksReceived++;
+                if(ackNum == i) {
+                    stats.segmentsDelivered++;
+                    stats.bytesDelivered += MSGSIZE;
+                }
+                // karn: only time acks of segments sent exactly once.
+                if(ackNum == i && !retransmitted) {
+                    long rttNsec = timeout.lapNsec();
+                    rtt.sample(rttNsec / 1000);
+                    if(opts.rtts != NULL) opts.rtts->record(rttNsec);
+                }
             } else {
                 retransmission++;
-                // cerr << "timeout: retransmitting " << i << endl;
+                retransmitted = true;
+                stats.timeouts++;
+                stats.timeoutRetransmits++;
+                rtt.backoff();
+                trace.record(TRACE_TIMEOUT, i, i, 1, 0, opts.connId);
             }
         }
-
-        // cerr << "ack = " << ackNum << " message = " << message[0] << endl;
     }
     return retransmission;
 }
@@ -69,13 +144,17 @@ void serverReliable( UdpSocket &sock, const int max, int message[] ) {
     cerr << "server reliable test:" << endl;
 
     for ( int i = 0; i < max; i++ ) {
-        int ackNum;
+        // corrupt segments are dropped like lost ones.
+        WireHeader header;
+        int length;
         do {
-            sock.recvFrom( ( char * ) message, MSGSIZE );
-            ackNum = message[0];
-        } while(ackNum != i);
-        sock.ackTo( (char*) &ackNum, sizeof(int));
-        cerr << "ack " << ackNum << endl;
+            length = sock.recvFrom( ( char * ) message, MSGSIZE );
+        } while(!wireRead((char*) message, length, header)
+                || header.seq != (unsigned int) i);
+        char ack[WIRE_HDR];
+        wireWrite(ack, WIRE_HDR, WireHeader(WIRE_ACK, i, i, 1, header.connId));
+        sock.ackTo(ack, WIRE_HDR);
+        TraceRing::process().record(TRACE_RECV, i, i + 1, 1, 0, header.connId);
     }
 }
 
@@ -83,91 +162,975 @@ void serverReliable( UdpSocket &sock, const int max, int message[] ) {
         Sliding Window Implementation
 */
 
-int clientSlidingWindow( UdpSocket &sock, const int max, int message[], int windowSize ) {
-    // used to track messages that were already sent.
-    bool sent[max];
-    for(int i=0; i<max; i++) sent[i] = false;
+// a client's opts.source cut into segments. each payload goes out straight
+//     from the source under a header of its own per window slot, as a zero
+//     copy send may still read it after sendBatch() returns, and its crc is
+//     taken on the first send only. a last payload the source ends short of
+//     goes out zero padded from tail, so every segment is segSize and the
+//     server places each one by its seq # alone.
+struct Source {
+    Source(const SenderOptions &opts, int max, int capacity)
+        : opts(opts), payloadSize(opts.segSize - WIRE_HDR),
+          mask(capacity - 1) {
+        heads = new char[capacity * WIRE_HDR];
+        crcs = new unsigned int[capacity];
+        tail = new char[payloadSize];
+        memset(tail, 0, payloadSize);
+        long last = (long) (max - 1) * payloadSize;
+        if(max > 0 && last < opts.sourceLength)
+            memcpy(tail, opts.source + last, opts.sourceLength - last);
+    }
+    ~Source() {
+        delete[] heads;
+        delete[] crcs;
+        delete[] tail;
+    }
+    char *head(unsigned int seqNum) {
+        return heads + (seqNum & mask) * WIRE_HDR;
+    }
+    char *payload(unsigned int seqNum) {
+        long offset = (long) (seqNum - opts.isn) * payloadSize;
+        return offset + payloadSize <= opts.sourceLength
+                ? (char *) opts.source + offset : tail;
+    }
+    unsigned int &crc(unsigned int seqNum) {
+        return crcs[seqNum & mask];
+    }
+
+    const SenderOptions &opts;
+    int payloadSize;
+    unsigned int mask;         // window slots - 1, a power of two
+    char *heads;
+    unsigned int *crcs;
+    char *tail;
+};
+
+// resend seqNum, a segment of segSize bytes, right away, outside of the
+//     normal walk through the window, under the rest of header. its payload
+//     is message's, or with a source its own.
+void resend(UdpSocket &sock, int message[], Source *source, int segSize,
+        unsigned int seqNum, WireHeader header, unsigned int payloadCrc,
+        ProtocolStats &stats) {
+    header.seq = seqNum;
+    char *head = (char*) message;
+    char *body = NULL;
+    if(source != NULL) {
+        head = source->head(seqNum);
+        body = source->payload(seqNum);
+        payloadCrc = source->crc(seqNum);
+    }
+    wireWrite(head, header, payloadCrc);
+    if(body == NULL)
+        sock.sendTo(head, segSize);
+    else
+        sock.sendBatch(&head, WIRE_HDR, &body, &segSize, 1);
+    stats.segmentsSent++;
+    stats.bytesSent += segSize;
+}
+
+// the socket took only the first sent of a batch of count, whose slots go
+//     on from seqs[]: back up nextSeqNum to the first slot left, and take
+//     back the resends (seq #s below batchStart) that never went out. the
+//     new ones left are new again, unless fec coded them already; then they
+//     go as resends and their parity is lost, as on the wire.
+void unsendTail(int sent, int count, const unsigned int seqs[],
+        unsigned int batchStart, bool coded, unsigned int &nextSeqNum,
+        unsigned int &sendMax, int &retransmitted, ProtocolStats &stats) {
+    if(sent < 0) sent = 0;
+    if(sent >= count)
+        return;
+    for(int i = sent; i < count; i++) {
+        if(seqLt(seqs[i], batchStart)) {
+            retransmitted--;
+            stats.timeoutRetransmits--;
+        }
+    }
+    nextSeqNum = seqs[sent];
+    if(!coded)
+        sendMax = seqLt(nextSeqNum, batchStart) ? batchStart : nextSeqNum;
+}
+
+int clientSlidingWindow( UdpSocket &sock, const int max, int message[], int windowSize,
+          const SenderOptions &opts, RttEstimator &rtt, CongestionControl &cc ) {
+    // per segment state lives in rings one window long, indexed by seq #.
+    // used to skip rtt samples of retransmitted messages (karn's rule).
+    SeqRing resent(windowSize);
+    // used to track messages the server selectively acked past the base.
+    SeqRing sacked(windowSize);
+    // time each message was last sent at in nsec, relative to clock.
+    long *sentAt = new long[resent.capacity()];
+
+    // a copy of message per batch slot, so a whole window goes out in one
+    //     sendBatch() and only the header differs between slots. with
+    //     fec, parity is written into the slots after a group's last segment.
+    //     slots are whole ints, parity headers are read as such.
+    int segSize = opts.segSize;
+    int slotInts = (segSize + FECHDR + 3) / 4;
+    int *batch = new int[MAXBATCH * slotInts];
+    char *batchPtrs[MAXBATCH];
+    int batchLengths[MAXBATCH];
+    // the seq # to go on from if a slot doesn't go out: its own for a
+    //     segment, the next one for the parity after it.
+    unsigned int batchSeqs[MAXBATCH];
+    // so the payload is checksummed once, not once per segment.
+    unsigned int payloadCrc = wirePayloadCrc((char*) message, segSize);
+    for(int i=0; i<MAXBATCH; i++) {
+        batchPtrs[i] = (char*) (batch + i * slotInts);
+        memcpy(batchPtrs[i], message, segSize);
+        batchLengths[i] = segSize;
+    }
+    // with a source, what each message of a batch starts with and its
+    //     payload apart, unless fec needs the segment whole in its slot.
+    Source *source = opts.source != NULL
+            ? new Source(opts, max, resent.capacity()) : NULL;
+    char *sendPtrs[MAXBATCH];
+    char *bodies[MAXBATCH];
+    for(int i=0; i<MAXBATCH; i++) {
+        sendPtrs[i] = batchPtrs[i];
+        bodies[i] = NULL;
+    }
+    // per segment retransmission timers, used with perSegmentTimersOn.
+    TimerWheel wheel(WHEEL_TICK);
+    TimerWheel::Entry *timers = new TimerWheel::Entry[resent.capacity()];
+
+    // all pending acks are drained into these with one recvBatch().
+    SackAck acks[MAXBATCH];
+    char *ackPtrs[MAXBATCH];
+    int ackLengths[MAXBATCH];
+    for(int i=0; i<MAXBATCH; i++) ackPtrs[i] = (char*) &acks[i];
 
     int retransmitted   = 0;
-    int base            = 0; // start of the window
-    int nextSeqNum      = 0; // expected sequence number.
+    unsigned int end    = opts.isn + max; // one past the last sequence #.
+    unsigned int base   = opts.isn; // start of the window
+    unsigned int nextSeqNum = opts.isn; // expected sequence number.
+    unsigned int sendMax = opts.isn; // one past the highest seq # ever sent.
+    int dupAcks         = 0; // repeats of the current base ack in a row.
+    bool inRecovery     = false; // fast recovery after a fast retransmit.
+    unsigned int recover = 0; // recovery ends once this is cumulatively acked.
+    // with fec, a hole may still be rebuilt from parity up to a group later,
+    //     so it takes that many more duplicate acks to resend it.
+    int dupThreshold = DUPACK_THRESHOLD;
+    if(opts.fec != NULL) dupThreshold += opts.fec->groupSize();
+    // room left in a batch for the parity of the last segment in it.
+    int parityRoom = opts.fec != NULL ? FEC_MAXK : 0;
     Timer timer;
+    Timer clock;
+    clock.start();
+    // counted into opts.stats, or where nobody looks without it.
+    ProtocolStats untracked;
+    ProtocolStats &stats = opts.stats != NULL ? *opts.stats : untracked;
+    stats.connId = opts.connId;
+    long limitedSince = -1; // when the window filled up, -1: it isn't full.
+    TraceRing &trace = TraceRing::process();
+    // one past the last seq # the server has room for, as its acks say.
+    unsigned int peerEdge = opts.isn + windowSize;
+    int probes = 0; // sent since the server's window last shut.
 
-    while(nextSeqNum < max || base < max) {
-        // fprintf(stderr, "window = %d, base = %d, nextSeqNum = %d, base+windowSize = %d\n", windowSize, base, nextSeqNum, base+windowSize);
+    while(seqLt(nextSeqNum, end) || seqLt(base, end)) {
+        // the congestion window, capped by windowSize and by the room the
+        //     server has.
+        int window = cc.window() < windowSize ? cc.window() : windowSize;
+        int room = seqDiff(peerEdge, base);
+        if(room < window) window = room > 0 ? room : 0;
+        if(window > 0) probes = 0;
+        WireHeader header(WIRE_DATA, 0, 0, window, opts.connId);
+        if(stats.dumpDue()) stats.json(cerr) << endl;
+
+        // the clock is only read when the window fills up or opens again.
+        bool limited = seqLt(nextSeqNum, end)
+                && !seqLt(nextSeqNum, base + window);
+        if(limited != (limitedSince >= 0)) {
+            if(limited) {
+                stats.windowStalls++;
+                limitedSince = clock.lap();
+            } else {
+                stats.windowLimitedUsec += clock.lap() - limitedSince;
+                limitedSince = -1;
+            }
+        }
 
         // in window & not finished transmitting.
-        if(nextSeqNum < base + windowSize && nextSeqNum < max) {
-            message[0] = nextSeqNum; // place sequence # in message[0].
-            // cerr << "send seq # = " << nextSeqNum << endl;
-            sock.sendTo( (char*) message, MSGSIZE);
+        bool canSend = seqLt(nextSeqNum, base + window) && seqLt(nextSeqNum, end);
+        // with a pacer, only as many as its tokens allow go out at once.
+        int allowance = MAXBATCH;
+        if(canSend && opts.pacer != NULL) {
+            opts.pacer->setRate(window, rtt.srtt());
+            allowance = opts.pacer->allowance(clock.lap());
+        }
+        bool paced = canSend && allowance == 0;
+
+        if(canSend && !paced) {
+            // queue up everything the window and the pacer allow.
+            int count = 0;
+            unsigned int batchStart = sendMax; // resends are those below
+            long nowNsec = clock.lapNsec();
+            long now = nowNsec / 1000;
+            while(seqLt(nextSeqNum, base + window) && seqLt(nextSeqNum, end)
+                    && count + parityRoom < MAXBATCH && count < allowance) {
+                // with sack, skip over what the server already holds so
+                //     only the holes are resent after a timeout.
+                if(opts.sackOn && sacked.test(nextSeqNum)) {
+                    nextSeqNum++;
+                    continue;
+                }
+                header.seq = nextSeqNum;
+                batchSeqs[count] = nextSeqNum;
+                if(source == NULL) {
+                    // the slot held parity last time.
+                    if(batchLengths[count] != segSize) {
+                        memcpy(batchPtrs[count], message, segSize);
+                        batchLengths[count] = segSize;
+                    }
+                    wireWrite(batchPtrs[count], header, payloadCrc);
+                } else {
+                    char *payload = source->payload(nextSeqNum);
+                    unsigned int &crc = source->crc(nextSeqNum);
+                    if(!seqLt(nextSeqNum, sendMax))
+                        crc = crc32c(0, payload, source->payloadSize);
+                    if(opts.fec != NULL) {
+                        memcpy(batchPtrs[count] + WIRE_HDR, payload,
+                                source->payloadSize);
+                        wireWrite(batchPtrs[count], header, crc);
+                    } else {
+                        sendPtrs[count] = source->head(nextSeqNum);
+                        bodies[count] = payload;
+                        wireWrite(sendPtrs[count], header, crc);
+                    }
+                    batchLengths[count] = segSize;
+                }
+                count++;
 
-            // if the packets has already been sent, count as a retransmission.
-            if(sent[nextSeqNum]) retransmitted++;
-            sent[nextSeqNum] = true;
+                // if the packets has already been sent, count as a retransmission.
+                if(seqLt(nextSeqNum, sendMax)) {
+                    retransmitted++;
+                    stats.timeoutRetransmits++; // go-back-n after an rto
+                    resent.set(nextSeqNum);
+                    trace.record(TRACE_RETRANSMIT, nextSeqNum, base, window,
+                            cc.window(), opts.connId);
+                } else {
+                    sendMax = nextSeqNum + 1;
+                    trace.record(TRACE_SEND, nextSeqNum, base, window,
+                            cc.window(), opts.connId);
+                    // code it the first time only, and follow a full group
+                    //     (or the last one) with its parity.
+                    if(opts.fec != NULL) {
+                        char *parity[FEC_MAXK];
+                        for(int j = 0; j < FEC_MAXK; j++)
+                            parity[j] = batchPtrs[count + j];
+                        int made = opts.fec->add(batchPtrs[count - 1],
+                                sendMax == end, parity);
+                        for(int j = 0; j < made; j++) {
+                            batchSeqs[count] = nextSeqNum + 1;
+                            batchLengths[count++] = segSize + FECHDR;
+                        }
+                    }
+                }
+                sentAt[resent.slot(nextSeqNum)] = nowNsec;
+                if(opts.perSegmentTimersOn) {
+                    timers[resent.slot(nextSeqNum)].id = nextSeqNum;
+                    wheel.schedule(timers[resent.slot(nextSeqNum)], now + rtt.rto());
+                }
 
-            nextSeqNum++;
+                nextSeqNum++;
+            }
+            int sent = sock.sendBatch(sendPtrs, WIRE_HDR, bodies, batchLengths,
+                    count);
+            unsendTail(sent, count, batchSeqs, batchStart, opts.fec != NULL,
+                    nextSeqNum, sendMax, retransmitted, stats);
+            stats.sent(batchLengths, sent);
+            if(opts.pacer != NULL) opts.pacer->sent(sent, now);
         }
         // outside window
         else {
+            // a hole at the base holds the window shut before the group
+            //     being coded fills up: send its parity now, not never.
+            if(opts.fec != NULL && !canSend && dupAcks > 0) {
+                int made = opts.fec->flush(batchPtrs);
+                for(int j = 0; j < made; j++)
+                    batchLengths[j] = segSize + FECHDR;
+                sock.sendBatch(batchPtrs, batchLengths, made);
+                stats.sent(batchLengths, made);
+                if(opts.pacer != NULL) opts.pacer->charge(made, clock.lap());
+            }
             timer.start();
             bool windowMoved = false;
 
-            // wait for either a timeout or an ack recv.
-            while(!isTimeout(timer) & !canRecv(sock)) {}
+            // with per segment timers, wait no longer than the first expiry.
+            //     a shut window is probed less and less often, like rtos.
+            long timeout = rtt.rto();
+            if(window == 0)
+                timeout <<= probes < PERSIST_BACKOFFS ? probes
+                                                      : PERSIST_BACKOFFS;
+            if(opts.perSegmentTimersOn && wheel.nextDeadline() >= 0)
+                timeout = wheel.nextDeadline() - clock.lap();
+            // held back by the pacer: sleep only until it lets one go.
+            if(paced) {
+                long release = opts.pacer->nextRelease(clock.lap());
+                if(release < timeout) timeout = release;
+            }
+
+            // wait for either a timeout or acks, taking all that are pending.
+            int ackCount = 0;
+            if(waitRecv(sock, timer, timeout, opts.spinUsec))
+                ackCount = sock.recvBatch(ackPtrs, sizeof(SackAck),
+                        ackLengths, MAXBATCH, false);
+
+            // acks received.
+            long ackedNsec = clock.lapNsec();
+            stats.acksReceived += ackCount;
+            for(int a = 0; a < ackCount; a++) {
+                SackAck &sackAck = acks[a];
+                int length = ackLengths[a];
+                WireHeader ackHeader;
+                if(!wireRead(sackAck.header, length, ackHeader)
+                        || !(ackHeader.flags & WIRE_ACK)) {
+                    stats.corrupt++;
+                    continue;
+                }
+                // left over from another transfer, or from probing.
+                if(ackHeader.connId != opts.connId
+                        || (ackHeader.flags & WIRE_PROBE)) continue;
+                unsigned int ack = ackHeader.ack;
+
+                // stale (before the base) or bogus (past anything sent).
+                if(seqLt(ack, base) || seqGt(ack, sendMax)) continue;
+
+                if(opts.sackOn)
+                    applySackAck(sackAck, length, ackHeader, sacked, sendMax);
+                // the server's window only ever opens further.
+                if(seqGt(ack + ackHeader.window, peerEdge))
+                    peerEdge = ack + ackHeader.window;
+                if(seqGt(ack, base)) {
+                    trace.record(TRACE_ACK, base, ack, window, cc.window(),
+                            opts.connId);
+                    stats.segmentsDelivered += seqDiff(ack, base);
+                    stats.bytesDelivered += (long) seqDiff(ack, base) * segSize;
+                    if(opts.fec != NULL) opts.fec->observe(seqDiff(ack, base), 0);
+                    // the newest segment covered is the one that was acked,
+                    //     unless a resent hole filler may have triggered it.
+                    bool ambiguous = false;
+                    for(unsigned int i = base; i != ack && !ambiguous; i++)
+                        ambiguous = resent.test(i);
+                    // the older ones it covers waited behind a hole or a
+                    //     delayed ack, which is no part of their rtt.
+                    if(!ambiguous) {
+                        long rttNsec = ackedNsec - sentAt[resent.slot(ack - 1)];
+                        rtt.sample(rttNsec / 1000);
+                        if(opts.rtts != NULL) opts.rtts->record(rttNsec);
+                    }
 
-            // ack received.
-            if(canRecv(sock)) {
-                int ack = recvAck(sock);
-                // cerr << "receive ACK " << ack << endl;
-                if(ack > base) {
+                    // a partial ack in recovery points at the next hole:
+                    //     resend it now instead of waiting for a timeout.
+                    bool partial = inRecovery && seqLt(ack, recover);
+                    if(partial) {
+                        cc.onPartialAck(seqDiff(ack, base), clock.lap());
+                    } else {
+                        cc.onAck(seqDiff(ack, base), clock.lap(), rtt.srtt());
+                        inRecovery = false;
+                    }
+
+                    // free the acked slots for the next lap of the rings.
+                    for(unsigned int i = base; i != ack; i++)
+                        wheel.cancel(timers[resent.slot(i)]);
+                    resent.resetRange(base, ack);
+                    sacked.resetRange(base, ack);
                     base = ack;
+                    if(seqLt(nextSeqNum, base)) nextSeqNum = base;
+                    dupAcks = 0;
                     windowMoved = true;
+
+                    if(partial) {
+                        resend(sock, message, source, segSize, base, header,
+                                payloadCrc, stats);
+                        trace.record(TRACE_FASTRETRANSMIT, base, base, window,
+                                cc.window(), opts.connId);
+                        if(opts.pacer != NULL) opts.pacer->charge(1, clock.lap());
+                        retransmitted++;
+                        stats.fastRetransmits++;
+                        resent.set(base);
+                        sentAt[resent.slot(base)] = clock.lapNsec();
+                        if(opts.perSegmentTimersOn) {
+                            timers[resent.slot(base)].id = base;
+                            wheel.schedule(timers[resent.slot(base)],
+                                    sentAt[resent.slot(base)] / 1000 + rtt.rto());
+                        }
+                    }
+                }
+                // the same ack again while data is outstanding.
+                else if(seqGt(nextSeqNum, base)) {
+                    dupAcks++;
+                    stats.dupAcks++;
+                    trace.record(TRACE_DUPACK, base, ack, window, cc.window(),
+                            opts.connId);
+                    cc.onDupAck(dupAcks, clock.lap());
+                    // a new hole at the base, fec sizes its parity by these.
+                    if(opts.fec != NULL && dupAcks == 1) opts.fec->observe(0, 1);
+
+                    // fast retransmit: the base is lost, don't wait for it.
+                    if(opts.fastRetransmitOn && !inRecovery
+                            && dupAcks == dupThreshold) {
+                        inRecovery = true;
+                        recover = nextSeqNum;
+                        cc.onFastRetransmit(clock.lap());
+                        resend(sock, message, source, segSize, base, header,
+                                payloadCrc, stats);
+                        trace.record(TRACE_FASTRETRANSMIT, base, base, window,
+                                cc.window(), opts.connId);
+                        if(opts.pacer != NULL) opts.pacer->charge(1, clock.lap());
+                        retransmitted++;
+                        stats.fastRetransmits++;
+                        resent.set(base);
+                        sentAt[resent.slot(base)] = clock.lapNsec();
+                        if(opts.perSegmentTimersOn) {
+                            timers[resent.slot(base)].id = base;
+                            wheel.schedule(timers[resent.slot(base)],
+                                    sentAt[resent.slot(base)] / 1000 + rtt.rto());
+                        }
+                    }
+                }
+            }
+            // nothing is outstanding while the server's window is shut, so
+            //     a wait without acks calls for a probe, not a resend: the
+            //     last segment acked again, which the server drops as a
+            //     duplicate and answers with an ack telling its window.
+            //     sendMax, the timers and fec groups don't see it.
+            if(window == 0) {
+                if(ackCount == 0) {
+                    resend(sock, message, source, segSize, base - 1, header,
+                            payloadCrc, stats);
+                    if(opts.pacer != NULL) opts.pacer->charge(1, clock.lap());
+                    stats.windowProbes++;
+                    probes++;
+                }
+            }
+            // per segment timeouts: resend just the segments whose own timer
+            //     ran out and that the server doesn't hold yet.
+            else if(opts.perSegmentTimersOn) {
+                wheel.expire(clock.lap());
+                TimerWheel::Entry *e;
+                while((e = wheel.popExpired()) != NULL) {
+                    unsigned int seqNum = e->id;
+                    if(seqLt(seqNum, base) || sacked.test(seqNum)) continue;
+                    // only the base expiring counts as an rto event, so the
+                    //     backoff doubles once per rto, not once per segment.
+                    if(seqNum == base) {
+                        stats.timeouts++;
+                        trace.record(TRACE_TIMEOUT, base, base, window,
+                                cc.window(), opts.connId);
+                        rtt.backoff();
+                        cc.onTimeout(clock.lap());
+                        dupAcks = 0;
+                        inRecovery = false;
+                    }
+                    resend(sock, message, source, segSize, seqNum, header,
+                            payloadCrc, stats);
+                    trace.record(TRACE_RETRANSMIT, seqNum, base, window,
+                            cc.window(), opts.connId);
+                    if(opts.pacer != NULL) opts.pacer->charge(1, clock.lap());
+                    retransmitted++;
+                    stats.timeoutRetransmits++;
+                    resent.set(seqNum);
+                    sentAt[resent.slot(seqNum)] = clock.lapNsec();
+                    wheel.schedule(*e, sentAt[resent.slot(seqNum)] / 1000
+                            + rtt.rto());
                 }
             }
-            // timeout
-            else {
+            // timeout, unless the wait was only the pacer's.
+            else if(ackCount == 0 && !paced) {
                 if(!windowMoved) {
-                    // cerr << "timeout base = " << base << endl;
+                    trace.record(TRACE_TIMEOUT, base, base, window,
+                            cc.window(), opts.connId);
                     nextSeqNum = base;
+                    stats.timeouts++;
+                    rtt.backoff();
+                    cc.onTimeout(clock.lap());
+                    dupAcks = 0;
+                    inRecovery = false;
                 }
             }
         }
     }
+    if(limitedSince >= 0)
+        stats.windowLimitedUsec += clock.lap() - limitedSince;
+    delete[] timers;
+    delete[] sentAt;
+    delete[] batch;
+    delete source;
     return retransmitted;
 }
 
+// put segment seqNum's payload, at from, in its slot in buffer and in its
+//     place in opts.sink, cut short past the sink's end, unless it was
+//     received right there.
+void deliver(const ReceiverOptions &opts, ReceiveBuffer *buffer,
+        unsigned int seqNum, const char *from, int payloadSize) {
+    if(buffer != NULL) {
+        char *slot = buffer->slot(seqNum);
+        if(slot != from)
+            memcpy(slot, from, payloadSize < buffer->slotSize()
+                    ? payloadSize : buffer->slotSize());
+        buffer->filled(seqNum, payloadSize);
+    }
+    if(opts.sink == NULL) return;
+    long offset = (long) (seqNum - opts.isn) * payloadSize;
+    long room = opts.sinkLength - offset;
+    if(room > 0 && opts.sink + offset != from)
+        memcpy(opts.sink + offset, from,
+                room < payloadSize ? room : payloadSize);
+}
+
+// offer opts.reader what's in order in buffer until it takes less than that.
+void readOut(const ReceiverOptions &opts, ReceiveBuffer &buffer) {
+    int length;
+    const char *span;
+    while((span = buffer.peek(length)) != NULL) {
+        long read = opts.reader(span, length, opts.readerArg);
+        if(read > 0) buffer.release(read < length ? read : length);
+        if(read < length) return;
+    }
+}
+
 void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
-          int windowSize, int dropPercent) {
+          int windowSize, int dropPercent, const ReceiverOptions &opts) {
     cerr << "server: early retransmit test:" << endl;
     fprintf(stderr, "start window size = %d, drop percent = %d\n", windowSize, dropPercent);
-    // used to track all received packets.
-    bool packets[max];
-    for(int i=0; i<max; i++) packets[i] = false;
-
-    int expectedSeqNum = 0;
-
-    while(expectedSeqNum < max) {
-        sock.recvFrom( (char*) message, MSGSIZE);
-        int seqNum = message[0];
-
-        // fprintf(stderr,"window = %d, seqNo = %d, received = %d\n", windowSize, expectedSeqNum, seqNum);
-        if(!isRandomDrop(dropPercent)) {
-            packets[seqNum] = true;
-            if(seqNum == expectedSeqNum) {
-                // fast forward expectedSeqNum to be the 
-                //     next unreceived (false) packet.
-                while(expectedSeqNum < max && packets[expectedSeqNum])
-                    expectedSeqNum++;
+    Impairment drops(DROP_SEED + dropPercent + opts.dropSeed * 101);
+    Impairment *link = dropOn(sock, drops, dropPercent);
+    // expectedSeqNum and the packets received past it, one window's worth.
+    ReceiveWindow window(windowSize, opts.isn, max);
+    window.delayAcks(opts.ackEvery, opts.ackDelay);
+    ProtocolStats untracked;
+    ProtocolStats &stats = opts.stats != NULL ? *opts.stats : untracked;
+    window.track(stats);
+    // copies of the data segments and parity lost ones are rebuilt from.
+    FecDecoder *fec = opts.fecOn ? new FecDecoder(windowSize, opts.segSize)
+                                 : NULL;
+    unsigned int repaired[FEC_MAXK];
+    TraceRing &trace = TraceRing::process();
+    // with a reader, payloads wait for it in here, and hold the window.
+    ReceiveBuffer *buffer = NULL;
+    if(opts.reader != NULL) {
+        buffer = new ReceiveBuffer(window.capacity(), opts.segSize - WIRE_HDR,
+                opts.isn);
+        window.bufferInto(*buffer);
+    }
+
+    // everything pending is received with one recvBatch(), and the acks
+    //     for it go back with one ackBatch(). slots hold a segment or its
+    //     parity, in whole ints.
+    int slotSize = (opts.segSize + FECHDR + 3) / 4 * 4;
+    int *batch = new int[MAXBATCH * slotSize / 4];
+    char *batchPtrs[MAXBATCH];
+    int batchLengths[MAXBATCH];
+    SackAck acks[MAXBATCH];
+    char *ackPtrs[MAXBATCH];
+    int ackLengths[MAXBATCH];
+    for(int i=0; i<MAXBATCH; i++) {
+        batchPtrs[i] = (char*) batch + i * slotSize;
+        ackPtrs[i] = (char*) &acks[i];
+    }
+    // with a sink or a reader, each datagram of a batch is guessed to be the
+    //     next new segment after the newest one so far, and its payload
+    //     received right at its place in the sink, or its slot in the
+    //     buffer; a wrong guess costs a copy. every
+    //     segment of a source is the same size, learnt from the first one.
+    //     until then, and with fec, which needs segments whole, datagrams
+    //     land whole in their slots and payloads are copied from there.
+    int payloadSize = 0;
+    unsigned int nextGuess = opts.isn;
+    bool latched = opts.connId != 0;
+    unsigned int connId = opts.connId;
+    window.setConnId(connId);
+    unsigned int guesses[MAXBATCH];
+    char *bodies[MAXBATCH];
+
+    while(!window.done()) {
+        if(opts.stats != NULL && opts.stats->dumpDue()) opts.stats->json(cerr) << endl;
+
+        // a delayed ack goes out on its own if nothing arrives before it's due.
+        long due = window.ackDue();
+        if(due >= 0 && sock.waitRecvFrom(due) <= 0) {
+            ackLengths[0] = window.dueAck(acks[0]);
+            if(ackLengths[0] > 0) sock.ackBatch(ackPtrs, ackLengths, 1);
+            continue;
+        }
+
+        bool scatter = (opts.sink != NULL || buffer != NULL) && fec == NULL
+                && payloadSize > 0;
+        for(int i = 0; i < MAXBATCH; i++) {
+            bodies[i] = batchPtrs[i] + WIRE_HDR;
+            guesses[i] = nextGuess + i;
+            long offset = (long) (guesses[i] - opts.isn) * payloadSize;
+            if(!scatter || !window.wants(guesses[i])) continue;
+            if(buffer != NULL)
+                bodies[i] = buffer->slot(guesses[i]);
+            else if(offset + payloadSize <= opts.sinkLength)
+                bodies[i] = opts.sink + offset;
+        }
+        int count = scatter
+                ? sock.recvBatch(batchPtrs, WIRE_HDR, bodies,
+                        WIRE_HDR + payloadSize, batchLengths, MAXBATCH, true)
+                : sock.recvBatch(batchPtrs, slotSize, batchLengths, MAXBATCH,
+                        true);
+        int ackCount = 0;
+
+        // a wrongly guessed payload sits where another one goes: move it
+        //     to its slot before anything is taken in.
+        for(int i = 0; i < count; i++) {
+            char *slot = batchPtrs[i] + WIRE_HDR;
+            if(bodies[i] == slot || (batchLengths[i] >= WIRE_HDR
+                    && wireSeq(batchPtrs[i]) == guesses[i])) continue;
+            if(batchLengths[i] > WIRE_HDR)
+                memcpy(slot, bodies[i], batchLengths[i] - WIRE_HDR);
+            bodies[i] = slot;
+        }
+
+        for(int i = 0; i < count; i++) {
+            char *datagram = batchPtrs[i];
+            bool parity = fec != NULL
+                    && isParity(datagram, batchLengths[i], opts.segSize);
+            WireHeader header;
+            if(!parity && !wireRead(datagram, bodies[i], batchLengths[i],
+                    header)) {
+                stats.corrupt++;
+                continue;
+            }
+            // a path mtu probe is answered, not taken in.
+            int probeLength = parity ? 0
+                    : answerProbe(header, acks[ackCount].header);
+            if(probeLength > 0) {
+                ackLengths[ackCount++] = probeLength;
+                continue;
+            }
+            // the transfer is opts.connId's, or the first segment's. acks,
+            //     stragglers of an earlier one and anything else aren't it.
+            if(!parity && !(header.flags & WIRE_DATA)) continue;
+            unsigned int id = parity ? wireConnId(datagram) : header.connId;
+            if(!latched) {
+                connId = id;
+                window.setConnId(connId); // acks echo it
+                latched = true;
             }
+            if(id != connId) continue;
+            unsigned int seqNum = header.seq;
 
-            int ackNum = expectedSeqNum;
-            // ack a valid packet.
-            if(ackNum <= max) {
-                sock.ackTo((char*) &ackNum, sizeof(ackNum));
+            // data is taken in as usual, parity only when it fills holes.
+            //     one ack, the last, answers the segment and all it rebuilt.
+            int rebuilt = 0;
+            int length = 0;
+            if(parity) {
+                rebuilt = fec->parity(datagram, window.expected(), repaired);
+            } else {
+                if(opts.sink != NULL || buffer != NULL) {
+                    if(payloadSize == 0)
+                        payloadSize = batchLengths[i] - WIRE_HDR;
+                    if(window.wants(seqNum))
+                        deliver(opts, buffer, seqNum, bodies[i],
+                                batchLengths[i] - WIRE_HDR);
+                    if(seqGeq(seqNum, nextGuess)) nextGuess = seqNum + 1;
+                }
+                if(fec != NULL)
+                    rebuilt = fec->data(seqNum, datagram, window.expected(),
+                            repaired);
+                length = window.receive(seqNum, batchLengths[i],
+                        acks[ackCount]);
+                trace.record(TRACE_RECV, seqNum, window.expected(), windowSize,
+                        0, header.connId);
+            }
+            for(int r = 0; r < rebuilt; r++) {
+                if((opts.sink != NULL || buffer != NULL)
+                        && window.wants(repaired[r]))
+                    deliver(opts, buffer, repaired[r],
+                            fec->segment(repaired[r]) + WIRE_HDR,
+                            opts.segSize - WIRE_HDR);
+                int rebuiltLength = window.receive(repaired[r], opts.segSize,
+                        acks[ackCount]);
+                if(rebuiltLength > 0) length = rebuiltLength;
             }
+            if(length > 0) ackLengths[ackCount++] = length;
+        }
+        if(ackCount < MAXBATCH) {
+            ackLengths[ackCount] = window.dueAck(acks[ackCount]);
+            if(ackLengths[ackCount] > 0) ackCount++;
+        }
+        // what the reader frees opens the window again, which the client
+        //     hears about once it's opened far enough. the acks before
+        //     were built with the segments still unread, a full window of
+        //     them shuts it, so the update has to get out.
+        if(buffer != NULL) {
+            readOut(opts, *buffer);
+            if(ackCount == MAXBATCH) {
+                sock.ackBatch(ackPtrs, ackLengths, ackCount);
+                ackCount = 0;
+            }
+            ackLengths[ackCount] = window.windowUpdate(acks[ackCount]);
+            if(ackLengths[ackCount] > 0) ackCount++;
+        }
+        sock.ackBatch(ackPtrs, ackLengths, ackCount);
+    }
+    if(buffer != NULL) readOut(opts, *buffer);
+
+    // the last acks can be lost on the way back, so keep answering the
+    //     client's retransmissions with the final ack until it goes quiet.
+    while(opts.lingerUsec > 0 && sock.waitRecvFrom(opts.lingerUsec) > 0) {
+        int count = sock.recvBatch(batchPtrs, slotSize, batchLengths,
+                MAXBATCH, false);
+        int ackCount = 0;
+        for(int i = 0; i < count; i++) {
+            WireHeader header;
+            if(!wireRead(batchPtrs[i], batchLengths[i], header)
+                    || !(header.flags & WIRE_DATA) || header.connId != connId)
+                continue;
+            ackLengths[ackCount] = window.receive(header.seq, batchLengths[i],
+                    acks[ackCount]);
+            if(ackLengths[ackCount] > 0) ackCount++;
+        }
+        sock.ackBatch(ackPtrs, ackLengths, ackCount);
+    }
+    sock.impair(link);
+
+    fprintf(stderr, "end window size = %d, drop percent = %d, acks = %ld\n", windowSize, dropPercent, window.acks());
+    delete[] batch;
+    delete buffer;
+    if(fec != NULL) {
+        fprintf(stderr, "rebuilt = %ld\n", fec->rebuilt());
+        delete fec;
+    }
+}
+
+/*==============================================================================
+        Multi-Session Server
+*/
+
+#define LINGERUSEC 1000000 // keep acking stragglers until this long quiet
+#define IDLEUSEC 10000000  // forget a transfer under way this long quiet
+#define MAXSESSIONS 4096   // most sessions kept at once per table
+// a datagram slot of serveSessionBatch(), in whole ints. any size a client
+//     may use or probe for arrives whole.
+#define SESSIONSLOT ((MAXMSGSIZE + 3) / 4 * 4)
+
+// receive whatever is pending (waiting for the first datagram) into batch,
+//     MAXBATCH slots of SESSIONSLOT bytes, hand each datagram to its session
+//     and send all the acks back in one batch, then let the table drop the
+//     sessions gone quiet. returns the number of sessions that completed
+//     in this batch.
+int serveSessionBatch(UdpSocket &sock, SessionTable &table, char *batch) {
+    char *batchPtrs[MAXBATCH];
+    int batchLengths[MAXBATCH];
+    struct sockaddr srcs[MAXBATCH];
+    SackAck acks[MAXBATCH];
+    char *ackPtrs[MAXBATCH];
+    int ackLengths[MAXBATCH];
+    struct sockaddr ackAddrs[MAXBATCH];
+    for(int i=0; i<MAXBATCH; i++) {
+        batchPtrs[i] = batch + i * SESSIONSLOT;
+        ackPtrs[i] = (char*) &acks[i];
+    }
+
+    int count = sock.recvBatch(batchPtrs, SESSIONSLOT, batchLengths,
+            MAXBATCH, true, srcs);
+    int ackCount = 0;
+    int finished = 0;
+    for(int i = 0; i < count; i++) {
+        // corrupt, or too short to hold a header.
+        WireHeader header;
+        if(!wireRead(batchPtrs[i], batchLengths[i], header))
+            continue;
+        // a path mtu probe is answered, not taken in.
+        ackLengths[ackCount] = answerProbe(header, acks[ackCount].header);
+        if(ackLengths[ackCount] > 0) {
+            ackAddrs[ackCount++] = srcs[i];
+            continue;
+        }
+        // only data opens or feeds a session; an ack or anything else
+        //     would take a table slot for nothing.
+        if(!(header.flags & WIRE_DATA))
+            continue;
+        // no room for a new transfer: left unacked, its sender retries
+        //     until a session finishes or expires.
+        Session *session = table.find(srcs[i], header.connId);
+        if(session == NULL)
+            continue;
+        bool wasDone = session->window.done();
+        session->segments++;
+        ackLengths[ackCount] = session->window.receive(header.seq,
+                batchLengths[i], acks[ackCount]);
+        ackAddrs[ackCount++] = session->peer;
+        if(!wasDone && session->window.done()) {
+            table.finish(session);
+            finished++;
+        }
+    }
+    sock.ackBatch(ackPtrs, ackLengths, ackCount, ackAddrs);
+    table.expire();
+    return finished;
+}
+
+// take in transfers of max segments from many clients at once on one
+//     socket, until sessions of them are complete. a single receive loop
+//     sorts datagrams into sessions by source address and connection id.
+void serverSessions( UdpSocket &sock, const int max, int windowSize,
+          int sessions, int dropPercent, unsigned int isn ) {
+    cerr << "server: multi-session test:" << endl;
+    fprintf(stderr, "sessions = %d, window size = %d, drop percent = %d\n",
+            sessions, windowSize, dropPercent);
+    SessionTable table(windowSize, isn, max, MAXSESSIONS, IDLEUSEC,
+            LINGERUSEC);
+    char *batch = new char[MAXBATCH * SESSIONSLOT];
+    Impairment drops(DROP_SEED + dropPercent);
+    Impairment *link = dropOn(sock, drops, dropPercent);
+
+    // clocked from the first segment on.
+    int finished = serveSessionBatch(sock, table, batch);
+    Timer timer;
+    timer.start();
+    while(finished < sessions)
+        finished += serveSessionBatch(sock, table, batch);
+    long elapsed = timer.lap();
+
+    // the last acks of a session can be lost like any other, so keep
+    //     answering its retransmissions until everyone has gone quiet.
+    while(sock.waitRecvFrom(LINGERUSEC) > 0)
+        serveSessionBatch(sock, table, batch);
+    sock.impair(link);
+    delete[] batch;
+
+    long segments = table.segments();
+    cerr << "sessions = ";
+    cout << table.size() << " ";
+    cerr << "Elasped time = ";
+    cout << elapsed << " ";
+    cerr << "segments = ";
+    cout << segments << " ";
+    cerr << "segments/sec = ";
+    cout << (elapsed > 0 ? segments * 1000000 / elapsed : 0) << endl;
+}
+
+/*==============================================================================
+        Sharded Multi-Session Server
+*/
+
+// one receive loop of the sharded server: its own socket on the shared
+//     port, its own sessions and its own counters. nothing is shared with
+//     the other shards except the count of completed sessions.
+struct Shard {
+    UdpSocket *sock;
+    int core;                  // cpu the worker thread is pinned to
+    int sessions;              // sessions to complete across all shards
+    int dropPercent;
+    SessionTable *table;
+    atomic<int> *finished;     // sessions completed across all shards
+    Timer started;             // when the first segment arrived here
+    long elapsed;              // from the first segment until all completed
+    long segments;
+};
+
+#define SHARDPOLLUSEC 100000 // how often an idle shard looks if all are done
+
+void *serveShard(void *arg) {
+    Shard &shard = *(Shard *) arg;
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(shard.core, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+    // each shard drops its own share of what it receives.
+    Impairment drops(DROP_SEED + shard.dropPercent + shard.core * 101);
+    Impairment *link = dropOn(*shard.sock, drops, shard.dropPercent);
+    char *batch = new char[MAXBATCH * SESSIONSLOT];
+
+    // a shard may see no sessions at all, so only wait so long at a time
+    //     before looking whether the others finished everything.
+    bool busy = false;
+    while(*shard.finished < shard.sessions) {
+        if(shard.sock->waitRecvFrom(SHARDPOLLUSEC) <= 0)
+            continue;
+        if(!busy) {
+            shard.started.start(); // clocked from its first segment on.
+            busy = true;
         }
+        *shard.finished += serveSessionBatch(*shard.sock, *shard.table, batch);
+    }
+    shard.elapsed = busy ? shard.started.lap() : 0;
+
+    // the last acks of a session can be lost like any other, so keep
+    //     answering its retransmissions until everyone has gone quiet.
+    while(shard.sock->waitRecvFrom(LINGERUSEC) > 0)
+        serveSessionBatch(*shard.sock, *shard.table, batch);
+    shard.sock->impair(link);
+    delete[] batch;
+
+    shard.segments = shard.table->segments();
+    return NULL;
+}
+
+// serverSessions() spread over shards sockets sharing one port, each served
+//     by its own thread pinned to its own core. the kernel keeps every client
+//     on one socket, so a session never moves between shards.
+void serverShardedSessions( UdpSocket *socks[], int shards, const int max,
+          int windowSize, int sessions, int dropPercent, unsigned int isn ) {
+    cerr << "server: sharded multi-session test:" << endl;
+    fprintf(stderr, "shards = %d, sessions = %d, window size = %d, drop percent = %d\n",
+            shards, sessions, windowSize, dropPercent);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if(cores < 1) cores = 1;
+
+    atomic<int> finished(0);
+    Shard *shard = new Shard[shards];
+    pthread_t *threads = new pthread_t[shards];
+    for(int i = 0; i < shards; i++) {
+        shard[i].sock = socks[i];
+        shard[i].core = i % cores;
+        shard[i].sessions = sessions;
+        shard[i].dropPercent = dropPercent;
+        shard[i].table = new SessionTable(windowSize, isn, max, MAXSESSIONS,
+                IDLEUSEC, LINGERUSEC);
+        shard[i].finished = &finished;
+        shard[i].elapsed = 0;
+        shard[i].segments = 0;
+        pthread_create(&threads[i], NULL, serveShard, &shard[i]);
+    }
+    for(int i = 0; i < shards; i++)
+        pthread_join(threads[i], NULL);
+
+    // the whole run spans the earliest first segment to the latest finish.
+    long first = -1;
+    long last = -1;
+    long segments = 0;
+    for(int i = 0; i < shards; i++) {
+        long start = shard[i].started.getSec() * 1000000
+                + shard[i].started.getUsec();
+        if(shard[i].segments > 0) {
+            if(first < 0 || start < first) first = start;
+            if(last < 0 || start + shard[i].elapsed > last)
+                last = start + shard[i].elapsed;
+        }
+        segments += shard[i].segments;
+
+        cerr << "shard = ";
+        cout << i << " ";
+        cerr << "sessions = ";
+        cout << shard[i].table->size() << " ";
+        cerr << "Elasped time = ";
+        cout << shard[i].elapsed << " ";
+        cerr << "segments = ";
+        cout << shard[i].segments << " ";
+        cerr << "segments/sec = ";
+        cout << (shard[i].elapsed > 0
+                ? shard[i].segments * 1000000 / shard[i].elapsed : 0) << endl;
+        delete shard[i].table;
     }
+    long elapsed = first < 0 ? 0 : last - first;
+    cerr << "total shards = ";
+    cout << shards << " ";
+    cerr << "Elasped time = ";
+    cout << elapsed << " ";
+    cerr << "segments = ";
+    cout << segments << " ";
+    cerr << "segments/sec = ";
+    cout << (elapsed > 0 ? segments * 1000000 / elapsed : 0) << endl;
 
-    fprintf(stderr, "end window size = %d, drop percent = %d\n", windowSize, dropPercent);
+    delete[] threads;
+    delete[] shard;
 }